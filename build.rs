@@ -28,12 +28,24 @@ fn main() {
         .header("inc/wasm_embedded/wasm3/spi.h")
         .header("inc/wasm_embedded/wasm3/uart.h")
         .header("inc/wasm_embedded/wasm3/gpio.h")
+        .header("inc/wasm_embedded/wasm3/pool.h")
+        .header("inc/wasm_embedded/wasm3/reactor.h")
+        .header("inc/wasm_embedded/wasm3/sched.h")
+        .header("inc/wasm_embedded/wasm3/async.h")
+        .header("inc/wasm_embedded/wasm3/buf.h")
+        .header("inc/wasm_embedded/wasm3/frame.h")
+        .header("inc/wasm_embedded/wasm3/sampler.h")
+        .header("inc/wasm_embedded/wasm3/bus.h")
+        .header("inc/wasm_embedded/wasm3/poll.h")
+        .header("inc/wasm_embedded/wasm3/console.h")
+        .header("inc/wasm_embedded/wasm3/vfs.h")
         .blocklist_type("gpio_drv_t")
         .blocklist_type("spi_drv_t")
         .blocklist_type("i2c_drv_t")
         .blocklist_type("uart_drv_t")
         .allowlist_type("wasme.*")
-        .allowlist_function("WASME.*");
+        .allowlist_function("WASME.*")
+        .allowlist_var("WASME.*");
 
     // Patches to help bindgen with cross compiling
     // See: https://github.com/rust-lang/rust-bindgen/issues/1229#issuecomment-366522257
@@ -0,0 +1,42 @@
+#ifndef WASME_ASYNC_H
+#define WASME_ASYNC_H
+
+#include <stdint.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Returned by a driver operation that has started but not completed, the driver
+/// must later call WASME_async_complete with the result
+#define WASME_DRV_PENDING (-0x10000)
+
+/// Returned by WASME_run, WASME_call and WASME_resume when the task is parked
+/// awaiting completion of a driver operation
+#define WASME_PENDING 2
+
+/// Completion notification, called on the completing thread once a parked
+/// context may be resumed with WASME_resume
+typedef void (*wasme_async_notify_f)(wasme_ctx_t* ctx, void* arg);
+
+/// Enable asynchronous driver operations for a context, runs and calls then
+/// return WASME_PENDING while a driver operation is in flight rather than
+/// blocking the calling thread (where fibers are available)
+void WASME_async_enable(wasme_ctx_t* ctx, wasme_async_notify_f notify, void* arg);
+
+/// Fetch the context executing on this thread, for drivers to capture before
+/// returning WASME_DRV_PENDING
+wasme_ctx_t* WASME_async_current(void);
+
+/// Complete the pending driver operation for a context, safe to call from any
+/// thread or before the driver has returned WASME_DRV_PENDING
+void WASME_async_complete(wasme_ctx_t* ctx, int32_t result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef WASME_BUF_H
+#define WASME_BUF_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// WASME context forward-declaration
+typedef struct wasme_ctx_s wasme_ctx_t;
+
+/// Maximum number of segments in one scatter-gather list
+#define WASME_MAX_IOVS 16
+
+/// Maximum number of buffers in one DMA pool
+#define WASME_DMA_POOL_MAX 64
+
+/// Scatter-gather segment resolved from guest memory. Guests pass segments as
+/// `{ u32 ptr, u32 len }` pairs, matching the WASI iovec layout.
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+} wasme_iovec_t;
+
+/// Pool of fixed size, aligned bounce buffers for drivers whose DMA engines
+/// cannot address linear memory. Borrowing and returning are lock-free and
+/// safe from any thread or interrupt context.
+typedef struct wasme_dma_pool_s wasme_dma_pool_t;
+
+/// Create a pool of `count` buffers of at least `buf_size` bytes aligned to `align`
+/// (a power of two), within the provided DMA-capable region or allocated if NULL
+wasme_dma_pool_t* WASME_dma_pool_init(void* mem, uint32_t mem_len, uint32_t buf_size, uint32_t count, uint32_t align);
+
+/// Size of each buffer in the pool
+uint32_t WASME_dma_buf_size(const wasme_dma_pool_t* pool);
+
+/// Borrow a buffer, returning NULL if all are in use
+uint8_t* WASME_dma_borrow(wasme_dma_pool_t* pool);
+
+/// Return a borrowed buffer to the pool
+void WASME_dma_return(wasme_dma_pool_t* pool, uint8_t* buf);
+
+/// Free the pool, all buffers must have been returned
+void WASME_dma_pool_deinit(wasme_dma_pool_t** pool);
+
+/// Bind a DMA pool to a context, used to coalesce scatter-gather lists for
+/// drivers without vectored operations. Pools may be shared between contexts.
+int32_t WASME_bind_dma_pool(wasme_ctx_t* ctx, wasme_dma_pool_t* pool);
+
+/// Total length of a scatter-gather list
+uint32_t WASME_iov_len(const wasme_iovec_t* iov, uint32_t iov_len);
+
+/// Copy up to `len` bytes from a scatter-gather list starting at `offset` into `dst`,
+/// returning the number of bytes copied
+uint32_t WASME_iov_gather(const wasme_iovec_t* iov, uint32_t iov_len, uint32_t offset, uint8_t* dst, uint32_t len);
+
+/// Copy up to `len` bytes from `src` into a scatter-gather list starting at `offset`,
+/// returning the number of bytes copied
+uint32_t WASME_iov_scatter(const wasme_iovec_t* iov, uint32_t iov_len, uint32_t offset, const uint8_t* src, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
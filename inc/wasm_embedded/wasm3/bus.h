@@ -0,0 +1,58 @@
+#ifndef WASME_BUS_H
+#define WASME_BUS_H
+
+#include <stdint.h>
+
+#include "wasm_embedded/spi.h"
+#include "wasm_embedded/i2c.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// WASME context forward-declaration
+typedef struct wasme_ctx_s wasme_ctx_t;
+
+/// Maximum number of distinct device configurations per bus
+#define WASME_BUS_MAX_DEVICES 16
+
+/// Number of arbitration priority levels, higher levels are served first
+#define WASME_BUS_PRIORITIES 4
+
+/// Bus manager sharing one SPI or I2C driver between contexts.
+/// Guest handles refer to cached device configurations, the controller is only
+/// reprogrammed (driver deinit/init) when a transfer targets a different device
+/// to the last, and concurrent transfers are granted in priority order.
+/// Drivers behind a bus must complete synchronously, an operation returning
+/// WASME_DRV_PENDING is waited out with the bus held and then fails.
+typedef struct wasme_bus_s wasme_bus_t;
+
+/// Create a bus manager for an SPI driver
+wasme_bus_t* WASME_bus_init_spi(const spi_drv_t* drv, void* drv_ctx);
+
+/// Create a bus manager for an I2C driver
+wasme_bus_t* WASME_bus_init_i2c(const i2c_drv_t* drv, void* drv_ctx);
+
+/// Bind an SPI bus to a context in place of a driver, transfers from the
+/// context are arbitrated at `priority` (0 to WASME_BUS_PRIORITIES - 1).
+/// Exec and vectored extension drivers would bypass arbitration, so binding a
+/// bus clears them and WASME_bind_spi_exec / WASME_bind_spi_vec then fail;
+/// guest exec, readv and writev run through the bus per operation instead.
+int32_t WASME_bind_spi_bus(wasme_ctx_t* ctx, wasme_bus_t* bus, uint32_t priority);
+
+/// Bind an I2C bus to a context in place of a driver. As for SPI, the
+/// transaction extension driver is cleared and WASME_bind_i2c_txn then fails.
+int32_t WASME_bind_i2c_bus(wasme_ctx_t* ctx, wasme_bus_t* bus, uint32_t priority);
+
+/// Fetch the number of times the controller has been reprogrammed
+uint32_t WASME_bus_reconfigs(wasme_bus_t* bus);
+
+/// Release the controller and free the bus, contexts bound to it must be deinitialised first
+void WASME_bus_deinit(wasme_bus_t** bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef WASME_CONSOLE_H
+#define WASME_CONSOLE_H
+
+#include <stdint.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Default console buffer size in bytes
+#define WASME_CONSOLE_BUF_SIZE 1024
+
+/// Flush buffered output when a newline is written
+#define WASME_CONSOLE_FLUSH_NEWLINE (1 << 0)
+
+/// Console backend receiving buffered guest output for stdout (1) and stderr (2)
+typedef struct wasme_console_s {
+    /// Write console output, returning the number of bytes written or a negative value on error
+    int32_t (*write)(void* arg, uint32_t fd, const uint8_t* data, uint32_t len);
+} wasme_console_t;
+
+/// Console buffering policy, zeroed fields select defaults
+typedef struct {
+    /// Buffer size in bytes, a power of two (WASME_CONSOLE_BUF_SIZE when 0)
+    uint32_t buf_size;
+    /// Flush once this many bytes are buffered (half the buffer when 0)
+    uint32_t flush_size;
+    /// Flush output buffered for longer than this, 0 to disable
+    uint32_t flush_us;
+    /// WASME_CONSOLE_FLUSH_ flags
+    uint32_t flags;
+} wasme_console_cfg_t;
+
+/// Buffer guest stdout and stderr and runtime diagnostics for the context,
+/// routed to `console` or to the host stdout and stderr descriptors when NULL.
+/// Output is flushed per the provided policy (line buffered with defaults when
+/// NULL), when the buffer fills, on a trap and on deinit. On linux a flush thread
+/// writes to the backend, which must then be safe to call from that thread,
+/// other hosts flush inline and call WASME_console_tick for the time policy.
+int32_t WASME_set_console(wasme_ctx_t* ctx, const wasme_console_t* console, void* arg, const wasme_console_cfg_t* cfg);
+
+/// Write all buffered console output to the backend
+void WASME_console_flush(wasme_ctx_t* ctx);
+
+/// Flush output buffered for longer than the policy allows at `now_ns`
+/// (CLOCK_MONOTONIC), for hosts without a flush thread
+void WASME_console_tick(wasme_ctx_t* ctx, int64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,11 +14,53 @@ extern "C"
 
 typedef struct wasme_ctx_s wasme_ctx_t;
 
+/// Parsed and validated module, shared between instances
+typedef struct wasme_module_s wasme_module_t;
+
 typedef struct {
     const uint8_t* data;
     uint32_t data_len;
 } wasme_task_t;
 
+/// Resolved function handle, valid for the lifetime of the ctx it was looked up in
+typedef struct wasme_func_s wasme_func_t;
+
+/// Returned by WASME_run, WASME_call and WASME_resume when execution was
+/// suspended after running out of fuel
+#define WASME_SUSPENDED 1
+
+/// Maximum number of arguments or results for WASME_call
+#define WASME_MAX_VALS 16
+
+/// WASM value types, matching wasm3 M3ValueType
+typedef enum {
+    WASME_TYPE_NONE = 0,
+    WASME_TYPE_I32 = 1,
+    WASME_TYPE_I64 = 2,
+    WASME_TYPE_F32 = 3,
+    WASME_TYPE_F64 = 4,
+} wasme_type_t;
+
+/// Typed WASM value for function arguments and results
+typedef struct {
+    wasme_type_t type;
+    union {
+        int32_t i32;
+        int64_t i64;
+        float f32;
+        double f64;
+    } of;
+} wasme_val_t;
+
+/// Host clock for targets without clock_gettime, clock ids and errors are WASI
+/// values (realtime 0, monotonic 1, process cputime 2, thread cputime 3)
+typedef struct wasme_clock_s {
+    /// Fetch the current time of a clock in nanoseconds, returning 0 or a WASI errno
+    uint32_t (*time_get)(void* arg, uint32_t clock_id, uint64_t* time_ns);
+    /// Fetch the resolution of a clock in nanoseconds, returning 0 or a WASI errno
+    uint32_t (*res_get)(void* arg, uint32_t clock_id, uint64_t* res_ns);
+} wasme_clock_t;
+
 // ANCHOR: core_api
 /// Intialise WASME ctx with the provided task
 wasme_ctx_t* WASME_init(const wasme_task_t* task, uint32_t mem_limit);
@@ -26,8 +68,81 @@ wasme_ctx_t* WASME_init(const wasme_task_t* task, uint32_t mem_limit);
 /// Execute the named function
 int WASME_run(wasme_ctx_t* ctx, const char* name, int32_t argc, const char** argv);
 
-/// De-initialise a WASME instance
+/// De-initialise a WASME instance, closing any driver handles left open by the task
 void WASME_deinit(wasme_ctx_t** ctx);
+
+/// Resolve an exported function by name for repeated calls with WASME_call
+wasme_func_t* WASME_lookup(wasme_ctx_t* ctx, const char* name);
+
+/// Call a resolved function with typed arguments, writing results to the provided buffer.
+/// Argument and result counts and types must match the function signature.
+int WASME_call(wasme_ctx_t* ctx, wasme_func_t* func, const wasme_val_t* args, uint32_t argc,
+        wasme_val_t* results, uint32_t resc);
+
+/// Parse and validate the provided task once for use by any number of instances.
+/// The task data must remain valid until the module is freed.
+wasme_module_t* WASME_module_load(const wasme_task_t* task);
+
+/// Create a new WASME ctx from a previously loaded module.
+/// wasm3 binds a parsed module to one runtime, so each instance has its own
+/// parse and instances of one module may run concurrently. The parse made at
+/// load or by WASME_module_prepare is used if available, otherwise the binary
+/// is parsed here.
+wasme_ctx_t* WASME_instantiate(wasme_module_t* module, uint32_t mem_limit);
+
+/// Parse a module ahead of the next WASME_instantiate if no parse is waiting,
+/// for example while idle after de-initialising an instance so restarting it
+/// does not parse on the instantiate path. Returns 0 or <0 if parsing failed.
+int WASME_module_prepare(wasme_module_t* module);
+
+/// Load a module by mapping the provided file read-only, wasm3 references the
+/// mapping directly so the binary is never copied into RAM.
+/// Flash images can be executed in place by passing their address to WASME_module_load.
+wasme_module_t* WASME_module_load_file(const char* path);
+
+/// Intialise WASME ctx with a private module mapped from the provided file
+wasme_ctx_t* WASME_init_from_file(const char* path, uint32_t mem_limit);
+
+/// Free a loaded module, all instances must be de-initialised first
+void WASME_module_free(wasme_module_t** module);
+
+/// Enable fuel metering and set the remaining budget, one unit is consumed per
+/// wasm function call. When fuel runs out execution is suspended (returning
+/// WASME_SUSPENDED) where fibers are available, otherwise the run traps.
+/// Fuel is only charged at calls, wasm3 provides no hook on loop back-edges,
+/// so a loop that makes no calls is not bounded by fuel and runaway guests of
+/// that form need an external watchdog.
+void WASME_set_fuel(wasme_ctx_t* ctx, uint64_t fuel);
+
+/// Fetch the remaining fuel budget
+uint64_t WASME_get_fuel(wasme_ctx_t* ctx);
+
+/// Disable fuel metering for subsequent runs
+void WASME_disable_fuel(wasme_ctx_t* ctx);
+
+/// Resume a suspended run or call after adding fuel, results of a suspended
+/// call are written to the provided buffer on completion
+int WASME_resume(wasme_ctx_t* ctx, wasme_val_t* results, uint32_t resc);
+
+/// Use a host clock for WASI clocks and host timestamps in place of clock_gettime.
+/// Off posix hosts, contexts without one read clock() processor time for the
+/// monotonic and process clocks, and the realtime clock returns NOSYS.
+void WASME_set_clock(wasme_ctx_t* ctx, const wasme_clock_t* clock, void* arg);
+
+/// Capture linear memory and mutable globals as the reset point for this context
+int WASME_snapshot(wasme_ctx_t* ctx);
+
+/// Restore linear memory and globals to the last snapshot, in place.
+/// Memory is copied back, or on linux builds defining WASME_MMAP_LINEAR_MEMORY
+/// (linear memory allocated from mappings owned by the embedder) whole pages
+/// are restored via a copy-on-write mapping so only pages touched since the
+/// snapshot are copied. Streams, subscriptions and samplers are stopped and
+/// driver handles opened since the snapshot are closed first, handles opened
+/// before it stay open as the restored memory still refers to them.
+int WASME_reset(wasme_ctx_t* ctx);
+
+/// Run the module `_initialize` export if present then snapshot the result
+int WASME_initialize(wasme_ctx_t* ctx);
 // ANCHOR_END: core_api
 
 
@@ -0,0 +1,81 @@
+#ifndef WASME_FRAME_H
+#define WASME_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Serial framing modes
+typedef enum {
+    /// Frames terminated by a delimiter byte, empty frames are skipped
+    WASME_FRAME_DELIM = 0,
+    /// RFC 1055 SLIP framing
+    WASME_FRAME_SLIP = 1,
+    /// Consistent overhead byte stuffing with zero delimiters
+    WASME_FRAME_COBS = 2,
+    /// Little-endian length prefix of 1, 2 or 4 bytes, counting the bytes that follow
+    WASME_FRAME_LEN = 3,
+} wasme_frame_mode_t;
+
+/// Trailing frame check, validated and stripped from decoded frames
+typedef enum {
+    WASME_FRAME_CRC_NONE = 0,
+    /// CRC-16/CCITT-FALSE, big-endian
+    WASME_FRAME_CRC16 = 1,
+    /// CRC-32 (IEEE 802.3), little-endian
+    WASME_FRAME_CRC32 = 2,
+} wasme_frame_crc_t;
+
+/// Feed results
+#define WASME_FRAME_MORE 0
+#define WASME_FRAME_READY 1
+#define WASME_FRAME_ERR_OVERFLOW (-1)
+#define WASME_FRAME_ERR_CODING (-2)
+#define WASME_FRAME_ERR_CRC (-3)
+
+/// Decoder configuration
+typedef struct {
+    wasme_frame_mode_t mode;
+    /// Delimiter for WASME_FRAME_DELIM, or prefix width for WASME_FRAME_LEN
+    uint8_t param;
+    wasme_frame_crc_t crc;
+} wasme_frame_cfg_t;
+
+/// Byte-wise frame decoder state
+typedef struct {
+    wasme_frame_cfg_t cfg;
+    uint8_t* buf;
+    uint32_t cap;
+    /// Bytes decoded into the current frame
+    uint32_t len;
+    /// Length of the last complete frame, valid after WASME_FRAME_READY
+    uint32_t frame_len;
+
+    // Mode state
+    bool esc;
+    bool discard;
+    uint8_t cobs_code;
+    uint32_t need;
+    uint32_t hdr_read;
+} wasme_frame_t;
+
+/// Setup a decoder decoding into the provided buffer
+void WASME_frame_init(wasme_frame_t* f, const wasme_frame_cfg_t* cfg, uint8_t* buf, uint32_t cap);
+
+/// Feed input bytes, stopping once a frame completes or an error is detected.
+/// Returns WASME_FRAME_READY with the frame in `buf[0..frame_len]`, WASME_FRAME_MORE
+/// once all input is consumed or a WASME_FRAME_ERR_ code for a dropped frame.
+int32_t WASME_frame_feed(wasme_frame_t* f, const uint8_t* data, uint32_t len, uint32_t* consumed);
+
+/// Number of bytes that may be read without overshooting the current frame
+uint32_t WASME_frame_want(const wasme_frame_t* f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,7 +13,101 @@ extern "C"
 /// WASME context forward-declaration
 typedef struct wasme_ctx_s wasme_ctx_t;
 
+/// Reactor forward-declaration
+typedef struct wasme_reactor_s wasme_reactor_t;
+
+/// Maximum number of GPIO interrupt subscriptions per context
+#define WASME_GPIO_MAX_IRQS 16
+
+/// Length of each GPIO subscription's event queue, a power of two
+#ifndef WASME_GPIO_EVENT_QUEUE
+#define WASME_GPIO_EVENT_QUEUE 16
+#endif
+
+/// GPIO interrupt triggers
+#define WASME_GPIO_EDGE_RISING (1 << 0)
+#define WASME_GPIO_EDGE_FALLING (1 << 1)
+#define WASME_GPIO_LEVEL_HIGH (1 << 2)
+#define WASME_GPIO_LEVEL_LOW (1 << 3)
+
+/// GPIO event as delivered to the guest, 16 bytes in linear memory
+typedef struct {
+    int32_t handle;
+    int32_t level;
+    int64_t timestamp;
+} wasme_gpio_event_t;
+
+/// GPIO interrupt subscription, passed to drivers to report pin changes
+typedef struct wasme_gpio_irq_s wasme_gpio_irq_t;
+
+/// GPIO driver extension for interrupt subscription. Drivers report each
+/// triggered interrupt with WASME_gpio_irq_fire (or WASME_gpio_irq_fire_isr)
+/// until unsubscribed.
+typedef struct {
+    int32_t (*subscribe)(const void* ctx, int32_t handle, uint32_t triggers, wasme_gpio_irq_t* irq);
+    int32_t (*unsubscribe)(const void* ctx, int32_t handle);
+} wasme_gpio_irq_drv_t;
+
+/// Maximum number of steps in one GPIO waveform
+#define WASME_GPIO_MAX_STEPS 256
+
+/// GPIO waveform step as passed by the guest, three little-endian u32 words:
+/// pins in `mask` are set to `value`, then the next step starts `delay_ns` later
+typedef struct {
+    uint32_t mask;
+    uint32_t value;
+    uint32_t delay_ns;
+} wasme_gpio_step_t;
+
+/// GPIO driver extension for port-wide masked access. `waveform` is optional,
+/// drivers may implement it with timers or DMA, otherwise (or when it returns
+/// __WASI_ERRNO_NOTSUP) the host plays waveforms through `write` with its own timing.
+/// All return 0 or a WASI errno.
+typedef struct {
+    int32_t (*write)(const void* ctx, int32_t port, uint32_t mask, uint32_t value);
+    int32_t (*read)(const void* ctx, int32_t port, uint32_t* value);
+    int32_t (*waveform)(const void* ctx, int32_t port, const wasme_gpio_step_t* steps, uint32_t num_steps);
+} wasme_gpio_port_drv_t;
+
+/// Notification called on the reporting or servicing thread when an event is queued
+typedef void (*wasme_gpio_notify_f)(wasme_ctx_t* ctx, void* arg);
+
 /// Bind the provided GPIO driver to the WASM3 module for use
 int32_t WASME_bind_gpio(wasme_ctx_t* ctx, const gpio_drv_t *drv, void* drv_ctx);
 
+/// Bind a GPIO interrupt driver
+int32_t WASME_bind_gpio_irq(wasme_ctx_t* ctx, const wasme_gpio_irq_drv_t *drv, void* drv_ctx);
+
+/// Bind a GPIO port driver
+int32_t WASME_bind_gpio_port(wasme_ctx_t* ctx, const wasme_gpio_port_drv_t *drv, void* drv_ctx);
+
+/// Report an interrupt with the current pin level, timestamped by the host.
+/// Wakes the guest directly, which may take locks, so thread context only.
+/// Each subscription must be reported from only one thread at a time.
+void WASME_gpio_irq_fire(wasme_gpio_irq_t* irq, int32_t level);
+
+/// Report an interrupt with a driver captured timestamp in nanoseconds, thread context only
+void WASME_gpio_irq_fire_at(wasme_gpio_irq_t* irq, int32_t level, int64_t timestamp);
+
+/// Report an interrupt from interrupt context. Lock-free, the event is queued
+/// but the guest is not woken until WASME_gpio_irq_service is next called.
+void WASME_gpio_irq_fire_isr(wasme_gpio_irq_t* irq, int32_t level, int64_t timestamp);
+
+/// Wake the guest for events reported with WASME_gpio_irq_fire_isr on any of the
+/// context's subscriptions, from thread context such as a driver's deferred handler
+void WASME_gpio_irq_service(wasme_gpio_irq_t* irq);
+
+/// Set a notification for queued events, for hosts dispatching to exported handlers
+void WASME_gpio_set_notify(wasme_ctx_t* ctx, wasme_gpio_notify_f notify, void* arg);
+
+/// Deliver up to `max` queued events to a reactor handler as (handle, level, timestamp),
+/// returning the number delivered or <0 on trap, stopping as for WASME_reactor_dispatch
+/// after a handler that suspends or parks. Must not be mixed with guests
+/// consuming events via gpio.wait_event / gpio.poll_event.
+int WASME_gpio_dispatch(wasme_ctx_t* ctx, wasme_reactor_t* reactor, uint32_t handler, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
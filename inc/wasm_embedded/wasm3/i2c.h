@@ -13,9 +13,47 @@ extern "C"
 /// WASME context forward-declaration
 typedef struct wasme_ctx_s wasme_ctx_t;
 
+/// Maximum number of operations in one I2C transaction
+#define WASME_I2C_MAX_OPS 32
+
+/// I2C transaction operation kinds
+typedef enum {
+    WASME_I2C_OP_WRITE = 0,
+    WASME_I2C_OP_READ = 1,
+} wasme_i2c_op_kind_t;
+
+/// I2C transaction operation as passed by the guest, three little-endian u32
+/// words with the buffer given as a linear memory offset
+typedef struct {
+    uint32_t kind;
+    uint32_t ptr;
+    uint32_t len;
+} wasme_i2c_op_t;
+
+/// I2C transaction operation with the buffer resolved to a host pointer
+typedef struct {
+    wasme_i2c_op_kind_t kind;
+    uint8_t* data;
+    uint32_t len;
+} wasme_i2c_xfer_t;
+
+/// I2C driver extension executing operations on one address as a single
+/// transaction, following embedded-hal `transaction` semantics: START before
+/// the first operation, repeated START between operations of differing kind
+/// and STOP after the last, returning 0 or a WASI errno
+typedef struct {
+    int32_t (*transaction)(const void* ctx, int32_t handle, uint16_t addr, const wasme_i2c_xfer_t* ops, uint32_t num_ops);
+} wasme_i2c_txn_drv_t;
+
 /// Bind the provided I2C driver to the WASM3 module for use
 int32_t WASME_bind_i2c(wasme_ctx_t* ctx, const i2c_drv_t *drv, void* drv_ctx);
 
+/// Bind an I2C transaction driver, without one transactions fall back to the
+/// I2C driver, supporting a single write, a single read or a write-then-read
+/// pair using write_read, other sequences return __WASI_ERRNO_NOTSUP.
+/// Fails with -1 while a bus is bound (see WASME_bind_i2c_bus).
+int32_t WASME_bind_i2c_txn(wasme_ctx_t* ctx, const wasme_i2c_txn_drv_t *drv, void* drv_ctx);
+
 #ifdef __cplusplus
 }
 #endif
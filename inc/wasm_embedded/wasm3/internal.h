@@ -2,12 +2,492 @@
 #ifndef WASME_INT_H
 #define WASME_INT_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+
 #include "wasm3.h"
 
+#include "wasm_embedded/wasm3/core.h"
+#include "wasm_embedded/wasm3/async.h"
+#include "wasm_embedded/wasm3/wasi.h"
+#include "wasm_embedded/wasm3/spi.h"
+#include "wasm_embedded/wasm3/i2c.h"
+#include "wasm_embedded/wasm3/uart.h"
+#include "wasm_embedded/wasm3/buf.h"
+#include "wasm_embedded/wasm3/gpio.h"
+#include "wasm_embedded/wasm3/sampler.h"
+#include "wasm_embedded/wasm3/bus.h"
+#include "wasm_embedded/wasm3/console.h"
+#include "wasm_embedded/wasm3/vfs.h"
+
+#include "wasm_embedded/gpio.h"
+#include "wasm_embedded/spi.h"
+#include "wasm_embedded/i2c.h"
+#include "wasm_embedded/uart.h"
+
+// Modules may be loaded from memory mapped files on posix hosts
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(WASME_NO_MMAP)
+#define WASME_USE_MMAP
+#endif
+
+// Threaded scheduling uses pthreads on posix hosts
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(WASME_NO_THREADS)
+#define WASME_USE_THREADS
+#endif
+
+// Suspendable execution uses ucontext fibers with glibc
+#if defined(__GLIBC__) && !defined(WASME_NO_FIBERS)
+#define WASME_USE_FIBERS
+#endif
+
+// Stack size for fibers executing metered runs, wasm3 recurses on the native stack
+#ifndef WASME_FIBER_STACK_SIZE
+#define WASME_FIBER_STACK_SIZE (256 * 1024)
+#endif
+
+// Copy-on-write snapshots map a memfd privately over linear memory on linux.
+// wasm3 allocates linear memory with malloc/realloc by default, which must not
+// have mappings replaced underneath the allocator, so this is only enabled for
+// builds defining WASME_MMAP_LINEAR_MEMORY whose wasm3 allocator serves linear
+// memory from page aligned mappings owned by the embedder
+#if defined(__linux__) && defined(WASME_MMAP_LINEAR_MEMORY) && !defined(WASME_NO_COW_SNAPSHOT)
+#define WASME_COW_SNAPSHOT
+#endif
+
+// Saved instance state used to reset a context in place
+typedef struct {
+    bool valid;
+    // Linear memory up to the last non-zero byte, the remainder is zeroed on reset
+    uint8_t* mem;
+    uint32_t mem_len;
+    uint32_t num_pages;
+    // Mutable global values, immutable globals have type c_m3Type_none
+    M3TaggedValue* globals;
+    uint32_t num_globals;
+    // Handle table allocation count, handles opened since are closed on reset
+    uint32_t handle_seq;
+#ifdef WASME_COW_SNAPSHOT
+    // memfd holding the page aligned interior of linear memory, or -1 if unused
+    int cow_fd;
+    // Offset of the first whole page from the start of linear memory
+    uint32_t cow_offset;
+    uint32_t cow_len;
+#endif
+} wasme_snapshot_t;
+
+// Run or call executed on a fiber when fuel metering is enabled,
+// arguments and results are held here so they outlive suspension
+typedef struct {
+    // Function by name for runs, or resolved function for calls
+    const char* name;
+    wasme_func_t* func;
+    wasme_val_t args[WASME_MAX_VALS];
+    uint32_t argc;
+    wasme_val_t results[WASME_MAX_VALS];
+    uint32_t resc;
+    // Result once complete
+    int result;
+    bool done;
+    // Set while suspended awaiting WASME_resume
+    bool suspended;
+    // Set by the fiber when parking on a driver, and while parked
+    bool parking;
+    bool pending;
+} wasme_exec_t;
+
+// Pending driver operation state
+enum {
+    WASME_ASYNC_IDLE = 0,
+    WASME_ASYNC_WAITING = 1,
+    WASME_ASYNC_COMPLETE = 2,
+};
+
+// UART receive stream into a guest ring buffer
+struct wasme_uart_stream_s {
+    wasme_ctx_t* ctx;
+    int32_t handle;
+    bool active;
+    // Ring header offset in linear memory, resolved per push as memory may move
+    uint32_t ring_ptr;
+    uint32_t size;
+    // Set while the guest is waiting for data
+    atomic_bool waiting;
+};
+
+// GPIO interrupt subscription
+struct wasme_gpio_irq_s {
+    wasme_ctx_t* ctx;
+    int32_t handle;
+    // Handle reported to the guest in events
+    int32_t guest_handle;
+    uint32_t triggers;
+    bool active;
+    // Events within the debounce window of the last accepted event are dropped
+    int64_t debounce_ns;
+    int64_t last_ns;
+    bool has_last;
+    // Single-producer single-consumer event ring, written only by the reporting
+    // driver so firing never waits on another producer
+    wasme_gpio_event_t* events;
+    atomic_uint head;
+    atomic_uint tail;
+};
+
+// GPIO event storage shared by the per-subscription rings
+typedef struct {
+    // WASME_GPIO_MAX_IRQS rings of WASME_GPIO_EVENT_QUEUE events
+    wasme_gpio_event_t* events;
+    atomic_uint dropped;
+    // Set while the guest is waiting for an event
+    atomic_bool waiting;
+    // Set by interrupt context reports until woken from thread context
+    atomic_bool pending;
+    wasme_gpio_notify_f notify;
+    void* notify_arg;
+} wasme_gpio_queue_t;
+
+// Host-side frame decoder bound to a UART handle
+typedef struct {
+    bool active;
+    int32_t handle;
+    wasme_frame_t frame;
+} wasme_uart_framer_t;
+
+// Periodic bus transaction writing samples into a guest ring
+struct wasme_sampler_s {
+    bool active;
+    wasme_sampler_cfg_t cfg;
+    int64_t period_ns;
+    int64_t next_ns;
+    // Ring data capacity, the header is resolved per sample as memory may move
+    uint32_t size;
+    // Set while the guest is waiting for a sample
+    atomic_bool waiting;
+};
+
+// Context binding to a shared bus, passed as the driver context
+typedef struct {
+    wasme_bus_t* bus;
+    uint32_t priority;
+} wasme_bus_client_t;
+
+// Timer thread state for samplers
+typedef struct wasme_sampler_host_s wasme_sampler_host_t;
+
+// Buffered console output state
+typedef struct wasme_console_host_s wasme_console_host_t;
+
+// Mounted filesystems and files opened by the guest
+typedef struct wasme_vfs_s wasme_vfs_t;
+
+// Maximum number of driver handles open per context
+#define WASME_MAX_HANDLES 64
+
+// Kinds of driver handle held in a context handle table
+typedef enum {
+    WASME_HANDLE_FREE = 0,
+    WASME_HANDLE_GPIO = 1,
+    WASME_HANDLE_SPI = 2,
+    WASME_HANDLE_I2C = 3,
+    WASME_HANDLE_UART = 4,
+} wasme_handle_kind_t;
+
+// Driver handle held on behalf of the guest
+typedef struct {
+    uint8_t kind;
+    // Incremented on release so stale guest handles are rejected
+    uint16_t generation;
+    int32_t drv_handle;
+    // Table allocation count when opened, orders handles against snapshots
+    uint32_t seq;
+} wasme_handle_t;
+
+// Guest handles are (generation << 8 | index) into this table
+typedef struct {
+    wasme_handle_t entries[WASME_MAX_HANDLES];
+    // Stack of free entry indices
+    uint8_t free[WASME_MAX_HANDLES];
+    uint32_t num_free;
+    // Number of handles allocated
+    uint32_t seq;
+} wasme_handle_table_t;
+
+// Module parsed into its own environment, ready to load into a new runtime.
+// wasm3 binds a parsed module to one runtime and environments are not thread
+// safe, so every instance needs one of these.
+typedef struct {
+    IM3Environment env;
+    IM3Module mod;
+} wasme_parsed_t;
+
+struct wasme_module_s {
+    // Validated module binary, wasm3 references this directly
+    const uint8_t* data;
+    uint32_t data_len;
+    // Read-only file mapping backing data when loaded from a file
+    void* map;
+    size_t map_len;
+    // Parsed module handed to the next instance, prepared at load and again
+    // as instances are de-initialised so instantiation does not parse
+    _Atomic(wasme_parsed_t*) spare;
+    // Number of live instances
+    atomic_uint instances;
+};
+
 struct wasme_ctx_s {
+    // Environment private to this instance
     IM3Environment env;
     IM3Runtime rt;
     IM3Module mod;
+    // Module this context was instantiated from
+    wasme_module_t* module;
+    // Set when the module is private to this context (via WASME_init)
+    bool owns_module;
+    // Reset point captured by WASME_snapshot
+    wasme_snapshot_t snapshot;
+    // Set while stream or sampler rings hold linear memory at its current size,
+    // with the page limit restored once the last is released
+    bool mem_pinned;
+    uint32_t mem_max_pages;
+
+    // Drivers bound to this context, delivered to raw functions via link userdata
+    const gpio_drv_t* gpio_drv;
+    const void* gpio_drv_ctx;
+    const wasme_gpio_irq_drv_t* gpio_irq_drv;
+    const void* gpio_irq_drv_ctx;
+    const wasme_gpio_port_drv_t* gpio_port_drv;
+    const void* gpio_port_drv_ctx;
+    struct wasme_gpio_irq_s gpio_irqs[WASME_GPIO_MAX_IRQS];
+    struct wasme_sampler_s samplers[WASME_SAMPLER_MAX];
+    wasme_handle_table_t handles;
+    wasme_sampler_host_t* sampler_host;
+    wasme_gpio_queue_t gpio_events;
+    // Buffered guest console output, written directly when NULL
+    wasme_console_host_t* console;
+    // Virtual filesystem, allocated on the first mount
+    wasme_vfs_t* vfs;
+    // poll_oneoff event loop descriptors, created on first use
+    bool poll_init;
+    int poll_epfd;
+    int poll_evfd;
+    int poll_tfd;
+    // Set while poll_oneoff is blocked so producers signal the event descriptor
+    atomic_bool poll_waiting;
+    const spi_drv_t* spi_drv;
+    const void* spi_drv_ctx;
+    const wasme_spi_exec_drv_t* spi_exec_drv;
+    const void* spi_exec_drv_ctx;
+    const wasme_spi_vec_drv_t* spi_vec_drv;
+    const void* spi_vec_drv_ctx;
+    wasme_bus_client_t spi_bus_client;
+    const i2c_drv_t* i2c_drv;
+    const void* i2c_drv_ctx;
+    const wasme_i2c_txn_drv_t* i2c_txn_drv;
+    const void* i2c_txn_drv_ctx;
+    wasme_bus_client_t i2c_bus_client;
+    const uart_drv_t* uart_drv;
+    const void* uart_drv_ctx;
+    const wasme_uart_vec_drv_t* uart_vec_drv;
+    const void* uart_vec_drv_ctx;
+    const wasme_uart_stream_drv_t* uart_stream_drv;
+    const void* uart_stream_drv_ctx;
+    struct wasme_uart_stream_s uart_streams[WASME_UART_MAX_STREAMS];
+    wasme_uart_framer_t uart_framers[WASME_UART_MAX_FRAMERS];
+
+    // Bounce buffers for coalescing scatter-gather lists
+    wasme_dma_pool_t* dma_pool;
+
+    // WASI state for this context
+    m3_wasi_context_t wasi;
+
+    // Fuel metering state, one unit is consumed per wasm function call
+    bool fuel_enabled;
+    uint64_t fuel;
+    wasme_exec_t exec;
+    struct wasme_fiber_s* fiber;
+
+    // Asynchronous driver operations
+    bool async_enabled;
+    bool async_blocking;
+    atomic_int async_state;
+    int32_t async_result;
+    wasme_async_notify_f async_notify;
+    void* async_notify_arg;
+
+    // Scheduler requests pending for this context, protected by the scheduler lock
+    struct wasme_job_s* sched_jobs;
+    struct wasme_job_s* sched_jobs_tail;
+    // Set while the context is queued on or executing in a worker
+    bool sched_queued;
+    // Worker this context last ran on
+    uint32_t sched_home;
 };
 
+/// Resolve a guest buffer, returning NULL if it lies outside linear memory
+static inline uint8_t* wasme_mem_range(IM3Runtime rt, uint32_t offset, uint32_t len) {
+    uint32_t mem_len = 0;
+    uint8_t* mem = m3_GetMemory(rt, &mem_len, 0);
+
+    if (!mem || (uint64_t)offset + len > mem_len) {
+        return NULL;
+    }
+
+    return mem + offset;
+}
+
+/// Single buffer driver operation used to emulate scatter-gather transfers
+typedef int32_t (*wasme_iov_op_f)(wasme_ctx_t* ctx, const void* arg, uint8_t* data, uint32_t len);
+
+/// Resolve and bounds check a guest scatter-gather list of `{ ptr, len }` pairs,
+/// returning 0 or a WASI errno
+int32_t wasme_iov_resolve(IM3Runtime rt, uint32_t iovs_ptr, uint32_t iovs_len, wasme_iovec_t* iov);
+
+/// Transfer a scatter-gather list using a single buffer driver operation, via
+/// a bounce buffer where the context has a DMA pool or otherwise per segment
+int32_t wasme_iov_fallback(wasme_ctx_t* ctx, bool write, const wasme_iovec_t* iov, uint32_t iov_len,
+        wasme_iov_op_f op, const void* arg);
+
+/// Copy `len` bytes into a guest ring of power-of-two `size` whose head and tail
+/// are the first two `hdr` words, advancing the head. Copies as much as fits, or
+/// nothing unless all of it fits where `whole` is set, returning the bytes copied
+uint32_t wasme_ring_push(_Atomic uint32_t* hdr, uint8_t* ring, uint32_t size, const uint8_t* data, uint32_t len,
+        bool whole);
+
+/// Execute a run without metering
+int wasme_exec_run(wasme_ctx_t* ctx, const char* name);
+
+/// Execute a call without metering
+int wasme_exec_call(wasme_ctx_t* ctx, wasme_func_t* func, const wasme_val_t* args, uint32_t argc,
+        wasme_val_t* results, uint32_t resc);
+
+/// Execute a metered run (name set) or call (func set), returning WASME_SUSPENDED
+/// if fuel is exhausted before completion
+int wasme_fuel_exec(wasme_ctx_t* ctx, const char* name, wasme_func_t* func,
+        const wasme_val_t* args, uint32_t argc, wasme_val_t* results, uint32_t resc);
+
+/// Fetch the context executing on this thread via wasme_fuel_exec
+wasme_ctx_t* wasme_exec_current(void);
+
+/// Check whether the calling code is running on the context's fiber
+bool wasme_fiber_active(wasme_ctx_t* ctx);
+
+/// Switch from the context's fiber back to its caller to await a driver
+void wasme_fiber_park(wasme_ctx_t* ctx);
+
+/// Resolve a driver result, parking or blocking the task if the driver returned
+/// WASME_DRV_PENDING until WASME_async_complete is called
+int32_t wasme_async_wait(wasme_ctx_t* ctx, int32_t res);
+
+/// Block the calling thread until a driver operation that returned WASME_DRV_PENDING
+/// completes, returning its result
+int32_t wasme_async_block(wasme_ctx_t* ctx);
+
+/// Mark a parked task as waiting, returns false if the driver already completed
+bool wasme_async_park(wasme_ctx_t* ctx);
+
+/// Check whether a parked task's driver operation has completed
+bool wasme_async_ready(wasme_ctx_t* ctx);
+
+/// Release fiber storage held by a context
+void wasme_fuel_deinit(wasme_ctx_t* ctx);
+
+/// Read the monotonic clock in nanoseconds, via the context clock hook if set
+int64_t wasme_clock_monotonic(wasme_ctx_t* ctx);
+
+/// Link WASI poll_oneoff, bound to the context for driver events
+int32_t wasme_poll_link(wasme_ctx_t* ctx);
+
+/// Wake a blocked poll_oneoff, use wasme_poll_notify
+void wasme_poll_signal(wasme_ctx_t* ctx);
+
+/// Close poll_oneoff event loop descriptors
+void wasme_poll_deinit(wasme_ctx_t* ctx);
+
+/// Print runtime diagnostics via the context console sink, or stdout when unset
+void wasme_console_printf(wasme_ctx_t* ctx, const char* fmt, ...);
+
+/// Flush and release the context console sink
+void wasme_console_deinit(wasme_ctx_t* ctx);
+
+/// Check whether a guest fd is served by the VFS, all fds after stdio are once a filesystem is mounted
+bool wasme_vfs_owns(wasme_vfs_t* vfs, uint32_t fd);
+
+/// Fetch the mount path of a preopen fd, returning a WASI errno
+uint32_t wasme_vfs_prestat(wasme_vfs_t* vfs, uint32_t fd, const char** path);
+
+/// Open a path relative to a directory fd, returning a WASI errno
+uint32_t wasme_vfs_open(wasme_vfs_t* vfs, uint32_t dirfd, const char* path, uint32_t path_len,
+        uint32_t oflags, uint64_t rights, uint32_t fdflags, uint32_t* fd);
+
+/// Close a file opened by the guest, returning a WASI errno
+uint32_t wasme_vfs_close(wasme_vfs_t* vfs, uint32_t fd);
+
+/// Read from a file at `offset`, or at and advancing the file position when NULL
+uint32_t wasme_vfs_read(wasme_vfs_t* vfs, uint32_t fd, uint8_t* data, uint32_t len, const uint64_t* offset, uint32_t* n);
+
+/// Write to a file at `offset`, or at and advancing the file position when NULL
+uint32_t wasme_vfs_write(wasme_vfs_t* vfs, uint32_t fd, const uint8_t* data, uint32_t len, const uint64_t* offset, uint32_t* n);
+
+/// Move the file position, `whence` is SEEK_SET, SEEK_CUR or SEEK_END
+uint32_t wasme_vfs_seek(wasme_vfs_t* vfs, uint32_t fd, int64_t offset, int whence, uint64_t* pos);
+
+/// Fetch metadata for a file or preopen, with its fd flags and whether it is writable
+uint32_t wasme_vfs_stat(wasme_vfs_t* vfs, uint32_t fd, wasme_vfs_stat_t* st, uint16_t* fdflags, bool* writable);
+
+/// Pack directory entries from `cookie` into a WASI fd_readdir buffer
+uint32_t wasme_vfs_readdir(wasme_vfs_t* vfs, uint32_t fd, uint8_t* buf, uint32_t len, uint64_t cookie, uint32_t* used);
+
+/// Close files left open by the guest, mounts are kept
+void wasme_vfs_release(wasme_ctx_t* ctx);
+
+/// Release VFS state, mounted filesystems are owned by the host
+void wasme_vfs_deinit(wasme_ctx_t* ctx);
+
+/// Setup an empty handle table for a new context
+void wasme_handles_init(wasme_ctx_t* ctx);
+
+/// Track a driver handle opened by the guest, returns the guest handle or -1 if the table is full
+int32_t wasme_handle_alloc(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t drv_handle);
+
+/// Resolve a guest handle of the given kind to its driver handle, returns
+/// __WASI_ERRNO_BADF for stale, released or mismatched handles
+int32_t wasme_handle_get(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t handle, int32_t* drv_handle);
+
+/// Stop resources using a guest handle, deinit its driver handle and release it
+int32_t wasme_handle_close(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t handle);
+
+/// Stop all streams, subscriptions and samplers and close handles opened at or
+/// after allocation `since`, 0 on teardown or the snapshot count on reset
+void wasme_handles_release(wasme_ctx_t* ctx, uint32_t since);
+
+/// Stop samplers executing on a driver handle
+void wasme_sampler_drop(wasme_ctx_t* ctx, uint32_t bus, int32_t drv_handle);
+
+/// Stop sampler timers and release their state
+void wasme_sampler_deinit(wasme_ctx_t* ctx);
+
+/// Setup empty snapshot storage for a new context
+void wasme_snapshot_init(wasme_ctx_t* ctx);
+
+/// Release snapshot storage held by a context
+void wasme_snapshot_deinit(wasme_ctx_t* ctx);
+
+/// Check whether any GPIO subscription ring holds an event
+bool wasme_gpio_pending(wasme_ctx_t* ctx);
+
+/// Discard queued GPIO events
+void wasme_gpio_flush(wasme_ctx_t* ctx);
+
+/// Stop linear memory growing while UART streams or samplers are active, as
+/// producers on other threads or interrupts write their rings in place.
+/// Called after starting or stopping either, from the executing thread.
+void wasme_mem_pin_update(wasme_ctx_t* ctx);
+
+/// Report a driver event (stream data, GPIO event, sample) to a blocked poll_oneoff
+static inline void wasme_poll_notify(wasme_ctx_t* ctx) {
+    if (atomic_load(&ctx->poll_waiting)) {
+        wasme_poll_signal(ctx);
+    }
+}
+
 #endif
@@ -0,0 +1,23 @@
+#ifndef WASME_POLL_H
+#define WASME_POLL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Pseudo file descriptor for driver events in WASI `poll_oneoff`. An fd_read
+/// subscription on it is ready while a UART stream or sampler ring holds data
+/// or a GPIO event is queued, the guest then drains the rings and queue itself.
+#define WASME_POLL_EVENT_FD 0x7FFFFF00
+
+/// Maximum number of subscriptions in one `poll_oneoff` call
+#define WASME_POLL_MAX_SUBS 64
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef WASME_POOL_H
+#define WASME_POOL_H
+
+#include <stdint.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Pool of pre-instantiated WASME contexts. Contexts may be acquired and
+/// released from any thread where threads are supported (WASME_USE_THREADS),
+/// otherwise the pool must only be used from one thread.
+typedef struct wasme_pool_s wasme_pool_t;
+
+/// Setup callback, called once per pooled context to bind drivers
+typedef int32_t (*wasme_pool_setup_f)(wasme_ctx_t* ctx, void* arg);
+
+/// Create a pool of `size` ready-to-run contexts from the provided module.
+/// Each context is set up with `setup` then snapshotted as its reset point.
+wasme_pool_t* WASME_pool_init(wasme_module_t* module, uint32_t mem_limit, uint32_t size,
+        wasme_pool_setup_f setup, void* setup_arg);
+
+/// Take a ready context from the pool, returns NULL if all are in use
+wasme_ctx_t* WASME_pool_acquire(wasme_pool_t* pool);
+
+/// Reset a context to its post-setup state and return it to the pool.
+/// Contexts that fail to reset are replaced with a fresh instance. Returns -1 if
+/// `ctx` is not currently acquired from this pool and -2 if it could not be
+/// replaced, in which case the pool is one context smaller.
+int WASME_pool_release(wasme_pool_t* pool, wasme_ctx_t* ctx);
+
+/// De-initialise a pool and all pooled contexts
+void WASME_pool_deinit(wasme_pool_t** pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef WASME_REACTOR_H
+#define WASME_REACTOR_H
+
+#include <stdint.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Maximum number of handlers per reactor
+#define WASME_REACTOR_MAX_HANDLERS 16
+
+/// Reactor event, delivered to the exported handler as `i32 (i32 source, i32 value, i64 timestamp)`
+typedef struct {
+    uint32_t handler;
+    int32_t source;
+    int32_t value;
+    int64_t timestamp;
+} wasme_event_t;
+
+/// Reactor dispatching events to exported handlers of an initialised module
+typedef struct wasme_reactor_s wasme_reactor_t;
+
+/// Setup a reactor on the provided ctx, running `_initialize` if exported.
+/// `queue_len` must be a power of two.
+wasme_reactor_t* WASME_reactor_init(wasme_ctx_t* ctx, uint32_t queue_len);
+
+/// Resolve an exported handler once, returning a handler id for events or <0 on error
+int32_t WASME_reactor_handler(wasme_reactor_t* reactor, const char* name);
+
+/// Queue an event for dispatch, safe to call from a single producer concurrently
+/// with dispatch. Returns <0 if the queue is full.
+int WASME_reactor_post(wasme_reactor_t* reactor, const wasme_event_t* event);
+
+/// Dispatch up to `max` queued events, returning the number dispatched or <0 on trap.
+/// Dispatch stops after a handler that suspends or parks, and returns 0 until
+/// the handler is completed with WASME_resume.
+int WASME_reactor_dispatch(wasme_reactor_t* reactor, uint32_t max);
+
+/// Invoke a handler immediately, bypassing the queue. Executes as WASME_call,
+/// so handlers are metered and may park on async drivers, returning
+/// WASME_SUSPENDED or WASME_PENDING with the result then fetched by
+/// WASME_resume into a single i32 value.
+int WASME_reactor_call(wasme_reactor_t* reactor, const wasme_event_t* event, int32_t* result);
+
+/// De-initialise a reactor, the ctx is left intact
+void WASME_reactor_deinit(wasme_reactor_t** reactor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef WASME_SAMPLER_H
+#define WASME_SAMPLER_H
+
+#include <stdint.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Maximum number of concurrently running samplers per context
+#define WASME_SAMPLER_MAX 8
+
+/// Maximum number of bytes read per sample
+#define WASME_SAMPLER_MAX_LEN 64
+
+/// Bus a sampler transaction is executed on
+#define WASME_SAMPLER_BUS_I2C 0
+#define WASME_SAMPLER_BUS_SPI 1
+
+/// Sampler configuration as passed by the guest, eight little-endian u32 words.
+/// I2C samplers write `reg` to `addr` then read `len` bytes, SPI samplers transfer
+/// `reg` followed by `len` filler bytes and keep the `len` bytes clocked in after it.
+typedef struct {
+    uint32_t bus;
+    int32_t handle;
+    uint32_t addr;
+    uint32_t reg;
+    uint32_t len;
+    uint32_t period_us;
+    uint32_t ring_ptr;
+    uint32_t ring_len;
+} wasme_sampler_cfg_t;
+
+/// Size of the header preceding sample ring data in guest memory, laid out as
+/// a UART stream ring (head, tail, size, dropped) with dropped counting samples
+#define WASME_SAMPLER_RING_HDR 16
+
+/// Size of the header preceding each sample in the ring: u64 monotonic timestamp
+/// in nanoseconds, i32 driver result and u32 length. Sample data follows padded
+/// to a multiple of four bytes and samples are only stored whole.
+#define WASME_SAMPLER_SAMPLE_HDR 16
+
+/// Link the sampler functions, executing transactions through the I2C and SPI
+/// drivers bound to the context. Drivers must be safe to call from the sampler
+/// thread concurrently with execution and complete synchronously. Linear memory
+/// cannot grow while a sampler is running, memory.grow fails instead.
+int32_t WASME_bind_sampler(wasme_ctx_t* ctx);
+
+/// Execute samplers due at `now_ns` (CLOCK_MONOTONIC), for hosts driving
+/// samplers from their own timer. Returns the time of the next due sample,
+/// or INT64_MAX when no samplers are running.
+int64_t WASME_sampler_tick(wasme_ctx_t* ctx, int64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef WASME_SCHED_H
+#define WASME_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Multi-core scheduler executing run/call requests for many contexts.
+/// Requests for one context execute in submission order and never concurrently.
+typedef struct wasme_sched_s wasme_sched_t;
+
+/// Scheduler configuration
+typedef struct {
+    /// Number of worker threads, 0 for one per online core
+    uint32_t workers;
+    /// Pin each worker thread to a core
+    bool pin_workers;
+    /// Fuel granted to a request before it is suspended and requeued behind
+    /// other runnable contexts, 0 to run requests to completion
+    uint64_t fuel_slice;
+} wasme_sched_cfg_t;
+
+/// Completion callback, called on the worker thread with the run/call result.
+/// Requests that cannot be requeued fail with -1, a request failed while parked
+/// on a driver leaves the context suspended until it is reset.
+typedef void (*wasme_sched_cb_f)(wasme_ctx_t* ctx, int result, void* arg);
+
+/// Create a scheduler and start its worker threads
+wasme_sched_t* WASME_sched_init(const wasme_sched_cfg_t* cfg);
+
+/// Queue a run of the named function, `name` must remain valid until completion
+int WASME_sched_run(wasme_sched_t* sched, wasme_ctx_t* ctx, const char* name,
+        wasme_sched_cb_f cb, void* cb_arg);
+
+/// Queue a call of a resolved function, arguments are copied and results written
+/// to `results` (which must remain valid) before the callback is invoked
+int WASME_sched_call(wasme_sched_t* sched, wasme_ctx_t* ctx, wasme_func_t* func,
+        const wasme_val_t* args, uint32_t argc, wasme_val_t* results, uint32_t resc,
+        wasme_sched_cb_f cb, void* cb_arg);
+
+/// Block until all queued requests have completed
+void WASME_sched_wait(wasme_sched_t* sched);
+
+/// Stop worker threads and free the scheduler, queued requests are completed first
+void WASME_sched_deinit(wasme_sched_t** sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "wasm_embedded/spi.h"
+#include "wasm_embedded/wasm3/buf.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -13,9 +14,69 @@ extern "C"
 /// WASME context forward-declaration
 typedef struct wasme_ctx_s wasme_ctx_t;
 
+/// Maximum number of operations in one SPI exec call
+#define WASME_SPI_MAX_OPS 64
+
+/// SPI exec operation kinds
+typedef enum {
+    /// Write `len` bytes from `write`
+    WASME_SPI_OP_WRITE = 0,
+    /// Read `len` bytes into `read`
+    WASME_SPI_OP_READ = 1,
+    /// Full duplex transfer of `len` bytes
+    WASME_SPI_OP_TRANSFER = 2,
+    /// Full duplex transfer of `len` bytes in place, `read` and `write` alias
+    WASME_SPI_OP_TRANSFER_INPLACE = 3,
+    /// Delay for `len` microseconds
+    WASME_SPI_OP_DELAY_US = 4,
+    /// Assert (`len` != 0) or release (`len` == 0) chip select
+    WASME_SPI_OP_CS = 5,
+} wasme_spi_op_kind_t;
+
+/// SPI exec operation as passed by the guest, four little-endian u32 words
+/// with buffers given as linear memory offsets
+typedef struct {
+    uint32_t kind;
+    uint32_t read_ptr;
+    uint32_t write_ptr;
+    uint32_t len;
+} wasme_spi_op_t;
+
+/// SPI exec operation with buffers resolved to host pointers
+typedef struct {
+    wasme_spi_op_kind_t kind;
+    uint8_t* read;
+    uint8_t* write;
+    uint32_t len;
+} wasme_spi_xfer_t;
+
+/// SPI driver extension executing an operation list with chip select held
+/// across the sequence, unless released by a WASME_SPI_OP_CS operation,
+/// returning 0 or a WASI errno
+typedef struct {
+    int32_t (*exec)(const void* ctx, int32_t handle, const wasme_spi_xfer_t* ops, uint32_t num_ops);
+} wasme_spi_exec_drv_t;
+
+/// SPI driver extension for scatter-gather transfers, each list is sent as one
+/// transfer with chip select held across segments, returning 0 or a WASI errno
+typedef struct {
+    int32_t (*writev)(const void* ctx, int32_t handle, const wasme_iovec_t* iov, uint32_t iov_len);
+    int32_t (*readv)(const void* ctx, int32_t handle, const wasme_iovec_t* iov, uint32_t iov_len);
+} wasme_spi_vec_drv_t;
+
 /// Bind the provided SPI driver to the WASM3 module for use
 int32_t WASME_bind_spi(wasme_ctx_t* ctx, const spi_drv_t *drv, void* drv_ctx);
 
+/// Bind an SPI exec driver, without one exec falls back to individual
+/// operations on the SPI driver and lists containing chip select operations
+/// fail with NOTSUP before any operation runs.
+/// Fails with -1 while a bus is bound (see WASME_bind_spi_bus).
+int32_t WASME_bind_spi_exec(wasme_ctx_t* ctx, const wasme_spi_exec_drv_t *drv, void* drv_ctx);
+
+/// Bind an SPI scatter-gather driver, without one lists are coalesced through
+/// the context DMA pool or sent per segment. Fails with -1 while a bus is bound.
+int32_t WASME_bind_spi_vec(wasme_ctx_t* ctx, const wasme_spi_vec_drv_t *drv, void* drv_ctx);
+
 #ifdef __cplusplus
 }
 #endif
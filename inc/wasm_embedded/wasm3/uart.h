@@ -4,6 +4,8 @@
 #include <stdint.h>
 
 #include "wasm_embedded/uart.h"
+#include "wasm_embedded/wasm3/buf.h"
+#include "wasm_embedded/wasm3/frame.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -13,9 +15,54 @@ extern "C"
 /// WASME context forward-declaration
 typedef struct wasme_ctx_s wasme_ctx_t;
 
+/// UART driver extension for scatter-gather reads and writes, returning 0 or
+/// a WASI errno
+typedef struct {
+    int32_t (*writev)(const void* ctx, int32_t handle, uint32_t flags, const wasme_iovec_t* iov, uint32_t iov_len);
+    int32_t (*readv)(const void* ctx, int32_t handle, uint32_t flags, const wasme_iovec_t* iov, uint32_t iov_len);
+} wasme_uart_vec_drv_t;
+
+/// Maximum number of concurrently open UART streams per context
+#define WASME_UART_MAX_STREAMS 4
+
+/// Maximum number of UART handles with framing configured per context
+#define WASME_UART_MAX_FRAMERS 4
+
+/// Size of the header preceding stream ring data in guest memory. The header is
+/// four little-endian u32 words: head (written by the host), tail (written by
+/// the guest), size (power of two data capacity) and dropped (bytes lost to overflow).
+#define WASME_UART_STREAM_HDR 16
+
+/// Receive stream delivering bytes into a ring buffer in guest memory
+typedef struct wasme_uart_stream_s wasme_uart_stream_t;
+
+/// UART driver extension for streaming receive. `start` is called when the guest
+/// opens a stream, after which the driver pushes received bytes with
+/// WASME_uart_stream_push until `stop` is called. Both return 0 or a WASI errno.
+/// Linear memory cannot grow while a stream is open, memory.grow fails instead.
+typedef struct {
+    int32_t (*start)(const void* ctx, int32_t handle, wasme_uart_stream_t* stream);
+    int32_t (*stop)(const void* ctx, int32_t handle);
+} wasme_uart_stream_drv_t;
+
 /// Bind the provided UART driver to the WASM3 module for use
 int32_t WASME_bind_uart(wasme_ctx_t* ctx, const uart_drv_t *drv, void* drv_ctx);
 
+/// Bind a UART scatter-gather driver, without one lists are coalesced through
+/// the context DMA pool or transferred per segment
+int32_t WASME_bind_uart_vec(wasme_ctx_t* ctx, const wasme_uart_vec_drv_t *drv, void* drv_ctx);
+
+/// Bind a UART streaming driver
+int32_t WASME_bind_uart_stream(wasme_ctx_t* ctx, const wasme_uart_stream_drv_t *drv, void* drv_ctx);
+
+/// Push received bytes into a stream ring, waking the guest if it is waiting.
+/// Safe to call from a single producer thread concurrently with execution but
+/// not from interrupt context, as waking may take locks. Returns the number of
+/// bytes stored with the remainder dropped.
+/// Rings whose guest-written tail is inconsistent with the head are treated
+/// as full so a misbehaving guest cannot direct writes outside the ring.
+uint32_t WASME_uart_stream_push(wasme_uart_stream_t* stream, const uint8_t* data, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,132 @@
+#ifndef WASME_VFS_H
+#define WASME_VFS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wasm_embedded/wasm3/core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// Maximum number of mounted filesystems (WASI preopens) per context
+#define WASME_VFS_MAX_MOUNTS 4
+
+/// Maximum number of files and directories open per context
+#define WASME_VFS_MAX_FILES 16
+
+/// Guest fd of the first mount, following stdio. Mounts take consecutive fds
+/// and files opened by the guest follow the mounts.
+#define WASME_VFS_FD_BASE 3
+
+/// Maximum length of a mount path or of a path opened by the guest
+#define WASME_VFS_PATH_MAX 256
+
+/// Maximum directory depth of a path opened by the guest
+#define WASME_VFS_DEPTH_MAX 16
+
+/// Node types, matching WASI filetypes
+#define WASME_VFS_DIR 3
+#define WASME_VFS_FILE 4
+
+/// Node metadata
+typedef struct {
+    uint64_t ino;
+    uint64_t size;
+    uint8_t type;
+} wasme_vfs_stat_t;
+
+/// Directory entry, the name is not nul-terminated and must remain valid
+/// until the next filesystem call
+typedef struct {
+    uint64_t ino;
+    uint8_t type;
+    const char* name;
+    uint32_t name_len;
+} wasme_vfs_dirent_t;
+
+/// Filesystem operations. Nodes are opaque pointers that must remain valid
+/// while the filesystem is mounted. Operations return zero or a byte count on
+/// success and a negated WASI errno on failure. Filesystems may be mounted in
+/// several contexts, which must then not execute concurrently.
+typedef struct wasme_vfs_ops_s {
+    /// Fetch the root directory
+    void* (*root)(void* fs);
+    /// Find `name` in a directory, creating an empty file if `create` is set
+    int32_t (*lookup)(void* fs, void* dir, const char* name, uint32_t name_len, bool create, void** node);
+    /// Fetch node metadata
+    int32_t (*stat)(void* fs, void* node, wasme_vfs_stat_t* stat);
+    /// Read up to `len` bytes from a file at `offset`, returning the number read
+    int32_t (*read)(void* fs, void* node, uint64_t offset, uint8_t* data, uint32_t len);
+    /// Write to a file at `offset`, returning the number written. NULL for read-only filesystems
+    int32_t (*write)(void* fs, void* node, uint64_t offset, const uint8_t* data, uint32_t len);
+    /// Resize a file. NULL for read-only filesystems
+    int32_t (*truncate)(void* fs, void* node, uint64_t size);
+    /// Fetch the directory entry at `index`, returning -__WASI_ERRNO_NOENT past the end
+    int32_t (*readdir)(void* fs, void* dir, uint64_t index, wasme_vfs_dirent_t* entry);
+} wasme_vfs_ops_t;
+
+/// Mount a filesystem as a WASI preopen at `path` (for example "/data"),
+/// before the guest runs. Guest fds follow mount order from WASME_VFS_FD_BASE.
+int32_t WASME_vfs_mount(wasme_ctx_t* ctx, const char* path, const wasme_vfs_ops_t* ops, void* fs);
+
+/// RAM filesystem, files are created by the guest or loaded by the host
+typedef struct wasme_ramfs_s wasme_ramfs_t;
+
+/// Create an empty RAM filesystem, `capacity` limits the total file size in bytes
+wasme_ramfs_t* WASME_ramfs_init(uint32_t capacity);
+
+/// Create or replace a file, creating parent directories as required
+int32_t WASME_ramfs_add(wasme_ramfs_t* fs, const char* path, const uint8_t* data, uint32_t len);
+
+/// Mount a RAM filesystem in a context
+int32_t WASME_vfs_mount_ramfs(wasme_ctx_t* ctx, const char* path, wasme_ramfs_t* fs);
+
+/// Free a RAM filesystem, contexts it is mounted in must be de-initialised first
+void WASME_ramfs_deinit(wasme_ramfs_t** fs);
+
+/// Image filesystem magic ("WMFS") and version
+#define WASME_IMGFS_MAGIC 0x53464d57
+#define WASME_IMGFS_VERSION 1
+
+/// Image filesystem header, followed by the entry table. All fields are
+/// little-endian u32 and offsets are from the start of the image.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t reserved;
+} wasme_imgfs_hdr_t;
+
+/// Image filesystem entry. Entry 0 is the root directory, other entries
+/// name their parent directory by index. Names are single path components.
+typedef struct {
+    uint32_t parent;
+    uint32_t type;
+    uint32_t name_off;
+    uint32_t name_len;
+    uint32_t data_off;
+    uint32_t size;
+} wasme_imgfs_entry_t;
+
+/// Read-only filesystem served in place from an image packed at build time,
+/// file data is read directly from the (flash or mapped) image without copying it into RAM
+typedef struct {
+    const uint8_t* image;
+    uint32_t len;
+    uint32_t num_entries;
+} wasme_imgfs_t;
+
+/// Validate an image and setup a filesystem for it, the image must remain valid while mounted
+int32_t WASME_imgfs_init(wasme_imgfs_t* fs, const uint8_t* image, uint32_t len);
+
+/// Mount an image filesystem in a context
+int32_t WASME_vfs_mount_imgfs(wasme_ctx_t* ctx, const char* path, wasme_imgfs_t* fs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
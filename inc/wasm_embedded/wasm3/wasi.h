@@ -5,8 +5,8 @@
 //  Copyright © 2019 Volodymyr Shymanskyy. All rights reserved.
 //
 
-#ifndef m3_api_wasi_h
-#define m3_api_wasi_h
+#ifndef WASME_WASI_H
+#define WASME_WASI_H
 
 #include "m3_core.h"
 
@@ -15,19 +15,32 @@ extern "C"
 {
 #endif
 
+struct wasme_clock_s;
+struct wasme_vfs_s;
+
 typedef struct m3_wasi_context_t
 {
     i32                     exit_code;
     u32                     argc;
     ccstr_t *               argv;
+    // Host clock hook, clock_gettime (or clock() off posix hosts) is used when unset
+    const struct wasme_clock_s* clock;
+    void *                  clock_arg;
+    // Console sink for stdout and stderr, the host descriptors are written when unset
+    u32                  (* console_write)(void* arg, u32 fd, const u8* data, u32 len);
+    void *                  console_arg;
+    // Filesystems served as preopens, fds after stdio are host descriptors when unset
+    struct wasme_vfs_s *    vfs;
 } m3_wasi_context_t;
 
-M3Result    m3_LinkWASI             (IM3Module io_module);
+// Link WASI functions with the provided per-instance context
+M3Result    m3_LinkWASI             (IM3Module io_module, m3_wasi_context_t* context);
 
-m3_wasi_context_t* m3_GetWasiContext();
+// Read a WASI clock in nanoseconds via the context clock hook or the host, returns a WASI errno
+u32         m3_wasi_clock_time_get  (m3_wasi_context_t* context, u32 clock_id, u64* time);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif // m3_api_wasi_h
+#endif // WASME_WASI_H
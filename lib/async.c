@@ -0,0 +1,103 @@
+
+#include "wasm_embedded/wasm3/async.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+
+#ifdef WASME_USE_THREADS
+#include <pthread.h>
+
+// Shared by contexts blocking on a driver outside of a fiber
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+void WASME_async_enable(wasme_ctx_t* ctx, wasme_async_notify_f notify, void* arg) {
+    ctx->async_notify = notify;
+    ctx->async_notify_arg = arg;
+    ctx->async_enabled = true;
+}
+
+wasme_ctx_t* WASME_async_current(void) {
+    return wasme_exec_current();
+}
+
+void WASME_async_complete(wasme_ctx_t* ctx, int32_t result) {
+    ctx->async_result = result;
+
+    int prev = atomic_exchange(&ctx->async_state, WASME_ASYNC_COMPLETE);
+
+    // Completion before the task parked is picked up without notification
+    if (prev != WASME_ASYNC_WAITING) {
+        return;
+    }
+
+    if (ctx->async_blocking) {
+#ifdef WASME_USE_THREADS
+        pthread_mutex_lock(&async_lock);
+        pthread_cond_broadcast(&async_cond);
+        pthread_mutex_unlock(&async_lock);
+#endif
+    } else if (ctx->async_notify) {
+        ctx->async_notify(ctx, ctx->async_notify_arg);
+    }
+}
+
+bool wasme_async_park(wasme_ctx_t* ctx) {
+    int expected = WASME_ASYNC_IDLE;
+
+    return atomic_compare_exchange_strong(&ctx->async_state, &expected, WASME_ASYNC_WAITING);
+}
+
+bool wasme_async_ready(wasme_ctx_t* ctx) {
+    return atomic_load(&ctx->async_state) == WASME_ASYNC_COMPLETE;
+}
+
+int32_t wasme_async_block(wasme_ctx_t* ctx) {
+    ctx->async_blocking = true;
+
+    int expected = WASME_ASYNC_IDLE;
+    if (atomic_compare_exchange_strong(&ctx->async_state, &expected, WASME_ASYNC_WAITING)) {
+#ifdef WASME_USE_THREADS
+        pthread_mutex_lock(&async_lock);
+        while (atomic_load(&ctx->async_state) != WASME_ASYNC_COMPLETE) {
+            pthread_cond_wait(&async_cond, &async_lock);
+        }
+        pthread_mutex_unlock(&async_lock);
+#else
+        // Completed from interrupt context
+        while (atomic_load(&ctx->async_state) != WASME_ASYNC_COMPLETE) {}
+#endif
+    }
+
+    int32_t res = ctx->async_result;
+    atomic_store(&ctx->async_state, WASME_ASYNC_IDLE);
+
+    return res;
+}
+
+int32_t wasme_async_wait(wasme_ctx_t* ctx, int32_t res) {
+    if (res != WASME_DRV_PENDING) {
+        return res;
+    }
+
+    if (!ctx->async_enabled) {
+        printf("Driver returned pending without async enabled\r\n");
+        return -1;
+    }
+
+    if (wasme_fiber_active(ctx)) {
+        // Switch out until the driver completes and the task is resumed
+        ctx->async_blocking = false;
+        wasme_fiber_park(ctx);
+
+    } else {
+        // No fiber to park, block this thread instead
+        return wasme_async_block(ctx);
+    }
+
+    res = ctx->async_result;
+    atomic_store(&ctx->async_state, WASME_ASYNC_IDLE);
+
+    return res;
+}
@@ -0,0 +1,255 @@
+
+#include "wasm_embedded/wasm3/buf.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extra/wasi_core.h"
+
+struct wasme_dma_pool_s {
+    uint8_t* mem;
+    bool owns_mem;
+    uint32_t buf_size;
+    uint32_t count;
+    // Bit set for each free buffer
+    atomic_uint_fast64_t free;
+};
+
+wasme_dma_pool_t* WASME_dma_pool_init(void* mem, uint32_t mem_len, uint32_t buf_size, uint32_t count, uint32_t align) {
+    if (count == 0 || count > WASME_DMA_POOL_MAX || align == 0 || (align & (align - 1))) {
+        printf("Invalid DMA pool configuration\r\n");
+        return NULL;
+    }
+
+    wasme_dma_pool_t* pool = malloc(sizeof(wasme_dma_pool_t));
+    if (!pool) {
+        printf("Allocating wasme_dma_pool_t failed\r\n");
+        return NULL;
+    }
+    memset(pool, 0, sizeof(wasme_dma_pool_t));
+
+    // Round up so every buffer in the block stays aligned
+    pool->buf_size = (buf_size + align - 1) & ~(align - 1);
+    pool->count = count;
+
+    size_t total = (size_t)pool->buf_size * count;
+
+    if (mem) {
+        // Skip any unaligned head of the provided region
+        uintptr_t start = ((uintptr_t)mem + align - 1) & ~((uintptr_t)align - 1);
+        if (start + total > (uintptr_t)mem + mem_len) {
+            printf("DMA region too small for pool\r\n");
+            free(pool);
+            return NULL;
+        }
+        pool->mem = (uint8_t*)start;
+
+    } else {
+        pool->mem = aligned_alloc(align, total);
+        if (!pool->mem) {
+            printf("Allocating DMA buffers failed\r\n");
+            free(pool);
+            return NULL;
+        }
+        pool->owns_mem = true;
+    }
+
+    atomic_init(&pool->free, count == 64 ? UINT64_MAX : ((uint64_t)1 << count) - 1);
+
+    return pool;
+}
+
+uint32_t WASME_dma_buf_size(const wasme_dma_pool_t* pool) {
+    return pool->buf_size;
+}
+
+uint8_t* WASME_dma_borrow(wasme_dma_pool_t* pool) {
+    uint64_t free = atomic_load(&pool->free);
+
+    while (free) {
+        uint32_t index = __builtin_ctzll(free);
+
+        if (atomic_compare_exchange_weak(&pool->free, &free, free & ~((uint64_t)1 << index))) {
+            return pool->mem + (size_t)index * pool->buf_size;
+        }
+    }
+
+    return NULL;
+}
+
+void WASME_dma_return(wasme_dma_pool_t* pool, uint8_t* buf) {
+    if (buf < pool->mem) {
+        return;
+    }
+
+    size_t index = (size_t)(buf - pool->mem) / pool->buf_size;
+    if (index >= pool->count) {
+        return;
+    }
+
+    atomic_fetch_or(&pool->free, (uint64_t)1 << index);
+}
+
+void WASME_dma_pool_deinit(wasme_dma_pool_t** pool) {
+    if (!*pool) {
+        return;
+    }
+
+    if ((*pool)->owns_mem) {
+        free((*pool)->mem);
+    }
+
+    free(*pool);
+
+    *pool = NULL;
+}
+
+uint32_t WASME_iov_len(const wasme_iovec_t* iov, uint32_t iov_len) {
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < iov_len; i++) {
+        total += iov[i].len;
+    }
+
+    return total;
+}
+
+uint32_t WASME_iov_gather(const wasme_iovec_t* iov, uint32_t iov_len, uint32_t offset, uint8_t* dst, uint32_t len) {
+    uint32_t copied = 0;
+
+    for (uint32_t i = 0; i < iov_len && copied < len; i++) {
+        if (offset >= iov[i].len) {
+            offset -= iov[i].len;
+            continue;
+        }
+
+        uint32_t n = iov[i].len - offset;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+
+        memcpy(dst + copied, iov[i].data + offset, n);
+        copied += n;
+        offset = 0;
+    }
+
+    return copied;
+}
+
+uint32_t WASME_iov_scatter(const wasme_iovec_t* iov, uint32_t iov_len, uint32_t offset, const uint8_t* src, uint32_t len) {
+    uint32_t copied = 0;
+
+    for (uint32_t i = 0; i < iov_len && copied < len; i++) {
+        if (offset >= iov[i].len) {
+            offset -= iov[i].len;
+            continue;
+        }
+
+        uint32_t n = iov[i].len - offset;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+
+        memcpy(iov[i].data + offset, src + copied, n);
+        copied += n;
+        offset = 0;
+    }
+
+    return copied;
+}
+
+int32_t wasme_iov_resolve(IM3Runtime rt, uint32_t iovs_ptr, uint32_t iovs_len, wasme_iovec_t* iov) {
+    if (iovs_len > WASME_MAX_IOVS) {
+        return __WASI_ERRNO_2BIG;
+    }
+
+    const uint32_t* guest = (const uint32_t*)wasme_mem_range(rt, iovs_ptr, iovs_len * 2 * sizeof(uint32_t));
+    if (!guest) {
+        return __WASI_ERRNO_FAULT;
+    }
+
+    for (uint32_t i = 0; i < iovs_len; i++) {
+        iov[i].len = guest[i * 2 + 1];
+        iov[i].data = wasme_mem_range(rt, guest[i * 2], iov[i].len);
+
+        if (!iov[i].data) {
+            return __WASI_ERRNO_FAULT;
+        }
+    }
+
+    return 0;
+}
+
+int32_t wasme_iov_fallback(wasme_ctx_t* ctx, bool write, const wasme_iovec_t* iov, uint32_t iov_len,
+        wasme_iov_op_f op, const void* arg) {
+    int32_t res = 0;
+
+    // Single segments go straight to the driver without copying
+    if (iov_len == 1) {
+        return wasme_async_wait(ctx, op(ctx, arg, iov[0].data, iov[0].len));
+    }
+
+    // Coalesce segments through a bounce buffer so they go out as one transfer
+    uint32_t total = WASME_iov_len(iov, iov_len);
+    if (ctx->dma_pool && total <= WASME_dma_buf_size(ctx->dma_pool)) {
+        uint8_t* buf = WASME_dma_borrow(ctx->dma_pool);
+        if (buf) {
+            if (write) {
+                WASME_iov_gather(iov, iov_len, 0, buf, total);
+            }
+
+            res = wasme_async_wait(ctx, op(ctx, arg, buf, total));
+
+            if (!write && res >= 0) {
+                WASME_iov_scatter(iov, iov_len, 0, buf, total);
+            }
+
+            WASME_dma_return(ctx->dma_pool, buf);
+
+            return res;
+        }
+    }
+
+    // Otherwise issue one driver operation per segment
+    for (uint32_t i = 0; i < iov_len && res >= 0; i++) {
+        res = wasme_async_wait(ctx, op(ctx, arg, iov[i].data, iov[i].len));
+    }
+
+    return res;
+}
+
+int32_t WASME_bind_dma_pool(wasme_ctx_t* ctx, wasme_dma_pool_t* pool) {
+    ctx->dma_pool = pool;
+
+    return 0;
+}
+
+uint32_t wasme_ring_push(_Atomic uint32_t* hdr, uint8_t* ring, uint32_t size, const uint8_t* data, uint32_t len,
+        bool whole) {
+    uint32_t head = atomic_load_explicit(&hdr[0], memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&hdr[1], memory_order_acquire);
+
+    // The tail is written by the guest so may be anything, a ring claiming to
+    // hold more than its size is corrupt and receives nothing until reopened
+    uint32_t used = head - tail;
+    uint32_t space = used <= size ? size - used : 0;
+    uint32_t n = len < space ? len : space;
+    if (whole && n < len) {
+        return 0;
+    }
+
+    // Copy in up to two chunks around the end of the ring
+    uint32_t start = head & (size - 1);
+    uint32_t first = size - start;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(ring + start, data, first);
+    memcpy(ring, data + first, n - first);
+
+    atomic_store_explicit(&hdr[0], head + n, memory_order_release);
+
+    return n;
+}
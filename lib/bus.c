@@ -0,0 +1,454 @@
+
+#include "wasm_embedded/wasm3/bus.h"
+#include "wasm_embedded/wasm3/async.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WASME_USE_THREADS
+#include <pthread.h>
+#endif
+
+// Number of init parameters identifying a device configuration
+#define BUS_CFG_LEN 6
+
+typedef enum {
+    WASME_BUS_SPI = 0,
+    WASME_BUS_I2C = 1,
+} wasme_bus_kind_t;
+
+// Device configuration shared by all handles opened with identical parameters
+typedef struct {
+    uint32_t refs;
+    int32_t cfg[BUS_CFG_LEN];
+} wasme_bus_dev_t;
+
+struct wasme_bus_s {
+    wasme_bus_kind_t kind;
+    const spi_drv_t* spi;
+    const i2c_drv_t* i2c;
+    void* drv_ctx;
+
+    wasme_bus_dev_t devices[WASME_BUS_MAX_DEVICES];
+    // Device the controller is programmed for and its driver handle, -1 if none
+    int32_t current;
+    int32_t hw_handle;
+    uint32_t reconfigs;
+
+#ifdef WASME_USE_THREADS
+    pthread_mutex_t lock;
+    // Signalled when the bus is released
+    pthread_cond_t cond;
+    // Set while a transfer owns the bus, devices and controller state
+    bool busy;
+    // Number of waiters at each priority level
+    uint32_t waiting[WASME_BUS_PRIORITIES];
+#endif
+};
+
+static wasme_bus_t* bus_init(wasme_bus_kind_t kind, void* drv_ctx) {
+    wasme_bus_t* bus = calloc(1, sizeof(wasme_bus_t));
+    if (!bus) {
+        printf("Allocating wasme_bus_t failed\r\n");
+        return NULL;
+    }
+
+    bus->kind = kind;
+    bus->drv_ctx = drv_ctx;
+    bus->current = -1;
+    bus->hw_handle = -1;
+
+#ifdef WASME_USE_THREADS
+    pthread_mutex_init(&bus->lock, NULL);
+    pthread_cond_init(&bus->cond, NULL);
+#endif
+
+    return bus;
+}
+
+wasme_bus_t* WASME_bus_init_spi(const spi_drv_t* drv, void* drv_ctx) {
+    wasme_bus_t* bus = bus_init(WASME_BUS_SPI, drv_ctx);
+    if (bus) {
+        bus->spi = drv;
+    }
+    return bus;
+}
+
+wasme_bus_t* WASME_bus_init_i2c(const i2c_drv_t* drv, void* drv_ctx) {
+    wasme_bus_t* bus = bus_init(WASME_BUS_I2C, drv_ctx);
+    if (bus) {
+        bus->i2c = drv;
+    }
+    return bus;
+}
+
+#ifdef WASME_USE_THREADS
+static bool bus_higher_waiting(wasme_bus_t* bus, uint32_t priority) {
+    for (uint32_t p = priority + 1; p < WASME_BUS_PRIORITIES; p++) {
+        if (bus->waiting[p]) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+// Wait for exclusive use of the bus, granted to the highest priority waiter first
+static void bus_acquire(wasme_bus_t* bus, uint32_t priority) {
+#ifdef WASME_USE_THREADS
+    pthread_mutex_lock(&bus->lock);
+
+    bus->waiting[priority] += 1;
+    while (bus->busy || bus_higher_waiting(bus, priority)) {
+        pthread_cond_wait(&bus->cond, &bus->lock);
+    }
+    bus->waiting[priority] -= 1;
+    bus->busy = true;
+
+    pthread_mutex_unlock(&bus->lock);
+#endif
+}
+
+static void bus_release(wasme_bus_t* bus) {
+#ifdef WASME_USE_THREADS
+    pthread_mutex_lock(&bus->lock);
+
+    bus->busy = false;
+
+    // Waiters re-check priorities so all are woken
+    pthread_cond_broadcast(&bus->cond);
+
+    pthread_mutex_unlock(&bus->lock);
+#endif
+}
+
+// Release the controller from the current device, with the bus held
+static void bus_unselect(wasme_bus_t* bus) {
+    if (bus->current < 0) {
+        return;
+    }
+
+    if (bus->kind == WASME_BUS_SPI) {
+        bus->spi->deinit(bus->drv_ctx, bus->hw_handle);
+    } else {
+        bus->i2c->deinit(bus->drv_ctx, bus->hw_handle);
+    }
+
+    bus->current = -1;
+    bus->hw_handle = -1;
+}
+
+// Program the controller for a device if it is not already, with the bus held
+static int32_t bus_select(wasme_bus_t* bus, int32_t dev) {
+    if (dev < 0 || dev >= WASME_BUS_MAX_DEVICES || !bus->devices[dev].refs) {
+        return -1;
+    }
+
+    if (bus->current == dev) {
+        return bus->hw_handle;
+    }
+
+    bus_unselect(bus);
+
+    const int32_t* cfg = bus->devices[dev].cfg;
+    int32_t res;
+    if (bus->kind == WASME_BUS_SPI) {
+        res = bus->spi->init(bus->drv_ctx, cfg[0], cfg[1], cfg[2], cfg[3], cfg[4], cfg[5]);
+    } else {
+        res = bus->i2c->init(bus->drv_ctx, cfg[0], cfg[1], cfg[2], cfg[3]);
+    }
+    if (res < 0) {
+        return res;
+    }
+
+    bus->current = dev;
+    bus->hw_handle = res;
+    bus->reconfigs += 1;
+
+    return res;
+}
+
+// Open a handle to the device with the given configuration, with the bus held
+static int32_t bus_open(wasme_bus_t* bus, const int32_t* cfg) {
+    int32_t free_dev = -1;
+
+    for (int32_t i = 0; i < WASME_BUS_MAX_DEVICES; i++) {
+        wasme_bus_dev_t* d = &bus->devices[i];
+        if (d->refs && memcmp(d->cfg, cfg, sizeof(d->cfg)) == 0) {
+            d->refs += 1;
+            return i;
+        }
+        if (!d->refs && free_dev < 0) {
+            free_dev = i;
+        }
+    }
+
+    if (free_dev < 0) {
+        return -1;
+    }
+
+    bus->devices[free_dev].refs = 1;
+    memcpy(bus->devices[free_dev].cfg, cfg, sizeof(bus->devices[free_dev].cfg));
+
+    // New configurations are programmed immediately so errors are reported at init
+    int32_t res = bus_select(bus, free_dev);
+    if (res < 0) {
+        bus->devices[free_dev].refs = 0;
+        return res;
+    }
+
+    return free_dev;
+}
+
+// Close a device handle, with the bus held
+static int32_t bus_close(wasme_bus_t* bus, int32_t dev) {
+    if (dev < 0 || dev >= WASME_BUS_MAX_DEVICES || !bus->devices[dev].refs) {
+        return -1;
+    }
+
+    bus->devices[dev].refs -= 1;
+    if (!bus->devices[dev].refs && bus->current == dev) {
+        bus_unselect(bus);
+    }
+
+    return 0;
+}
+
+// Resolve a driver result with the bus held. Bus state cannot be released while
+// an operation is in flight, so a pending operation is waited out and rejected
+static int32_t bus_complete(int32_t res) {
+    if (res != WASME_DRV_PENDING) {
+        return res;
+    }
+
+    wasme_ctx_t* ctx = wasme_exec_current();
+    if (!ctx) {
+        printf("Driver behind a bus returned pending outside execution\r\n");
+        return -1;
+    }
+
+    wasme_async_block(ctx);
+    wasme_console_printf(ctx, "Driver behind a bus returned pending, bus drivers must complete synchronously\r\n");
+
+    return -1;
+}
+
+// SPI driver adaptor, the driver context is the binding context's bus client
+
+static int32_t bus_spi_init(const void* drv_ctx, uint32_t dev, uint32_t baud, int32_t mosi, int32_t miso, int32_t sck, int32_t cs) {
+    const wasme_bus_client_t* client = drv_ctx;
+    const int32_t cfg[BUS_CFG_LEN] = { dev, baud, mosi, miso, sck, cs };
+
+    bus_acquire(client->bus, client->priority);
+    int32_t res = bus_open(client->bus, cfg);
+    bus_release(client->bus);
+
+    return res;
+}
+
+static int32_t bus_spi_deinit(const void* drv_ctx, int32_t handle) {
+    const wasme_bus_client_t* client = drv_ctx;
+
+    bus_acquire(client->bus, client->priority);
+    int32_t res = bus_close(client->bus, handle);
+    bus_release(client->bus);
+
+    return res;
+}
+
+static int32_t bus_spi_read(const void* drv_ctx, int32_t handle, uint8_t* data, uint32_t len) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->spi->read(bus->drv_ctx, res, data, len));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static int32_t bus_spi_write(const void* drv_ctx, int32_t handle, uint8_t* data, uint32_t len) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->spi->write(bus->drv_ctx, res, data, len));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static int32_t bus_spi_transfer(const void* drv_ctx, int32_t handle, uint8_t* read, uint8_t* write, uint32_t len) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->spi->transfer(bus->drv_ctx, res, read, write, len));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static int32_t bus_spi_transfer_inplace(const void* drv_ctx, int32_t handle, uint8_t* data, uint32_t len) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->spi->transfer_inplace(bus->drv_ctx, res, data, len));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static const spi_drv_t bus_spi_drv = {
+    .init = bus_spi_init,
+    .deinit = bus_spi_deinit,
+    .read = bus_spi_read,
+    .write = bus_spi_write,
+    .transfer = bus_spi_transfer,
+    .transfer_inplace = bus_spi_transfer_inplace,
+};
+
+// I2C driver adaptor, the driver context is the binding context's bus client
+
+static int32_t bus_i2c_init(const void* drv_ctx, uint32_t dev, uint32_t baud, int32_t sda, int32_t scl) {
+    const wasme_bus_client_t* client = drv_ctx;
+    const int32_t cfg[BUS_CFG_LEN] = { dev, baud, sda, scl, 0, 0 };
+
+    bus_acquire(client->bus, client->priority);
+    int32_t res = bus_open(client->bus, cfg);
+    bus_release(client->bus);
+
+    return res;
+}
+
+static int32_t bus_i2c_deinit(const void* drv_ctx, int32_t handle) {
+    const wasme_bus_client_t* client = drv_ctx;
+
+    bus_acquire(client->bus, client->priority);
+    int32_t res = bus_close(client->bus, handle);
+    bus_release(client->bus);
+
+    return res;
+}
+
+static int32_t bus_i2c_write(const void* drv_ctx, int32_t handle, uint16_t addr, uint8_t* data, uint32_t len) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->i2c->write(bus->drv_ctx, res, addr, data, len));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static int32_t bus_i2c_read(const void* drv_ctx, int32_t handle, uint16_t addr, uint8_t* data, uint32_t len) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->i2c->read(bus->drv_ctx, res, addr, data, len));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static int32_t bus_i2c_write_read(const void* drv_ctx, int32_t handle, uint16_t addr,
+        uint8_t* data_out, uint32_t len_out, uint8_t* data_in, uint32_t len_in) {
+    const wasme_bus_client_t* client = drv_ctx;
+    wasme_bus_t* bus = client->bus;
+
+    bus_acquire(bus, client->priority);
+    int32_t res = bus_select(bus, handle);
+    if (res >= 0) {
+        res = bus_complete(bus->i2c->write_read(bus->drv_ctx, res, addr, data_out, len_out, data_in, len_in));
+    }
+    bus_release(bus);
+
+    return res;
+}
+
+static const i2c_drv_t bus_i2c_drv = {
+    .init = bus_i2c_init,
+    .deinit = bus_i2c_deinit,
+    .write = bus_i2c_write,
+    .read = bus_i2c_read,
+    .write_read = bus_i2c_write_read,
+};
+
+int32_t WASME_bind_spi_bus(wasme_ctx_t* ctx, wasme_bus_t* bus, uint32_t priority) {
+    if (bus->kind != WASME_BUS_SPI || priority >= WASME_BUS_PRIORITIES) {
+        return -1;
+    }
+
+    int32_t res = WASME_bind_spi(ctx, &bus_spi_drv, &ctx->spi_bus_client);
+
+    // Extension drivers would bypass arbitration, operations use the base driver fallbacks
+    ctx->spi_bus_client.bus = bus;
+    ctx->spi_bus_client.priority = priority;
+    ctx->spi_exec_drv = NULL;
+    ctx->spi_vec_drv = NULL;
+
+    return res;
+}
+
+int32_t WASME_bind_i2c_bus(wasme_ctx_t* ctx, wasme_bus_t* bus, uint32_t priority) {
+    if (bus->kind != WASME_BUS_I2C || priority >= WASME_BUS_PRIORITIES) {
+        return -1;
+    }
+
+    int32_t res = WASME_bind_i2c(ctx, &bus_i2c_drv, &ctx->i2c_bus_client);
+
+    // Transactions use the base driver fallback so each operation is arbitrated
+    ctx->i2c_bus_client.bus = bus;
+    ctx->i2c_bus_client.priority = priority;
+    ctx->i2c_txn_drv = NULL;
+
+    return res;
+}
+
+uint32_t WASME_bus_reconfigs(wasme_bus_t* bus) {
+    bus_acquire(bus, WASME_BUS_PRIORITIES - 1);
+    uint32_t reconfigs = bus->reconfigs;
+    bus_release(bus);
+
+    return reconfigs;
+}
+
+void WASME_bus_deinit(wasme_bus_t** bus) {
+    if (!*bus) {
+        return;
+    }
+
+    bus_unselect(*bus);
+
+#ifdef WASME_USE_THREADS
+    pthread_cond_destroy(&(*bus)->cond);
+    pthread_mutex_destroy(&(*bus)->lock);
+#endif
+
+    free(*bus);
+
+    *bus = NULL;
+}
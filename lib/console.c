@@ -0,0 +1,449 @@
+
+#include "wasm3.h"
+#include "m3_env.h"
+#include "extra/wasi_core.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wasm_embedded/wasm3/console.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#include <unistd.h>
+#define WASME_CONSOLE_FD
+#endif
+
+// Flush thread waits on a condition variable using the monotonic clock
+#if defined(WASME_USE_THREADS) && defined(__linux__)
+#define WASME_CONSOLE_THREAD
+#include <pthread.h>
+#endif
+
+// Buffered output is a sequence of records, a u32 header (fd << 24 | len) then data
+#define RECORD_HDR 4
+#define RECORD_LEN_MAX 0xFFFFFF
+
+// Smallest usable buffer
+#define CONSOLE_BUF_MIN 64
+
+struct wasme_console_host_s {
+    const wasme_console_t* backend;
+    void* arg;
+    wasme_console_cfg_t cfg;
+    uint8_t* buf;
+    // Free running offsets of the buffered records
+    uint32_t head;
+    uint32_t tail;
+    // Last record, extended by further writes to the same fd until flushed
+    uint32_t open;
+    uint32_t open_fd;
+    bool has_open;
+    // Time the oldest buffered output was written
+    int64_t first_ns;
+    // Set while a flush writes records to the backend outside the lock
+    bool flushing;
+#ifdef WASME_CONSOLE_THREAD
+    pthread_t thread;
+    pthread_mutex_t lock;
+    // Signalled on flush requests and shutdown
+    pthread_cond_t cond;
+    // Signalled when a flush completes
+    pthread_cond_t done;
+    bool running;
+    bool flush_req;
+#endif
+};
+
+static void console_lock(wasme_console_host_t* c) {
+#ifdef WASME_CONSOLE_THREAD
+    pthread_mutex_lock(&c->lock);
+#else
+    (void)c;
+#endif
+}
+
+static void console_unlock(wasme_console_host_t* c) {
+#ifdef WASME_CONSOLE_THREAD
+    pthread_mutex_unlock(&c->lock);
+#else
+    (void)c;
+#endif
+}
+
+// Copy into the buffer at a free running offset, wrapping at the end
+static void console_put(wasme_console_host_t* c, uint32_t offset, const void* data, uint32_t len) {
+    uint32_t size = c->cfg.buf_size;
+    uint32_t start = offset & (size - 1);
+    uint32_t first = size - start < len ? size - start : len;
+
+    memcpy(c->buf + start, data, first);
+    memcpy(c->buf, (const uint8_t*)data + first, len - first);
+}
+
+static void console_get(wasme_console_host_t* c, uint32_t offset, void* data, uint32_t len) {
+    uint32_t size = c->cfg.buf_size;
+    uint32_t start = offset & (size - 1);
+    uint32_t first = size - start < len ? size - start : len;
+
+    memcpy(data, c->buf + start, first);
+    memcpy((uint8_t*)data + first, c->buf, len - first);
+}
+
+// Write to the backend, remaining output is discarded if the backend fails
+static void console_emit(wasme_console_host_t* c, uint32_t fd, const uint8_t* data, uint32_t len) {
+    while (len) {
+        int32_t res;
+
+        if (c->backend) {
+            res = c->backend->write(c->arg, fd, data, len);
+        } else {
+#ifdef WASME_CONSOLE_FD
+            res = (int32_t)write((int)fd, data, len);
+#else
+            res = (int32_t)fwrite(data, 1, len, fd == 2 ? stderr : stdout);
+#endif
+        }
+
+        if (res <= 0) {
+            return;
+        }
+        data += res;
+        len -= (uint32_t)res;
+    }
+}
+
+// Write buffered records to the backend, writes continue into free space meanwhile
+static void console_drain(wasme_ctx_t* ctx, wasme_console_host_t* c) {
+    console_lock(c);
+
+#ifdef WASME_CONSOLE_THREAD
+    while (c->flushing) {
+        pthread_cond_wait(&c->done, &c->lock);
+    }
+#else
+    // Backends writing diagnostics re-enter here, that output is flushed next time
+    if (c->flushing) {
+        return;
+    }
+#endif
+
+    uint32_t pos = c->tail;
+    uint32_t end = c->head;
+    c->has_open = false;
+    c->flushing = true;
+
+    console_unlock(c);
+
+    while (pos != end) {
+        uint32_t hdr;
+        console_get(c, pos, &hdr, RECORD_HDR);
+        pos += RECORD_HDR;
+
+        uint32_t fd = hdr >> 24;
+        uint32_t len = hdr & RECORD_LEN_MAX;
+
+        uint32_t start = pos & (c->cfg.buf_size - 1);
+        uint32_t first = c->cfg.buf_size - start < len ? c->cfg.buf_size - start : len;
+        console_emit(c, fd, c->buf + start, first);
+        if (len > first) {
+            console_emit(c, fd, c->buf, len - first);
+        }
+        pos += len;
+    }
+
+    console_lock(c);
+
+    c->tail = end;
+    c->flushing = false;
+    c->first_ns = c->head != c->tail ? wasme_clock_monotonic(ctx) : 0;
+
+#ifdef WASME_CONSOLE_THREAD
+    pthread_cond_broadcast(&c->done);
+#endif
+
+    console_unlock(c);
+}
+
+// Request a flush, waiting for it to complete when the buffer is full
+static void console_kick(wasme_ctx_t* ctx, wasme_console_host_t* c, bool full) {
+#ifdef WASME_CONSOLE_THREAD
+    (void)ctx;
+    pthread_mutex_lock(&c->lock);
+
+    c->flush_req = true;
+    pthread_cond_signal(&c->cond);
+
+    if (full) {
+        while (c->flush_req || c->flushing) {
+            pthread_cond_wait(&c->done, &c->lock);
+        }
+    }
+
+    pthread_mutex_unlock(&c->lock);
+#else
+    (void)full;
+    console_drain(ctx, c);
+#endif
+}
+
+// Check whether buffered output has waited for longer than the policy allows
+static bool console_due(wasme_console_host_t* c, int64_t now) {
+    return c->cfg.flush_us && c->head != c->tail
+        && now - c->first_ns >= (int64_t)c->cfg.flush_us * 1000;
+}
+
+// Buffer output, returning the number of bytes accepted
+static uint32_t console_write(wasme_ctx_t* ctx, uint32_t fd, const uint8_t* data, uint32_t len) {
+    wasme_console_host_t* c = ctx->console;
+    uint32_t done = 0;
+
+    while (done < len) {
+        int64_t now = wasme_clock_monotonic(ctx);
+        bool flush = false;
+
+        console_lock(c);
+
+        uint32_t used = c->head - c->tail;
+        uint32_t space = c->cfg.buf_size - used;
+
+        // Consecutive writes to one fd (printf emits several iovecs per line) share a record
+        bool extend = c->has_open && c->open_fd == fd;
+        uint32_t need = extend ? 0 : RECORD_HDR;
+
+        if (space > need) {
+            uint32_t n = len - done < space - need ? len - done : space - need;
+
+            if (!extend) {
+                uint32_t hdr = fd << 24;
+                console_put(c, c->head, &hdr, RECORD_HDR);
+                c->open = c->head;
+                c->open_fd = fd;
+                c->has_open = true;
+                c->head += RECORD_HDR;
+            }
+
+            console_put(c, c->head, data + done, n);
+            c->head += n;
+
+            uint32_t hdr;
+            console_get(c, c->open, &hdr, RECORD_HDR);
+            hdr += n;
+            console_put(c, c->open, &hdr, RECORD_HDR);
+
+            if (!used) {
+                c->first_ns = now;
+            }
+
+            flush = ((c->cfg.flags & WASME_CONSOLE_FLUSH_NEWLINE) && memchr(data + done, '\n', n))
+                || c->head - c->tail >= c->cfg.flush_size
+                || console_due(c, now);
+
+            done += n;
+        }
+
+        console_unlock(c);
+
+        // Output that does not fit waits for the backend to catch up
+        if (flush || done < len) {
+            console_kick(ctx, c, done < len);
+        }
+
+#ifndef WASME_CONSOLE_THREAD
+        // Backend output re-entering with the buffer full is dropped
+        if (c->flushing && done < len) {
+            break;
+        }
+#endif
+    }
+
+    return done;
+}
+
+// WASI fd_write hook for stdout and stderr
+static u32 console_wasi_write(void* arg, u32 fd, const u8* data, u32 len) {
+    return console_write((wasme_ctx_t*)arg, fd, data, len);
+}
+
+#ifdef WASME_CONSOLE_THREAD
+static void* console_thread(void* arg) {
+    wasme_ctx_t* ctx = (wasme_ctx_t*)arg;
+    wasme_console_host_t* c = ctx->console;
+
+    pthread_mutex_lock(&c->lock);
+
+    while (c->running) {
+        if (c->flush_req || console_due(c, wasme_clock_monotonic(ctx))) {
+            c->flush_req = false;
+
+            pthread_mutex_unlock(&c->lock);
+            console_drain(ctx, c);
+            pthread_mutex_lock(&c->lock);
+
+            continue;
+        }
+
+        if (!c->cfg.flush_us || c->head == c->tail) {
+            pthread_cond_wait(&c->cond, &c->lock);
+        } else {
+            // Deadlines are CLOCK_MONOTONIC, as should be any clock hook set on linux
+            int64_t due = c->first_ns + (int64_t)c->cfg.flush_us * 1000;
+            struct timespec ts = {
+                .tv_sec = due / 1000000000,
+                .tv_nsec = due % 1000000000,
+            };
+            pthread_cond_timedwait(&c->cond, &c->lock, &ts);
+        }
+    }
+
+    pthread_mutex_unlock(&c->lock);
+
+    return NULL;
+}
+#endif
+
+int32_t WASME_set_console(wasme_ctx_t* ctx, const wasme_console_t* console, void* arg, const wasme_console_cfg_t* cfg) {
+    wasme_console_cfg_t policy = {
+        .flags = WASME_CONSOLE_FLUSH_NEWLINE,
+    };
+    if (cfg) {
+        policy = *cfg;
+    }
+
+    if (!policy.buf_size) {
+        policy.buf_size = WASME_CONSOLE_BUF_SIZE;
+    }
+    if (policy.buf_size < CONSOLE_BUF_MIN || policy.buf_size > RECORD_LEN_MAX
+            || (policy.buf_size & (policy.buf_size - 1))) {
+        return -1;
+    }
+    if (!policy.flush_size || policy.flush_size > policy.buf_size) {
+        policy.flush_size = policy.buf_size / 2;
+    }
+    if (console && !console->write) {
+        return -1;
+    }
+
+    // Output buffered for a previous backend is flushed to it first
+    wasme_console_deinit(ctx);
+
+    wasme_console_host_t* c = calloc(1, sizeof(wasme_console_host_t));
+    if (!c) {
+        return -1;
+    }
+
+    c->buf = malloc(policy.buf_size);
+    if (!c->buf) {
+        free(c);
+        return -1;
+    }
+
+    c->backend = console;
+    c->arg = arg;
+    c->cfg = policy;
+
+    ctx->console = c;
+
+#ifdef WASME_CONSOLE_THREAD
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&c->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&c->done, NULL);
+    pthread_mutex_init(&c->lock, NULL);
+    c->running = true;
+
+    if (pthread_create(&c->thread, NULL, console_thread, ctx) != 0) {
+        ctx->console = NULL;
+        pthread_cond_destroy(&c->cond);
+        pthread_cond_destroy(&c->done);
+        pthread_mutex_destroy(&c->lock);
+        free(c->buf);
+        free(c);
+        return -1;
+    }
+#endif
+
+    ctx->wasi.console_write = console_wasi_write;
+    ctx->wasi.console_arg = ctx;
+
+    return 0;
+}
+
+void WASME_console_flush(wasme_ctx_t* ctx) {
+    if (ctx->console) {
+        console_drain(ctx, ctx->console);
+    }
+}
+
+void WASME_console_tick(wasme_ctx_t* ctx, int64_t now_ns) {
+    wasme_console_host_t* c = ctx->console;
+    if (!c) {
+        return;
+    }
+
+    console_lock(c);
+    bool due = console_due(c, now_ns);
+    console_unlock(c);
+
+    if (due) {
+        console_drain(ctx, c);
+    }
+}
+
+void wasme_console_printf(wasme_ctx_t* ctx, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    if (!ctx->console) {
+        vprintf(fmt, args);
+        va_end(args);
+        return;
+    }
+
+    // Longer diagnostics are truncated
+    char line[256];
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (n > 0) {
+        uint32_t len = (uint32_t)n < sizeof(line) ? (uint32_t)n : sizeof(line) - 1;
+        console_write(ctx, 1, (const uint8_t*)line, len);
+    }
+}
+
+void wasme_console_deinit(wasme_ctx_t* ctx) {
+    wasme_console_host_t* c = ctx->console;
+    if (!c) {
+        return;
+    }
+
+    ctx->wasi.console_write = NULL;
+    ctx->wasi.console_arg = NULL;
+
+#ifdef WASME_CONSOLE_THREAD
+    pthread_mutex_lock(&c->lock);
+    c->running = false;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+
+    pthread_join(c->thread, NULL);
+#endif
+
+    console_drain(ctx, c);
+
+#ifdef WASME_CONSOLE_THREAD
+    pthread_cond_destroy(&c->cond);
+    pthread_cond_destroy(&c->done);
+    pthread_mutex_destroy(&c->lock);
+#endif
+
+    free(c->buf);
+    free(c);
+
+    ctx->console = NULL;
+}
@@ -3,72 +3,272 @@
 #include "wasm_embedded/wasm3/internal.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include "wasm3.h"
-#include "m3_api_wasi.h"
+#include "m3_env.h"
+#include "extra/wasi_core.h"
+#include "wasm_embedded/wasm3/wasi.h"
+
+#ifdef WASME_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-wasme_ctx_t* WASME_init(const wasme_task_t* task, uint32_t mem_limit) {
+// Parse the module binary into a new environment for one instance
+static wasme_parsed_t* module_parse(const wasme_module_t* module) {
+    M3Result m3_res;
+
+    wasme_parsed_t* parsed = malloc(sizeof(wasme_parsed_t));
+    if(!parsed) {
+        printf("Allocating wasme_parsed_t failed\r\n");
+        return NULL;
+    }
+
+    parsed->mod = NULL;
+    parsed->env = m3_NewEnvironment ();
+    if (!parsed->env) {
+        printf("NewEnvironment failed\r\n");
+
+        goto teardown_parsed;
+    }
+
+    m3_res = m3_ParseModule (parsed->env, &parsed->mod, module->data, module->data_len);
+    if (m3_res) {
+        printf("ParseModule failed: %s\r\n", m3_res);
+
+        // Only unloaded modules should be manually freed
+        m3_FreeModule(parsed->mod);
+
+        goto teardown_env;
+    }
+
+    return parsed;
+
+teardown_env:
+    m3_FreeEnvironment(parsed->env);
+
+teardown_parsed:
+    free(parsed);
+
+    return NULL;
+}
+
+// Free a parsed module that was never loaded into a runtime
+static void module_parsed_free(wasme_parsed_t* parsed) {
+    if (!parsed) {
+        return;
+    }
+
+    m3_FreeModule(parsed->mod);
+    m3_FreeEnvironment(parsed->env);
+    free(parsed);
+}
+
+int WASME_module_prepare(wasme_module_t* module) {
+    if (atomic_load(&module->spare)) {
+        return 0;
+    }
+
+    wasme_parsed_t* parsed = module_parse(module);
+    if (!parsed) {
+        return -1;
+    }
+
+    // Another thread may have prepared one meanwhile
+    wasme_parsed_t* expected = NULL;
+    if (!atomic_compare_exchange_strong(&module->spare, &expected, parsed)) {
+        module_parsed_free(parsed);
+    }
+
+    return 0;
+}
+
+wasme_module_t* WASME_module_load(const wasme_task_t* task) {
+    wasme_module_t* module = malloc(sizeof(wasme_module_t));
+    if(!module) {
+        printf("Allocating wasme_module_t failed\r\n");
+        return NULL;
+    }
+    memset(module, 0, sizeof(wasme_module_t));
+
+    module->data = task->data;
+    module->data_len = task->data_len;
+
+    printf( "Loading WebAssembly (p: %p, %d bytes)...\r\n", (void*)task->data, task->data_len);
+
+    // Parse module once to validate the task, the result is kept for the first instance
+    wasme_parsed_t* parsed = module_parse(module);
+    if (!parsed) {
+        free(module);
+        return NULL;
+    }
+    atomic_store(&module->spare, parsed);
+
+    return module;
+}
+
+wasme_module_t* WASME_module_load_file(const char* path) {
+#ifdef WASME_USE_MMAP
+    struct stat st;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("Opening module %s failed\r\n", path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || st.st_size > UINT32_MAX) {
+        printf("Invalid module file %s\r\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // Mapping remains valid after the descriptor is closed
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Mapping module %s failed\r\n", path);
+        return NULL;
+    }
+
+    // Parsing walks the binary front to back
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    wasme_task_t task = {
+        .data = map,
+        .data_len = st.st_size,
+    };
+
+    wasme_module_t* module = WASME_module_load(&task);
+    if (!module) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    // Function bodies are later read on demand as they are compiled
+    madvise(map, st.st_size, MADV_NORMAL);
+
+    module->map = map;
+    module->map_len = st.st_size;
+
+    return module;
+#else
+    printf("Loading modules from files is not supported\r\n");
+    return NULL;
+#endif
+}
+
+wasme_ctx_t* WASME_init_from_file(const char* path, uint32_t mem_limit) {
+    wasme_module_t* module = WASME_module_load_file(path);
+    if (!module) {
+        return NULL;
+    }
+
+    wasme_ctx_t* ctx = WASME_instantiate(module, mem_limit);
+    if (!ctx) {
+        WASME_module_free(&module);
+        return NULL;
+    }
+
+    ctx->owns_module = true;
+
+    return ctx;
+}
+
+void WASME_module_free(wasme_module_t** module) {
+    if(!*module) {
+        return;
+    }
+
+    if(atomic_load(&(*module)->instances)) {
+        printf("Module freed with %d live instances\r\n", atomic_load(&(*module)->instances));
+    }
+
+    // Spare module was never loaded into a runtime so must be freed manually
+    module_parsed_free(atomic_exchange(&(*module)->spare, NULL));
+
+#ifdef WASME_USE_MMAP
+    // Unmapped last as wasm3 references the binary until freed
+    if((*module)->map) {
+        munmap((*module)->map, (*module)->map_len);
+    }
+#endif
+
+    free(*module);
+
+    *module = NULL;
+}
+
+wasme_ctx_t* WASME_instantiate(wasme_module_t* module, uint32_t mem_limit) {
     M3Result m3_res;
-    int32_t res = 0;
 
     wasme_ctx_t* ctx = malloc(sizeof(wasme_ctx_t));
     if(!ctx) {
         printf("Allocating wasme_ctx_t failed\r\n");
-        res = -1;
 
         return NULL;
     }
+    memset(ctx, 0, sizeof(wasme_ctx_t));
 
-    // Setup environment
-    ctx->env = m3_NewEnvironment ();
-    if (!ctx->env) {
-        printf("NewEnvironment failed\r\n");
-        res = -2;
+    ctx->module = module;
 
-        goto teardown_env;
+    wasme_snapshot_init(ctx);
+    wasme_handles_init(ctx);
+
+    // Use the module parsed ahead of time if available, otherwise parse the
+    // validated binary now as wasm3 binds modules to a single runtime
+    wasme_parsed_t* parsed = atomic_exchange(&module->spare, NULL);
+    if (!parsed) {
+        parsed = module_parse(module);
     }
+    if (!parsed) {
+        goto teardown_ctx;
+    }
+
+    // Environment is private to this instance so instances of one module may
+    // execute concurrently
+    ctx->env = parsed->env;
+    ctx->mod = parsed->mod;
+    free(parsed);
 
     // Setup runtime
     ctx->rt = m3_NewRuntime(ctx->env, mem_limit, NULL);
     if (!ctx->rt) {
         printf("NewRuntime failed\r\n");
-        res = -3;
-
-        goto teardown_rt;
-    }
-
-    printf( "Loading WebAssembly (p: %p, %d bytes)...\r\n", (void*)task->data, task->data_len);
-
-    // Parse module into environment
-    m3_res = m3_ParseModule (ctx->env, &ctx->mod, task->data, task->data_len);
-    if (m3_res) {
-        printf("ParseModule failed: %s\r\n", m3_res);
-        res = -4;
 
-        // Only unloaded modules should be manually freed
         m3_FreeModule(ctx->mod);
 
-        goto teardown_rt;
+        goto teardown_env;
     }
 
     // Load module into runtime
     m3_res = m3_LoadModule(ctx->rt, ctx->mod);
     if (m3_res) {
         printf("LoadModule failed: %s\r\n", m3_res);
-        res = -5;
+
+        m3_FreeModule(ctx->mod);
 
         goto teardown_rt;
     }
 
     // Link WASI functions
-    m3_res = m3_LinkWASI(ctx->mod);
+    m3_res = m3_LinkWASI(ctx->mod, &ctx->wasi);
     if (m3_res) {
         printf("LinkWasi failed: %s\r\n", m3_res);
-        res = -6;
 
         goto teardown_rt;
     }
 
+    // poll_oneoff also waits on driver events so is bound to the context
+    if (wasme_poll_link(ctx)) {
+        goto teardown_rt;
+    }
+
+    atomic_fetch_add(&module->instances, 1);
+
     return ctx;
 
 teardown_rt:
@@ -77,18 +277,47 @@ teardown_rt:
 teardown_env:
     m3_FreeEnvironment(ctx->env);
 
+teardown_ctx:
     free(ctx);
-    
+
     return NULL;
 }
 
+wasme_ctx_t* WASME_init(const wasme_task_t* task, uint32_t mem_limit) {
+    wasme_module_t* module = WASME_module_load(task);
+    if (!module) {
+        return NULL;
+    }
+
+    wasme_ctx_t* ctx = WASME_instantiate(module, mem_limit);
+    if (!ctx) {
+        WASME_module_free(&module);
+        return NULL;
+    }
+
+    // Module is private to this context and released with it
+    ctx->owns_module = true;
+
+    return ctx;
+}
+
 void WASME_deinit(wasme_ctx_t** ctx) {
     if(!*ctx) {
         return;
     }
 
-    // TODO: de-init module too
+    // Flush console output buffered by the task
+    wasme_console_deinit(*ctx);
+    wasme_snapshot_deinit(*ctx);
+    wasme_fuel_deinit(*ctx);
+
+    // Close driver handles the task left open, before linear memory is released
+    wasme_handles_release(*ctx, 0);
+    free((*ctx)->gpio_events.events);
+    wasme_poll_deinit(*ctx);
+    wasme_vfs_deinit(*ctx);
 
+    // Loaded modules are released with the runtime
     if((*ctx)->rt) {
         m3_FreeRuntime((*ctx)->rt);
     }
@@ -97,55 +326,185 @@ void WASME_deinit(wasme_ctx_t** ctx) {
         m3_FreeEnvironment((*ctx)->env);
     }
 
+    if((*ctx)->module) {
+        atomic_fetch_sub(&(*ctx)->module->instances, 1);
+
+        if((*ctx)->owns_module) {
+            WASME_module_free(&(*ctx)->module);
+        }
+    }
+
     free(*ctx);
 
     *ctx = NULL;
 }
 
+void WASME_set_clock(wasme_ctx_t* ctx, const wasme_clock_t* clock, void* arg) {
+    ctx->wasi.clock = clock;
+    ctx->wasi.clock_arg = arg;
+}
+
+int64_t wasme_clock_monotonic(wasme_ctx_t* ctx) {
+    uint64_t now = 0;
+    m3_wasi_clock_time_get(&ctx->wasi, __WASI_CLOCKID_MONOTONIC, &now);
+
+    return (int64_t)now;
+}
+
+void wasme_mem_pin_update(wasme_ctx_t* ctx) {
+    bool pin = false;
+
+    for (uint32_t i = 0; i < WASME_UART_MAX_STREAMS && !pin; i++) {
+        pin = ctx->uart_streams[i].active;
+    }
+    for (uint32_t i = 0; i < WASME_SAMPLER_MAX && !pin; i++) {
+        pin = ctx->samplers[i].active;
+    }
+
+    if (!ctx->rt || pin == ctx->mem_pinned) {
+        return;
+    }
+
+    // memory.grow reallocates linear memory, so capping the limit at the current
+    // size makes it fail in the guest rather than move memory under a producer
+    M3Memory* memory = &ctx->rt->memory;
+    if (pin) {
+        ctx->mem_max_pages = memory->maxPages;
+        memory->maxPages = memory->numPages;
+    } else {
+        memory->maxPages = ctx->mem_max_pages;
+    }
+    ctx->mem_pinned = pin;
+}
+
+// Print diagnostics for a failed call
+static void print_call_error(wasme_ctx_t* ctx, M3Result m3_res) {
+    wasme_console_printf(ctx, "CallWithArgs failed: %s\r\n", m3_res);
+
+    M3ErrorInfo error_info = { 0 };
+    m3_GetErrorInfo(ctx->rt, &error_info);
+
+    wasme_console_printf(ctx, "message: %s\r\n", error_info.message);
+
+    if (error_info.module) {
+        wasme_console_printf(ctx, "module: %s\r\n", m3_GetModuleName(error_info.module));
+    }
+
+    if (error_info.function) {
+        wasme_console_printf(ctx, "function: %s\r\n", m3_GetFunctionName(error_info.function));
+    }
+
+    // Console output is flushed on a trap, before wasm3 prints its state directly
+    WASME_console_flush(ctx);
+
+    m3_PrintM3Info();
+    m3_PrintRuntimeInfo(ctx->rt);
+}
+
 int WASME_run(wasme_ctx_t* ctx, const char* name, int32_t argc, const char** argv) {
 
+#ifdef WASIENV
+    // Bind argc/argv via WASI
+    ctx->wasi.argc = argc;
+    ctx->wasi.argv = argv;
+    // TODO: actually use this?
+#endif
+
+    // Metered or async runs execute via the fuel module so they can be suspended
+    if (ctx->fuel_enabled || ctx->async_enabled || ctx->exec.suspended) {
+        return wasme_fuel_exec(ctx, name, NULL, NULL, 0, NULL, 0);
+    }
+
+    return wasme_exec_run(ctx, name);
+}
+
+int wasme_exec_run(wasme_ctx_t* ctx, const char* name) {
+
     // Locate function to call
     IM3Function f;
     M3Result m3_res = m3_FindFunction (&f, ctx->rt, name);
     if (m3_res) {
-        printf("FindFunction failed: %s\r\n", m3_res);
+        wasme_console_printf(ctx, "FindFunction failed: %s\r\n", m3_res);
         return -1;
     }
 
-#ifdef WASIENV
-    // Bind argc/argv via WASI
-    m3_wasi_context_t* wasi_ctx = m3_GetWasiContext();
-    wasi_ctx->argc = argc;
-    wasi_ctx->argv = argv;
-    // TODO: actually use this?
-#endif
-
     // Call function
     m3_res = m3_Call(f, 0, NULL);
     if (m3_res) {
-        printf("CallWithArgs failed: %s\r\n", m3_res);
+        print_call_error(ctx, m3_res);
 
-        M3ErrorInfo error_info = { 0 };
-        m3_GetErrorInfo(ctx->rt, &error_info);
+        return -2;
+    }
 
-        printf("message: %s\r\n", error_info.message);
 
-        if (error_info.module) {
-            printf("module: %s\r\n", m3_GetModuleName(error_info.module));
-        }
+    // TODO: fetch result (int)
+
+    return 0;
+}
+
+wasme_func_t* WASME_lookup(wasme_ctx_t* ctx, const char* name) {
+    IM3Function f;
+
+    // Lookup also compiles the function so later calls skip this
+    M3Result m3_res = m3_FindFunction (&f, ctx->rt, name);
+    if (m3_res) {
+        wasme_console_printf(ctx, "FindFunction failed: %s\r\n", m3_res);
+        return NULL;
+    }
+
+    return (wasme_func_t*)f;
+}
+
+int WASME_call(wasme_ctx_t* ctx, wasme_func_t* func, const wasme_val_t* args, uint32_t argc,
+        wasme_val_t* results, uint32_t resc) {
+
+    // Metered or async calls execute via the fuel module so they can be suspended
+    if (ctx->fuel_enabled || ctx->async_enabled || ctx->exec.suspended) {
+        return wasme_fuel_exec(ctx, NULL, func, args, argc, results, resc);
+    }
+
+    return wasme_exec_call(ctx, func, args, argc, results, resc);
+}
 
-        if (error_info.function) {
-            printf("function: %s\r\n", m3_GetFunctionName(error_info.function));
+int wasme_exec_call(wasme_ctx_t* ctx, wasme_func_t* func, const wasme_val_t* args, uint32_t argc,
+        wasme_val_t* results, uint32_t resc) {
+    IM3Function f = (IM3Function)func;
+    const void* ptrs[WASME_MAX_VALS];
+
+    // Check signature matches
+    if (argc > WASME_MAX_VALS || argc != m3_GetArgCount(f)) {
+        return -1;
+    }
+    if (resc > WASME_MAX_VALS || resc != m3_GetRetCount(f)) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < argc; i++) {
+        if ((M3ValueType)args[i].type != m3_GetArgType(f, i)) {
+            return -1;
         }
+        ptrs[i] = &args[i].of;
+    }
 
-        m3_PrintM3Info();
-        m3_PrintRuntimeInfo(ctx->rt);
+    // Call function
+    M3Result m3_res = m3_Call(f, argc, ptrs);
+    if (m3_res) {
+        print_call_error(ctx, m3_res);
 
         return -2;
     }
 
+    // Fetch results
+    for (uint32_t i = 0; i < resc; i++) {
+        results[i].type = (wasme_type_t)m3_GetRetType(f, i);
+        ptrs[i] = &results[i].of;
+    }
 
-    // TODO: fetch result (int)
+    m3_res = m3_GetResults(f, resc, ptrs);
+    if (m3_res) {
+        wasme_console_printf(ctx, "GetResults failed: %s\r\n", m3_res);
+        return -3;
+    }
 
     return 0;
 }
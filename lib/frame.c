@@ -0,0 +1,207 @@
+
+#include "wasm_embedded/wasm3/frame.h"
+
+#include <string.h>
+
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+static uint16_t crc16_ccitt(const uint8_t* data, uint32_t len) {
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+static uint32_t crc32_ieee(const uint8_t* data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+
+    return ~crc;
+}
+
+void WASME_frame_init(wasme_frame_t* f, const wasme_frame_cfg_t* cfg, uint8_t* buf, uint32_t cap) {
+    memset(f, 0, sizeof(wasme_frame_t));
+
+    f->cfg = *cfg;
+    f->buf = buf;
+    f->cap = cap;
+}
+
+// Clear per-frame state ready for the next frame
+static void frame_reset(wasme_frame_t* f) {
+    f->len = 0;
+    f->esc = false;
+    f->discard = false;
+    f->cobs_code = 0;
+    f->need = 0;
+    f->hdr_read = 0;
+}
+
+static void frame_push(wasme_frame_t* f, uint8_t b) {
+    if (f->len < f->cap) {
+        f->buf[f->len++] = b;
+    } else {
+        f->discard = true;
+    }
+}
+
+// Complete the current frame, validating and stripping any CRC
+static int32_t frame_end(wasme_frame_t* f) {
+    int32_t res = WASME_FRAME_READY;
+    uint32_t len = f->len;
+
+    if (f->discard) {
+        res = WASME_FRAME_ERR_OVERFLOW;
+
+    } else if (f->cfg.crc == WASME_FRAME_CRC16) {
+        if (len < 2) {
+            res = WASME_FRAME_ERR_CRC;
+        } else {
+            len -= 2;
+            uint16_t crc = ((uint16_t)f->buf[len] << 8) | f->buf[len + 1];
+            if (crc != crc16_ccitt(f->buf, len)) {
+                res = WASME_FRAME_ERR_CRC;
+            }
+        }
+
+    } else if (f->cfg.crc == WASME_FRAME_CRC32) {
+        if (len < 4) {
+            res = WASME_FRAME_ERR_CRC;
+        } else {
+            len -= 4;
+            uint32_t crc = (uint32_t)f->buf[len] | ((uint32_t)f->buf[len + 1] << 8)
+                | ((uint32_t)f->buf[len + 2] << 16) | ((uint32_t)f->buf[len + 3] << 24);
+            if (crc != crc32_ieee(f->buf, len)) {
+                res = WASME_FRAME_ERR_CRC;
+            }
+        }
+    }
+
+    f->frame_len = (res == WASME_FRAME_READY) ? len : 0;
+    frame_reset(f);
+
+    return res;
+}
+
+// Decode one byte, returning a feed result
+static int32_t frame_byte(wasme_frame_t* f, uint8_t b) {
+    switch (f->cfg.mode) {
+        case WASME_FRAME_DELIM:
+            if (b != f->cfg.param) {
+                frame_push(f, b);
+            } else if (f->len || f->discard) {
+                return frame_end(f);
+            }
+            break;
+
+        case WASME_FRAME_SLIP:
+            if (b == SLIP_END) {
+                if (f->len || f->discard) {
+                    return frame_end(f);
+                }
+            } else if (f->esc) {
+                f->esc = false;
+                if (b == SLIP_ESC_END) {
+                    frame_push(f, SLIP_END);
+                } else if (b == SLIP_ESC_ESC) {
+                    frame_push(f, SLIP_ESC);
+                } else {
+                    frame_reset(f);
+                    return WASME_FRAME_ERR_CODING;
+                }
+            } else if (b == SLIP_ESC) {
+                f->esc = true;
+            } else {
+                frame_push(f, b);
+            }
+            break;
+
+        case WASME_FRAME_COBS:
+            if (b == 0) {
+                // Delimiter must land on a block boundary
+                if (f->need) {
+                    frame_reset(f);
+                    return WASME_FRAME_ERR_CODING;
+                }
+                if (f->len || f->cobs_code || f->discard) {
+                    return frame_end(f);
+                }
+            } else if (f->need) {
+                frame_push(f, b);
+                f->need--;
+            } else {
+                // New block, the previous short block implied a zero
+                if (f->cobs_code && f->cobs_code != 0xFF) {
+                    frame_push(f, 0);
+                }
+                f->cobs_code = b;
+                f->need = b - 1;
+            }
+            break;
+
+        case WASME_FRAME_LEN:
+            if (f->hdr_read < f->cfg.param) {
+                f->need |= (uint32_t)b << (8 * f->hdr_read);
+                f->hdr_read++;
+
+                if (f->hdr_read == f->cfg.param) {
+                    if (f->need > f->cap) {
+                        // Skip the oversized payload to stay in sync
+                        f->discard = true;
+                    }
+                    if (f->need == 0) {
+                        return frame_end(f);
+                    }
+                }
+            } else {
+                frame_push(f, b);
+                if (--f->need == 0) {
+                    return frame_end(f);
+                }
+            }
+            break;
+    }
+
+    return WASME_FRAME_MORE;
+}
+
+int32_t WASME_frame_feed(wasme_frame_t* f, const uint8_t* data, uint32_t len, uint32_t* consumed) {
+    for (uint32_t i = 0; i < len; i++) {
+        int32_t res = frame_byte(f, data[i]);
+        if (res != WASME_FRAME_MORE) {
+            *consumed = i + 1;
+            return res;
+        }
+    }
+
+    *consumed = len;
+
+    return WASME_FRAME_MORE;
+}
+
+uint32_t WASME_frame_want(const wasme_frame_t* f) {
+    if (f->cfg.mode != WASME_FRAME_LEN) {
+        return 1;
+    }
+
+    if (f->hdr_read < f->cfg.param) {
+        return f->cfg.param - f->hdr_read;
+    }
+
+    return f->need;
+}
@@ -0,0 +1,270 @@
+
+#include "wasm_embedded/wasm3/core.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_core.h"
+
+#ifdef WASME_USE_FIBERS
+#include <ucontext.h>
+
+struct wasme_fiber_s {
+    // Context of the thread that started or resumed the fiber
+    ucontext_t caller;
+    // Context of the fiber executing wasm
+    ucontext_t fiber;
+    void* stack;
+};
+#endif
+
+// Context currently executing on this thread, used by m3_Yield
+#ifdef WASME_USE_THREADS
+static _Thread_local wasme_ctx_t* fuel_current = NULL;
+#else
+static wasme_ctx_t* fuel_current = NULL;
+#endif
+
+#ifndef WASME_USE_FIBERS
+static const char* wasme_err_fuel = "[trap] out of fuel";
+#endif
+
+void WASME_set_fuel(wasme_ctx_t* ctx, uint64_t fuel) {
+    ctx->fuel = fuel;
+    ctx->fuel_enabled = true;
+}
+
+uint64_t WASME_get_fuel(wasme_ctx_t* ctx) {
+    return ctx->fuel;
+}
+
+void WASME_disable_fuel(wasme_ctx_t* ctx) {
+    ctx->fuel_enabled = false;
+}
+
+// Execute the pending run or call
+static int exec_pending(wasme_ctx_t* ctx) {
+    wasme_exec_t* e = &ctx->exec;
+
+    if (e->func) {
+        return wasme_exec_call(ctx, e->func, e->args, e->argc, e->results, e->resc);
+    }
+
+    return wasme_exec_run(ctx, e->name);
+}
+
+#ifdef WASME_USE_FIBERS
+
+static void fiber_main(void) {
+    wasme_ctx_t* ctx = fuel_current;
+
+    ctx->exec.result = exec_pending(ctx);
+    ctx->exec.done = true;
+
+    // Returning switches to uc_link, the most recent caller
+}
+
+// Switch into the fiber until it completes, suspends or parks
+static int fiber_switch(wasme_ctx_t* ctx, wasme_val_t* results) {
+    wasme_exec_t* e = &ctx->exec;
+
+    wasme_ctx_t* prev = fuel_current;
+    fuel_current = ctx;
+
+    while (true) {
+        e->parking = false;
+
+        swapcontext(&ctx->fiber->caller, &ctx->fiber->fiber);
+
+        if (e->done || !e->parking) {
+            break;
+        }
+
+        // Only report parked once the fiber is saved, as completion may resume
+        // the task immediately on another thread
+        e->suspended = true;
+        e->pending = true;
+        fuel_current = prev;
+
+        if (wasme_async_park(ctx)) {
+            return WASME_PENDING;
+        }
+
+        // Driver completed already, continue without returning
+        e->suspended = false;
+        e->pending = false;
+        fuel_current = ctx;
+    }
+
+    fuel_current = prev;
+
+    if (!e->done) {
+        e->suspended = true;
+        return WASME_SUSPENDED;
+    }
+
+    e->suspended = false;
+
+    if (e->func && results) {
+        memcpy(results, e->results, e->resc * sizeof(wasme_val_t));
+    }
+
+    return e->result;
+}
+
+#endif
+
+int wasme_fuel_exec(wasme_ctx_t* ctx, const char* name, wasme_func_t* func,
+        const wasme_val_t* args, uint32_t argc, wasme_val_t* results, uint32_t resc) {
+    wasme_exec_t* e = &ctx->exec;
+
+    // A suspended execution must be resumed or the context reset first
+    if (e->suspended) {
+        printf("Context has a suspended execution\r\n");
+        return -1;
+    }
+
+    if (argc > WASME_MAX_VALS || resc > WASME_MAX_VALS) {
+        return -1;
+    }
+
+    e->name = name;
+    e->func = func;
+    e->argc = argc;
+    e->resc = resc;
+    e->done = false;
+    if (argc) {
+        memcpy(e->args, args, argc * sizeof(wasme_val_t));
+    }
+
+#ifdef WASME_USE_FIBERS
+    if (!ctx->fiber) {
+        ctx->fiber = malloc(sizeof(struct wasme_fiber_s));
+        if (!ctx->fiber) {
+            printf("Allocating fiber failed\r\n");
+            return -1;
+        }
+
+        ctx->fiber->stack = malloc(WASME_FIBER_STACK_SIZE);
+        if (!ctx->fiber->stack) {
+            printf("Allocating fiber stack failed\r\n");
+            free(ctx->fiber);
+            ctx->fiber = NULL;
+            return -1;
+        }
+    }
+
+    struct wasme_fiber_s* fiber = ctx->fiber;
+
+    getcontext(&fiber->fiber);
+    fiber->fiber.uc_stack.ss_sp = fiber->stack;
+    fiber->fiber.uc_stack.ss_size = WASME_FIBER_STACK_SIZE;
+    fiber->fiber.uc_link = &fiber->caller;
+    makecontext(&fiber->fiber, fiber_main, 0);
+
+    return fiber_switch(ctx, results);
+#else
+    // Without fibers running out of fuel traps
+    wasme_ctx_t* prev = fuel_current;
+    fuel_current = ctx;
+
+    int res = exec_pending(ctx);
+
+    fuel_current = prev;
+
+    if (e->func && results) {
+        memcpy(results, e->results, resc * sizeof(wasme_val_t));
+    }
+
+    return res;
+#endif
+}
+
+int WASME_resume(wasme_ctx_t* ctx, wasme_val_t* results, uint32_t resc) {
+    wasme_exec_t* e = &ctx->exec;
+
+    if (!e->suspended) {
+        return -1;
+    }
+
+    if (e->func && resc != e->resc) {
+        return -1;
+    }
+
+    // Parked tasks stay parked until their driver completes
+    if (e->pending) {
+        if (!wasme_async_ready(ctx)) {
+            return WASME_PENDING;
+        }
+        e->pending = false;
+    }
+
+#ifdef WASME_USE_FIBERS
+    return fiber_switch(ctx, results);
+#else
+    return -1;
+#endif
+}
+
+wasme_ctx_t* wasme_exec_current(void) {
+    return fuel_current;
+}
+
+bool wasme_fiber_active(wasme_ctx_t* ctx) {
+#ifdef WASME_USE_FIBERS
+    return ctx->fiber && fuel_current == ctx && !ctx->exec.done;
+#else
+    return false;
+#endif
+}
+
+void wasme_fiber_park(wasme_ctx_t* ctx) {
+#ifdef WASME_USE_FIBERS
+    ctx->exec.parking = true;
+    swapcontext(&ctx->fiber->fiber, &ctx->fiber->caller);
+#endif
+}
+
+void wasme_fuel_deinit(wasme_ctx_t* ctx) {
+#ifdef WASME_USE_FIBERS
+    if (ctx->fiber) {
+        free(ctx->fiber->stack);
+        free(ctx->fiber);
+        ctx->fiber = NULL;
+    }
+#endif
+    ctx->exec.suspended = false;
+    ctx->exec.pending = false;
+}
+
+// Called by wasm3 on each function call, overriding the weak default
+M3Result m3_Yield(void) {
+    wasme_ctx_t* ctx = fuel_current;
+
+    if (!ctx || !ctx->fuel_enabled) {
+        return m3Err_none;
+    }
+
+    if (ctx->fuel > 0) {
+        ctx->fuel--;
+        return m3Err_none;
+    }
+
+#ifdef WASME_USE_FIBERS
+    // Suspend back to the caller until resumed with more fuel, or with
+    // metering disabled to run to completion
+    while (ctx->fuel_enabled && ctx->fuel == 0) {
+        swapcontext(&ctx->fiber->fiber, &ctx->fiber->caller);
+    }
+    if (ctx->fuel_enabled) {
+        ctx->fuel--;
+    }
+
+    return m3Err_none;
+#else
+    return wasme_err_fuel;
+#endif
+}
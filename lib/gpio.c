@@ -2,15 +2,22 @@
 
 #include "wasm3.h"
 #include "m3_env.h"
-#include "m3_api_wasi.h"
 #include "m3_env.h"
 #include "m3_exception.h"
 #include "m3_info.h"
 #include "extra/wasi_core.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "wasm_embedded/wasm3/gpio.h"
+#include "wasm_embedded/wasm3/reactor.h"
 #include "wasm_embedded/wasm3/internal.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
 #define TAG "WASME_GPIO"
 
 
@@ -23,11 +30,6 @@
 #define WASME_GPIO_DEBUG_PRINTF(...)
 #endif
 
-// Shared I2C driver objects
-// TODO: work out how to bind these to wasm3 context
-static const gpio_drv_t* gpio_drv = NULL;
-static const void* gpio_drv_ctx = NULL;
-
 // GPIO debug print flag
 static bool gpio_debug = false;
 
@@ -44,16 +46,29 @@ m3ApiRawFunction(m3_gpio_init)
 
     WASME_GPIO_DEBUG_PRINTF("GPIO init port: %d pin: %d mode: %d\r\n", port, pin, mode);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!gpio_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = gpio_drv->init(gpio_drv_ctx, port, pin, mode);
+    int32_t res = ctx->gpio_drv->init(ctx->gpio_drv_ctx, port, pin, mode);
 
     if(res >= 0) {
-        *handle = res;
-        WASME_GPIO_DEBUG_PRINTF("GPIO handle: %d\r\n", res);
+        // Guest receives a table handle in place of the driver handle
+        int32_t h = wasme_handle_alloc(ctx, WASME_HANDLE_GPIO, res);
+        if (h < 0) {
+            if (ctx->gpio_drv->deinit) {
+                ctx->gpio_drv->deinit(ctx->gpio_drv_ctx, res);
+            }
+            m3ApiReturn(__WASI_ERRNO_NFILE);
+        }
+        *handle = h;
+        res = h;
+        WASME_GPIO_DEBUG_PRINTF("GPIO handle: %d\r\n", h);
     }
 
     m3ApiReturn(res);
@@ -67,12 +82,17 @@ m3ApiRawFunction(m3_gpio_deinit)
 
     WASME_GPIO_DEBUG_PRINTF("GPIO deinit handle: %d\r\n", handle);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!gpio_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = gpio_drv->deinit(gpio_drv_ctx, handle);
+    // Streams, subscriptions and samplers on the handle are stopped with it
+    int32_t res = wasme_handle_close(ctx, WASME_HANDLE_GPIO, handle);
 
     m3ApiReturn(res);
 }
@@ -86,12 +106,19 @@ m3ApiRawFunction(m3_gpio_set)
 
     WASME_GPIO_DEBUG_PRINTF("GPIO set handle: %d value: %u \r\n", handle, value);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!gpio_drv->set) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_drv->set) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_GPIO, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
-    int32_t res = gpio_drv->set(gpio_drv_ctx, handle, value);
+    int32_t res = ctx->gpio_drv->set(ctx->gpio_drv_ctx, handle, value);
 
     m3ApiReturn(res);
 }
@@ -103,60 +130,524 @@ m3ApiRawFunction(m3_gpio_get)
     m3ApiGetArg      (int32_t, handle)
     m3ApiGetArgMem   (int32_t*, value)
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!gpio_drv->get) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_drv->get) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = gpio_drv->get(gpio_drv_ctx, handle, value);
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_GPIO, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    int32_t res = ctx->gpio_drv->get(ctx->gpio_drv_ctx, handle, value);
 
     WASME_GPIO_DEBUG_PRINTF("GPIO get handle: %d value: %u \r\n", handle, *value);
 
     m3ApiReturn(res);
 }
 
-const static char* wasme_gpio_mod = "gpio";
+void WASME_gpio_irq_fire(wasme_gpio_irq_t* irq, int32_t level) {
+    // Host timestamp for interrupts reported without one
+    WASME_gpio_irq_fire_at(irq, level, wasme_clock_monotonic(irq->ctx));
+}
+
+// Queue an event on the subscription ring, returning false if it was filtered or dropped.
+// Lock-free as only the reporting driver writes the ring and debounce state
+static bool gpio_irq_push(wasme_gpio_irq_t* irq, int32_t level, int64_t timestamp) {
+    if (!irq->active) {
+        return false;
+    }
+
+    // Drop triggers the guest did not subscribe to
+    uint32_t accept = level ? (WASME_GPIO_EDGE_RISING | WASME_GPIO_LEVEL_HIGH)
+        : (WASME_GPIO_EDGE_FALLING | WASME_GPIO_LEVEL_LOW);
+    if (!(irq->triggers & accept)) {
+        return false;
+    }
+
+    if (irq->debounce_ns && irq->has_last && timestamp - irq->last_ns < irq->debounce_ns) {
+        return false;
+    }
+    irq->last_ns = timestamp;
+    irq->has_last = true;
+
+    // Each subscription has its own ring so producers never contend
+    uint32_t head = atomic_load_explicit(&irq->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&irq->tail, memory_order_acquire);
+
+    if (head - tail >= WASME_GPIO_EVENT_QUEUE) {
+        atomic_fetch_add_explicit(&irq->ctx->gpio_events.dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    irq->events[head & (WASME_GPIO_EVENT_QUEUE - 1)] = (wasme_gpio_event_t){
+        .handle = irq->guest_handle,
+        .level = level,
+        .timestamp = timestamp,
+    };
+    atomic_store_explicit(&irq->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+// Wake consumers of queued events, these may take locks so not from interrupt context
+static void gpio_wake(wasme_ctx_t* ctx) {
+    wasme_gpio_queue_t* q = &ctx->gpio_events;
+
+    // Wake a waiting guest, the exchange ensures only one side completes the wait
+    if (atomic_exchange(&q->waiting, false)) {
+        WASME_async_complete(ctx, 0);
+    }
+    wasme_poll_notify(ctx);
+
+    if (q->notify) {
+        q->notify(ctx, q->notify_arg);
+    }
+}
+
+void WASME_gpio_irq_fire_at(wasme_gpio_irq_t* irq, int32_t level, int64_t timestamp) {
+    if (gpio_irq_push(irq, level, timestamp)) {
+        gpio_wake(irq->ctx);
+    }
+}
+
+void WASME_gpio_irq_fire_isr(wasme_gpio_irq_t* irq, int32_t level, int64_t timestamp) {
+    if (gpio_irq_push(irq, level, timestamp)) {
+        atomic_store_explicit(&irq->ctx->gpio_events.pending, true, memory_order_release);
+    }
+}
+
+void WASME_gpio_irq_service(wasme_gpio_irq_t* irq) {
+    wasme_ctx_t* ctx = irq->ctx;
+
+    if (ctx && atomic_exchange(&ctx->gpio_events.pending, false)) {
+        gpio_wake(ctx);
+    }
+}
+
+// Pop the oldest event across subscription rings, returning false if all are empty.
+// Rings are drained after unsubscribing so events reported before remain visible
+static bool gpio_event_pop(wasme_ctx_t* ctx, wasme_gpio_event_t* event) {
+    wasme_gpio_irq_t* oldest = NULL;
+    uint32_t oldest_tail = 0;
+
+    if (!ctx->gpio_events.events) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+        wasme_gpio_irq_t* irq = &ctx->gpio_irqs[i];
+
+        uint32_t tail = atomic_load_explicit(&irq->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&irq->head, memory_order_acquire);
+        if (tail == head) {
+            continue;
+        }
+
+        const wasme_gpio_event_t* ev = &irq->events[tail & (WASME_GPIO_EVENT_QUEUE - 1)];
+        if (!oldest || ev->timestamp < oldest->events[oldest_tail & (WASME_GPIO_EVENT_QUEUE - 1)].timestamp) {
+            oldest = irq;
+            oldest_tail = tail;
+        }
+    }
+
+    if (!oldest) {
+        return false;
+    }
+
+    *event = oldest->events[oldest_tail & (WASME_GPIO_EVENT_QUEUE - 1)];
+    atomic_store_explicit(&oldest->tail, oldest_tail + 1, memory_order_release);
+
+    return true;
+}
+
+bool wasme_gpio_pending(wasme_ctx_t* ctx) {
+    if (!ctx->gpio_events.events) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+        wasme_gpio_irq_t* irq = &ctx->gpio_irqs[i];
+        if (atomic_load_explicit(&irq->head, memory_order_acquire)
+                != atomic_load_explicit(&irq->tail, memory_order_relaxed)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void wasme_gpio_flush(wasme_ctx_t* ctx) {
+    for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+        wasme_gpio_irq_t* irq = &ctx->gpio_irqs[i];
+        atomic_store(&irq->tail, atomic_load(&irq->head));
+    }
+    atomic_store(&ctx->gpio_events.pending, false);
+}
+
+void WASME_gpio_set_notify(wasme_ctx_t* ctx, wasme_gpio_notify_f notify, void* arg) {
+    ctx->gpio_events.notify = notify;
+    ctx->gpio_events.notify_arg = arg;
+}
+
+int WASME_gpio_dispatch(wasme_ctx_t* ctx, wasme_reactor_t* reactor, uint32_t handler, uint32_t max) {
+    wasme_gpio_event_t ev;
+    int32_t result;
+    uint32_t n = 0;
+
+    // Events stay queued while a handler is suspended
+    while (n < max && !ctx->exec.suspended && gpio_event_pop(ctx, &ev)) {
+        wasme_event_t event = {
+            .handler = handler,
+            .source = ev.handle,
+            .value = ev.level,
+            .timestamp = ev.timestamp,
+        };
+
+        int res = WASME_reactor_call(reactor, &event, &result);
+        if (res < 0) {
+            return res;
+        }
+
+        n++;
+    }
+
+    return n;
+}
 
-m3ApiRawFunction(fake_deinit)
+m3ApiRawFunction(m3_gpio_subscribe)
 {
     // Load arguments
     m3ApiReturnType  (int32_t)
     m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, triggers)
+    m3ApiGetArg      (uint32_t, debounce_us)
+
+    WASME_GPIO_DEBUG_PRINTF("GPIO subscribe handle: %d triggers: 0x%x debounce: %d us\r\n", handle, triggers, debounce_us);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_irq_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_irq_drv->subscribe) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (triggers == 0 || triggers > 0xF) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    // Resolve guest handle to driver handle, events report the guest handle
+    int32_t guest_handle = handle;
+    if (wasme_handle_get(ctx, WASME_HANDLE_GPIO, guest_handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    // Rings are allocated on first use
+    if (!ctx->gpio_events.events) {
+        ctx->gpio_events.events = calloc(WASME_GPIO_MAX_IRQS * WASME_GPIO_EVENT_QUEUE, sizeof(wasme_gpio_event_t));
+        if (!ctx->gpio_events.events) { m3ApiReturn(__WASI_ERRNO_NOMEM); }
+    }
 
-    int32_t res = 0;
+    wasme_gpio_irq_t* irq = NULL;
+    uint32_t slot = 0;
+    for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+        if (ctx->gpio_irqs[i].active && ctx->gpio_irqs[i].handle == handle) {
+            m3ApiReturn(__WASI_ERRNO_BUSY);
+        }
+        if (!ctx->gpio_irqs[i].active && !irq) {
+            irq = &ctx->gpio_irqs[i];
+            slot = i;
+        }
+    }
+    if (!irq) { m3ApiReturn(__WASI_ERRNO_NFILE); }
+
+    irq->ctx = ctx;
+    irq->handle = handle;
+    irq->guest_handle = guest_handle;
+    irq->triggers = triggers;
+    irq->debounce_ns = (int64_t)debounce_us * 1000;
+    irq->has_last = false;
+
+    // Events left from a previous subscription in this slot are discarded
+    irq->events = &ctx->gpio_events.events[slot * WASME_GPIO_EVENT_QUEUE];
+    atomic_store(&irq->tail, atomic_load(&irq->head));
+    irq->active = true;
+
+    int32_t res = ctx->gpio_irq_drv->subscribe(ctx->gpio_irq_drv_ctx, handle, triggers, irq);
+    if (res != 0) {
+        irq->active = false;
+    }
 
     m3ApiReturn(res);
 }
 
+m3ApiRawFunction(m3_gpio_unsubscribe)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+
+    WASME_GPIO_DEBUG_PRINTF("GPIO unsubscribe handle: %d\r\n", handle);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_irq_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_GPIO, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+        wasme_gpio_irq_t* irq = &ctx->gpio_irqs[i];
+
+        if (irq->active && irq->handle == handle) {
+            int32_t res = 0;
+            if (ctx->gpio_irq_drv->unsubscribe) {
+                res = ctx->gpio_irq_drv->unsubscribe(ctx->gpio_irq_drv_ctx, handle);
+            }
+            irq->active = false;
+
+            m3ApiReturn(res);
+        }
+    }
+
+    m3ApiReturn(__WASI_ERRNO_BADF);
+}
+
+m3ApiRawFunction(m3_gpio_poll_event)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (uint32_t, event_ptr)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    uint8_t* out = wasme_mem_range(runtime, event_ptr, sizeof(wasme_gpio_event_t));
+    if (!out) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    wasme_gpio_event_t ev;
+    if (!gpio_event_pop(ctx, &ev)) {
+        m3ApiReturn(__WASI_ERRNO_AGAIN);
+    }
+
+    memcpy(out, &ev, sizeof(ev));
+
+    m3ApiReturn(0);
+}
+
+m3ApiRawFunction(m3_gpio_wait_event)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (uint32_t, event_ptr)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_events.events) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    uint8_t* out = wasme_mem_range(runtime, event_ptr, sizeof(wasme_gpio_event_t));
+    if (!out) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    wasme_gpio_queue_t* q = &ctx->gpio_events;
+    wasme_gpio_event_t ev;
+
+    while (!gpio_event_pop(ctx, &ev)) {
+        // Flag waiting before re-checking so a concurrent event cannot be missed
+        atomic_store(&q->waiting, true);
+
+        if (wasme_gpio_pending(ctx) && atomic_exchange(&q->waiting, false)) {
+            continue;
+        }
+
+        // Park or block until the next event
+        int32_t res = wasme_async_wait(ctx, WASME_DRV_PENDING);
+        if (res < 0) {
+            m3ApiReturn(res);
+        }
+    }
+
+    memcpy(out, &ev, sizeof(ev));
+
+    m3ApiReturn(0);
+}
+
+// Wait until a monotonic deadline, sleeping while far enough away and
+// spinning for the remainder to keep step edges accurate
+static void gpio_wait_until(wasme_ctx_t* ctx, int64_t deadline) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int64_t spin_ns = 100000;
+
+    int64_t remaining = deadline - wasme_clock_monotonic(ctx);
+    if (remaining > spin_ns) {
+        struct timespec ts = {
+            .tv_sec = (remaining - spin_ns) / 1000000000,
+            .tv_nsec = (remaining - spin_ns) % 1000000000,
+        };
+        nanosleep(&ts, NULL);
+    }
+#endif
+
+    while (wasme_clock_monotonic(ctx) < deadline) {}
+}
+
+m3ApiRawFunction(m3_gpio_port_write)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, port)
+    m3ApiGetArg      (uint32_t, mask)
+    m3ApiGetArg      (uint32_t, value)
+
+    WASME_GPIO_DEBUG_PRINTF("GPIO port write port: %d mask: 0x%x value: 0x%x\r\n", port, mask, value);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_port_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_port_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    int32_t res = ctx->gpio_port_drv->write(ctx->gpio_port_drv_ctx, port, mask, value);
+
+    m3ApiReturn(res);
+}
+
+m3ApiRawFunction(m3_gpio_port_read)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, port)
+    m3ApiGetArg      (uint32_t, value_ptr)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_port_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->gpio_port_drv->read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    uint8_t* out = wasme_mem_range(runtime, value_ptr, sizeof(uint32_t));
+    if (!out) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    uint32_t value = 0;
+    int32_t res = ctx->gpio_port_drv->read(ctx->gpio_port_drv_ctx, port, &value);
+
+    // Leave the guest value untouched if the driver failed
+    if (res == 0) {
+        memcpy(out, &value, sizeof(value));
+    }
+
+    WASME_GPIO_DEBUG_PRINTF("GPIO port read port: %d value: 0x%x\r\n", port, value);
+
+    m3ApiReturn(res);
+}
+
+m3ApiRawFunction(m3_gpio_waveform)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, port)
+    m3ApiGetArg      (uint32_t, steps_ptr)
+    m3ApiGetArg      (uint32_t, num_steps)
+
+    WASME_GPIO_DEBUG_PRINTF("GPIO waveform port: %d steps: 0x%x count: %d\r\n", port, steps_ptr, num_steps);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->gpio_port_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (num_steps > WASME_GPIO_MAX_STEPS) { m3ApiReturn(__WASI_ERRNO_2BIG); }
+    if (steps_ptr & 3) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    // Steps are used in place, the guest layout matches wasme_gpio_step_t
+    const wasme_gpio_step_t* steps = (const wasme_gpio_step_t*)wasme_mem_range(runtime, steps_ptr, num_steps * sizeof(wasme_gpio_step_t));
+    if (!steps) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Drivers without native playback may also return NOTSUP to use host timing
+    if (ctx->gpio_port_drv->waveform) {
+        int32_t res = ctx->gpio_port_drv->waveform(ctx->gpio_port_drv_ctx, port, steps, num_steps);
+        if (res != __WASI_ERRNO_NOTSUP) {
+            // Park the task if the driver completes asynchronously
+            res = wasme_async_wait(ctx, res);
+
+            m3ApiReturn(res);
+        }
+    }
+
+    if (!ctx->gpio_port_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Play out against absolute deadlines so per-step overhead does not accumulate
+    int64_t deadline = wasme_clock_monotonic(ctx);
+    for (uint32_t i = 0; i < num_steps; i++) {
+        int32_t res = ctx->gpio_port_drv->write(ctx->gpio_port_drv_ctx, port, steps[i].mask, steps[i].value);
+        if (res != 0) {
+            m3ApiReturn(res);
+        }
+
+        deadline += steps[i].delay_ns;
+        gpio_wait_until(ctx, deadline);
+    }
+
+    m3ApiReturn(0);
+}
+
+const static char* wasme_gpio_mod = "gpio";
+
 int32_t WASME_bind_gpio(wasme_ctx_t* ctx, const gpio_drv_t* drv, void* drv_ctx) {
     M3Result m3_res;
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_gpio_mod, "init", "i(iiii)", &m3_gpio_init);
+    ctx->gpio_drv = drv;
+    ctx->gpio_drv_ctx = drv_ctx;
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "init", "i(iiii)", &m3_gpio_init, ctx);
     if (m3_res) {
         goto gpio_bind_err;
     }
     
-    // TODO: work out why this fails...
-#if 0
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_gpio_mod, "deinit", "i(i)", &m3_gpio_deinit);
-    if (m3_res) {
+    // Guests that never release pins do not import deinit, handles are then closed with the context
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "deinit", "i(i)", &m3_gpio_deinit, ctx);
+    if (m3_res && m3_res != m3Err_functionLookupFailed) {
         goto gpio_bind_err;
     }
-#endif
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_gpio_mod, "set", "i(ii)", &m3_gpio_set);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "set", "i(ii)", &m3_gpio_set, ctx);
     if (m3_res) {
         goto gpio_bind_err;
     }
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_gpio_mod, "get", "i(ii)", &m3_gpio_get);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "get", "i(ii)", &m3_gpio_get, ctx);
     if (m3_res) {
         goto gpio_bind_err;
     }
 
-    gpio_drv = drv;
-    gpio_drv_ctx = drv_ctx;
-    
+    // Event and port functions are optional imports, so missing imports are not errors
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "subscribe", "i(iii)", &m3_gpio_subscribe, ctx);
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "unsubscribe", "i(i)", &m3_gpio_unsubscribe, ctx);
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "poll_event", "i(i)", &m3_gpio_poll_event, ctx);
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "wait_event", "i(i)", &m3_gpio_wait_event, ctx);
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "port_write", "i(iii)", &m3_gpio_port_write, ctx);
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "port_read", "i(ii)", &m3_gpio_port_read, ctx);
+    m3_LinkRawFunctionEx(ctx->mod, wasme_gpio_mod, "waveform", "i(iii)", &m3_gpio_waveform, ctx);
+
     return 0;
 
 
@@ -167,3 +658,19 @@ gpio_bind_err:
 
     return -1;
 }
+
+int32_t WASME_bind_gpio_irq(wasme_ctx_t* ctx, const wasme_gpio_irq_drv_t* drv, void* drv_ctx) {
+    // Used by the event functions linked in WASME_bind_gpio
+    ctx->gpio_irq_drv = drv;
+    ctx->gpio_irq_drv_ctx = drv_ctx;
+
+    return 0;
+}
+
+int32_t WASME_bind_gpio_port(wasme_ctx_t* ctx, const wasme_gpio_port_drv_t* drv, void* drv_ctx) {
+    // Used by the port functions linked in WASME_bind_gpio
+    ctx->gpio_port_drv = drv;
+    ctx->gpio_port_drv_ctx = drv_ctx;
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+
+#include "wasm3.h"
+#include "extra/wasi_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wasm_embedded/wasm3/internal.h"
+
+#define HANDLE_INDEX(h) ((uint32_t)(h) & 0xFF)
+#define HANDLE_GEN(h) (((uint32_t)(h) >> 8) & 0xFFFF)
+
+void wasme_handles_init(wasme_ctx_t* ctx) {
+    wasme_handle_table_t* t = &ctx->handles;
+
+    // Lowest indices are handed out first
+    for (uint32_t i = 0; i < WASME_MAX_HANDLES; i++) {
+        t->entries[i].kind = WASME_HANDLE_FREE;
+        t->entries[i].generation = 1;
+        t->free[i] = WASME_MAX_HANDLES - 1 - i;
+    }
+    t->num_free = WASME_MAX_HANDLES;
+}
+
+int32_t wasme_handle_alloc(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t drv_handle) {
+    wasme_handle_table_t* t = &ctx->handles;
+
+    if (!t->num_free) {
+        return -1;
+    }
+
+    uint32_t index = t->free[--t->num_free];
+    wasme_handle_t* e = &t->entries[index];
+    e->kind = kind;
+    e->drv_handle = drv_handle;
+    e->seq = t->seq++;
+
+    return (int32_t)((uint32_t)e->generation << 8 | index);
+}
+
+int32_t wasme_handle_get(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t handle, int32_t* drv_handle) {
+    uint32_t index = HANDLE_INDEX(handle);
+
+    if (handle < 0 || index >= WASME_MAX_HANDLES) {
+        return __WASI_ERRNO_BADF;
+    }
+
+    wasme_handle_t* e = &ctx->handles.entries[index];
+    if (e->kind != kind || e->generation != HANDLE_GEN(handle)) {
+        return __WASI_ERRNO_BADF;
+    }
+
+    *drv_handle = e->drv_handle;
+
+    return 0;
+}
+
+// Return an entry to the free stack, invalidating outstanding guest handles
+static void handle_free(wasme_ctx_t* ctx, uint32_t index) {
+    wasme_handle_table_t* t = &ctx->handles;
+    wasme_handle_t* e = &t->entries[index];
+
+    e->kind = WASME_HANDLE_FREE;
+    e->generation += 1;
+    if (e->generation == 0) {
+        e->generation = 1;
+    }
+
+    t->free[t->num_free++] = index;
+}
+
+// Stop streams, framers, subscriptions and samplers using a driver handle
+static void handle_stop(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t drv_handle) {
+    switch (kind) {
+    case WASME_HANDLE_UART:
+        for (uint32_t i = 0; i < WASME_UART_MAX_STREAMS; i++) {
+            wasme_uart_stream_t* stream = &ctx->uart_streams[i];
+            if (stream->active && stream->handle == drv_handle) {
+                if (ctx->uart_stream_drv->stop) {
+                    ctx->uart_stream_drv->stop(ctx->uart_stream_drv_ctx, drv_handle);
+                }
+                stream->active = false;
+            }
+        }
+        for (uint32_t i = 0; i < WASME_UART_MAX_FRAMERS; i++) {
+            wasme_uart_framer_t* framer = &ctx->uart_framers[i];
+            if (framer->active && framer->handle == drv_handle) {
+                free(framer->frame.buf);
+                framer->frame.buf = NULL;
+                framer->active = false;
+            }
+        }
+        break;
+
+    case WASME_HANDLE_GPIO:
+        for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+            wasme_gpio_irq_t* irq = &ctx->gpio_irqs[i];
+            if (irq->active && irq->handle == drv_handle) {
+                if (ctx->gpio_irq_drv->unsubscribe) {
+                    ctx->gpio_irq_drv->unsubscribe(ctx->gpio_irq_drv_ctx, drv_handle);
+                }
+                irq->active = false;
+            }
+        }
+        break;
+
+    case WASME_HANDLE_SPI:
+        wasme_sampler_drop(ctx, WASME_SAMPLER_BUS_SPI, drv_handle);
+        break;
+
+    case WASME_HANDLE_I2C:
+        wasme_sampler_drop(ctx, WASME_SAMPLER_BUS_I2C, drv_handle);
+        break;
+
+    default:
+        break;
+    }
+
+    wasme_mem_pin_update(ctx);
+}
+
+// Deinit a driver handle, drivers without deinit are skipped
+static int32_t handle_deinit(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t drv_handle) {
+    switch (kind) {
+    case WASME_HANDLE_GPIO:
+        if (ctx->gpio_drv && ctx->gpio_drv->deinit) {
+            return ctx->gpio_drv->deinit(ctx->gpio_drv_ctx, drv_handle);
+        }
+        break;
+    case WASME_HANDLE_SPI:
+        if (ctx->spi_drv && ctx->spi_drv->deinit) {
+            return ctx->spi_drv->deinit(ctx->spi_drv_ctx, drv_handle);
+        }
+        break;
+    case WASME_HANDLE_I2C:
+        if (ctx->i2c_drv && ctx->i2c_drv->deinit) {
+            return ctx->i2c_drv->deinit(ctx->i2c_drv_ctx, drv_handle);
+        }
+        break;
+    case WASME_HANDLE_UART:
+        if (ctx->uart_drv && ctx->uart_drv->deinit) {
+            return ctx->uart_drv->deinit(ctx->uart_drv_ctx, drv_handle);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+int32_t wasme_handle_close(wasme_ctx_t* ctx, wasme_handle_kind_t kind, int32_t handle) {
+    int32_t drv_handle;
+    int32_t res = wasme_handle_get(ctx, kind, handle, &drv_handle);
+    if (res) {
+        return res;
+    }
+
+    handle_stop(ctx, kind, drv_handle);
+    res = handle_deinit(ctx, kind, drv_handle);
+
+    // Released even if the driver fails so the guest cannot reuse it
+    handle_free(ctx, HANDLE_INDEX(handle));
+
+    return res;
+}
+
+void wasme_handles_release(wasme_ctx_t* ctx, uint32_t since) {
+    // Stop drivers streaming into linear memory before handles are closed
+    for (uint32_t i = 0; i < WASME_UART_MAX_STREAMS; i++) {
+        wasme_uart_stream_t* stream = &ctx->uart_streams[i];
+        if (stream->active && ctx->uart_stream_drv->stop) {
+            ctx->uart_stream_drv->stop(ctx->uart_stream_drv_ctx, stream->handle);
+        }
+        stream->active = false;
+    }
+
+    for (uint32_t i = 0; i < WASME_GPIO_MAX_IRQS; i++) {
+        wasme_gpio_irq_t* irq = &ctx->gpio_irqs[i];
+        if (irq->active && ctx->gpio_irq_drv->unsubscribe) {
+            ctx->gpio_irq_drv->unsubscribe(ctx->gpio_irq_drv_ctx, irq->handle);
+        }
+        irq->active = false;
+    }
+
+    wasme_sampler_deinit(ctx);
+    wasme_mem_pin_update(ctx);
+
+    for (uint32_t i = 0; i < WASME_UART_MAX_FRAMERS; i++) {
+        free(ctx->uart_framers[i].frame.buf);
+        ctx->uart_framers[i].frame.buf = NULL;
+        ctx->uart_framers[i].active = false;
+    }
+
+    for (uint32_t i = 0; i < WASME_MAX_HANDLES; i++) {
+        wasme_handle_t* e = &ctx->handles.entries[i];
+        if (e->kind == WASME_HANDLE_FREE || e->seq < since) {
+            continue;
+        }
+
+        handle_deinit(ctx, e->kind, e->drv_handle);
+        handle_free(ctx, i);
+    }
+}
@@ -1,7 +1,6 @@
 
 #include "wasm3.h"
 #include "m3_env.h"
-#include "m3_api_wasi.h"
 #include "m3_env.h"
 #include "m3_exception.h"
 #include "m3_info.h"
@@ -21,11 +20,6 @@
 #define WASME_I2C_DEBUG_PRINTF(...)
 #endif
 
-// Shared I2C driver objects
-// TODO: work out how to bind these to wasm3 context
-static const i2c_drv_t* i2c_drv = NULL;
-static const void* i2c_drv_ctx = NULL;
-
 // I2C debug logging flag
 static bool i2c_debug = false;
 
@@ -44,16 +38,29 @@ m3ApiRawFunction(m3_i2c_init)
 
     WASME_I2C_DEBUG_PRINTF("I2C init port: %d freq: %d sda: %d scl: %d\r\n", dev, baud, sda, scl);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!i2c_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->i2c_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = i2c_drv->init(i2c_drv_ctx, dev, baud, sda, scl);
+    int32_t res = ctx->i2c_drv->init(ctx->i2c_drv_ctx, dev, baud, sda, scl);
 
     if(res >= 0) {
-        *handle = res;
-        WASME_I2C_DEBUG_PRINTF("I2C handle: %d\r\n", res);
+        // Guest receives a table handle in place of the driver handle
+        int32_t h = wasme_handle_alloc(ctx, WASME_HANDLE_I2C, res);
+        if (h < 0) {
+            if (ctx->i2c_drv->deinit) {
+                ctx->i2c_drv->deinit(ctx->i2c_drv_ctx, res);
+            }
+            m3ApiReturn(__WASI_ERRNO_NFILE);
+        }
+        *handle = h;
+        res = h;
+        WASME_I2C_DEBUG_PRINTF("I2C handle: %d\r\n", h);
     }
 
     m3ApiReturn(res);
@@ -67,13 +74,17 @@ m3ApiRawFunction(m3_i2c_deinit)
 
     WASME_I2C_DEBUG_PRINTF("I2C deinit handle: %d\r\n", handle);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!i2c_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
-
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->i2c_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = i2c_drv->deinit(i2c_drv_ctx, handle);
+    // Streams, subscriptions and samplers on the handle are stopped with it
+    int32_t res = wasme_handle_close(ctx, WASME_HANDLE_I2C, handle);
 
     m3ApiReturn(res);
 }
@@ -100,14 +111,24 @@ m3ApiRawFunction(m3_i2c_write)
 
     WASME_I2C_DEBUG_PRINTF("I2C write data: %p len: %d\r\n", data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!i2c_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->i2c_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_I2C, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
     WASME_I2C_DEBUG_PRINTF("I2C write port: %d addr: 0x%x, %d bytes (%p)\r\n", handle, addr, *len, data);
 
-    int32_t res = i2c_drv->write(i2c_drv_ctx, handle, addr, data, *len);
+    int32_t res = ctx->i2c_drv->write(ctx->i2c_drv_ctx, handle, addr, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     m3ApiReturn(res);
 }
@@ -129,12 +150,22 @@ m3ApiRawFunction(m3_i2c_read)
 
     WASME_I2C_DEBUG_PRINTF("I2C read data: %p len: %d\r\n", data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!i2c_drv->read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->i2c_drv->read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = i2c_drv->read(i2c_drv_ctx, handle, addr, data, *len);
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_I2C, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    int32_t res = ctx->i2c_drv->read(ctx->i2c_drv_ctx, handle, addr, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     WASME_I2C_DEBUG_PRINTF("I2C read port: %d addr: 0x%x, %d bytes (%p)\r\n", handle, addr, *len, data);
 
@@ -162,12 +193,22 @@ m3ApiRawFunction(m3_i2c_write_read)
     WASME_I2C_DEBUG_PRINTF("I2C write_read data_out: %p len_out: %d data_in: %p len_in: %d\r\n", 
         data_out, *len_out, data_in, *len_in);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!i2c_drv->write_read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->i2c_drv->write_read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_I2C, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
-    int32_t res = i2c_drv->write_read(i2c_drv_ctx, handle, addr, data_out, *len_out, data_in, *len_in);
+    int32_t res = ctx->i2c_drv->write_read(ctx->i2c_drv_ctx, handle, addr, data_out, *len_out, data_in, *len_in);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     WASME_I2C_DEBUG_PRINTF("I2C write_read port: %d addr: %x, out: %p %d bytes, in: %p %d bytes\r\n", handle, addr, data_out, *len_out, data_in, *len_in);
 
@@ -175,23 +216,126 @@ m3ApiRawFunction(m3_i2c_write_read)
     m3ApiReturn(res);
 }
 
+// Execute a transaction using the I2C driver, which can only express a single
+// write, a single read, or a write followed by a read using write_read so
+// register reads keep their repeated start. Other sequences would need STOPs
+// between operations so are rejected rather than silently split
+static int32_t i2c_txn_fallback(wasme_ctx_t* ctx, int32_t handle, uint16_t addr, const wasme_i2c_xfer_t* ops, uint32_t num_ops) {
+    const i2c_drv_t* drv = ctx->i2c_drv;
+    int32_t res;
+
+    if (num_ops == 0) {
+        return 0;
+    }
+
+    if (num_ops == 1 && ops[0].kind == WASME_I2C_OP_WRITE) {
+        res = drv->write ? drv->write(ctx->i2c_drv_ctx, handle, addr, ops[0].data, ops[0].len) : __WASI_ERRNO_NOENT;
+
+    } else if (num_ops == 1) {
+        res = drv->read ? drv->read(ctx->i2c_drv_ctx, handle, addr, ops[0].data, ops[0].len) : __WASI_ERRNO_NOENT;
+
+    } else if (num_ops == 2 && ops[0].kind == WASME_I2C_OP_WRITE && ops[1].kind == WASME_I2C_OP_READ) {
+        res = drv->write_read ? drv->write_read(ctx->i2c_drv_ctx, handle, addr, ops[0].data, ops[0].len, ops[1].data, ops[1].len) : __WASI_ERRNO_NOTSUP;
+
+    } else {
+        return __WASI_ERRNO_NOTSUP;
+    }
+
+    // Park the task if the driver completes asynchronously
+    return wasme_async_wait(ctx, res);
+}
+
+m3ApiRawFunction(m3_i2c_transaction)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint16_t, addr)
+    m3ApiGetArg      (uint32_t, ops_ptr)
+    m3ApiGetArg      (uint32_t, num_ops)
+
+    WASME_I2C_DEBUG_PRINTF("I2C transaction port: %d addr: 0x%x, ops: 0x%x count: %d\r\n", handle, addr, ops_ptr, num_ops);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (num_ops > WASME_I2C_MAX_OPS) { m3ApiReturn(__WASI_ERRNO_2BIG); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_I2C, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    const wasme_i2c_op_t* guest_ops = (const wasme_i2c_op_t*)wasme_mem_range(runtime, ops_ptr, num_ops * sizeof(wasme_i2c_op_t));
+    if (!guest_ops) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Resolve and bounds check all buffers before touching the bus
+    wasme_i2c_xfer_t ops[WASME_I2C_MAX_OPS];
+    for (uint32_t i = 0; i < num_ops; i++) {
+        const wasme_i2c_op_t* g = &guest_ops[i];
+
+        if (g->kind != WASME_I2C_OP_WRITE && g->kind != WASME_I2C_OP_READ) {
+            m3ApiReturn(__WASI_ERRNO_INVAL);
+        }
+
+        ops[i].kind = (wasme_i2c_op_kind_t)g->kind;
+        ops[i].data = wasme_mem_range(runtime, g->ptr, g->len);
+        ops[i].len = g->len;
+
+        if (!ops[i].data) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    }
+
+    int32_t res;
+    if (ctx->i2c_txn_drv && ctx->i2c_txn_drv->transaction) {
+        res = ctx->i2c_txn_drv->transaction(ctx->i2c_txn_drv_ctx, handle, addr, ops, num_ops);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    } else {
+        res = i2c_txn_fallback(ctx, handle, addr, ops, num_ops);
+    }
+
+    WASME_I2C_DEBUG_PRINTF("I2C transaction port: %d addr: 0x%x, %d ops res: %d\r\n", handle, addr, num_ops, res);
+
+    m3ApiReturn(res);
+}
+
 const static char* wasme_i2c_mod = "i2c";
 
 int32_t WASME_bind_i2c(wasme_ctx_t* ctx, const i2c_drv_t* drv, void* drv_ctx) {
     M3Result m3_res;
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_i2c_mod, "init", "i(iiiii)", &m3_i2c_init);
-    
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_i2c_mod, "deinit", "i(i)", &m3_i2c_deinit);
+    ctx->i2c_drv = drv;
+    ctx->i2c_drv_ctx = drv_ctx;
+    // Set again by WASME_bind_i2c_bus when binding a bus
+    ctx->i2c_bus_client.bus = NULL;
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_i2c_mod, "init", "i(iiiii)", &m3_i2c_init, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_i2c_mod, "write", "i(iii)", &m3_i2c_write);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_i2c_mod, "deinit", "i(i)", &m3_i2c_deinit, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_i2c_mod, "read", "i(iii)", &m3_i2c_read);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_i2c_mod, "write", "i(iii)", &m3_i2c_write, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_i2c_mod, "write_read", "i(iiii)", &m3_i2c_write_read);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_i2c_mod, "read", "i(iii)", &m3_i2c_read, ctx);
     
-    i2c_drv = drv;
-    i2c_drv_ctx = drv_ctx;
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_i2c_mod, "write_read", "i(iiii)", &m3_i2c_write_read, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_i2c_mod, "transaction", "i(iiii)", &m3_i2c_transaction, ctx);
     
     return 0;
 }
+
+int32_t WASME_bind_i2c_txn(wasme_ctx_t* ctx, const wasme_i2c_txn_drv_t* drv, void* drv_ctx) {
+    // Would bypass bus arbitration
+    if (ctx->i2c_bus_client.bus) {
+        return -1;
+    }
+
+    // Used by the transaction function linked in WASME_bind_i2c
+    ctx->i2c_txn_drv = drv;
+    ctx->i2c_txn_drv_ctx = drv_ctx;
+
+    return 0;
+}
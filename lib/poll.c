@@ -0,0 +1,532 @@
+
+#include "wasm3.h"
+#include "m3_env.h"
+#include "m3_exception.h"
+#include "extra/wasi_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wasm_embedded/wasm3/poll.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+// Blocking waits use epoll with an eventfd for driver wakeups and a timerfd for deadlines
+#if defined(__linux__) && !defined(WASME_NO_EPOLL)
+#define WASME_USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#define TAG "WASME_POLL"
+
+#define WASME_DEBUG_POLL
+
+// Debug print helper
+#ifdef WASME_DEBUG_POLL
+#define WASME_POLL_DEBUG_PRINTF(...) if(poll_debug) printf(__VA_ARGS__);
+#else
+#define WASME_POLL_DEBUG_PRINTF(...)
+#endif
+
+static bool poll_debug = false;
+
+// Ring header words shared by UART stream and sampler rings
+#define RING_HEAD 0
+#define RING_TAIL 1
+
+// Per-subscription state while polling
+typedef struct {
+    // Monotonic deadline for clock subscriptions
+    int64_t deadline;
+    uint64_t nbytes;
+    uint16_t error;
+    uint16_t flags;
+    bool ready;
+    // Set on the subscription that registered its descriptor with epoll
+    bool registered;
+} poll_sub_t;
+
+static bool ring_pending(wasme_ctx_t* ctx, uint32_t ring_ptr) {
+    _Atomic uint32_t* hdr = (_Atomic uint32_t*)wasme_mem_range(ctx->rt, ring_ptr, 2 * sizeof(uint32_t));
+    if (!hdr) {
+        return false;
+    }
+
+    return atomic_load_explicit(&hdr[RING_HEAD], memory_order_acquire)
+        != atomic_load_explicit(&hdr[RING_TAIL], memory_order_relaxed);
+}
+
+// Check for data the guest has yet to drain from streams, samplers or the GPIO queue
+static bool poll_events_pending(wasme_ctx_t* ctx) {
+    for (uint32_t i = 0; i < WASME_UART_MAX_STREAMS; i++) {
+        wasme_uart_stream_t* stream = &ctx->uart_streams[i];
+        if (stream->active && ring_pending(ctx, stream->ring_ptr)) {
+            return true;
+        }
+    }
+
+    for (uint32_t i = 0; i < WASME_SAMPLER_MAX; i++) {
+        struct wasme_sampler_s* s = &ctx->samplers[i];
+        if (s->active && ring_pending(ctx, s->cfg.ring_ptr)) {
+            return true;
+        }
+    }
+
+    if (wasme_gpio_pending(ctx)) {
+        return true;
+    }
+
+    return false;
+}
+
+static bool poll_is_fd(const __wasi_subscription_t* sub) {
+    return sub->u.tag == __WASI_EVENTTYPE_FD_READ || sub->u.tag == __WASI_EVENTTYPE_FD_WRITE;
+}
+
+// Descriptor polled by an fd subscription, read and write share the union layout
+static __wasi_fd_t poll_fd(const __wasi_subscription_t* sub) {
+    return sub->u.u.fd_read.file_descriptor;
+}
+
+static bool poll_is_host_fd(const __wasi_subscription_t* sub) {
+    return poll_is_fd(sub) && poll_fd(sub) != WASME_POLL_EVENT_FD;
+}
+
+// Mark expired clocks and pending driver events ready, returning the number of ready subscriptions
+static uint32_t poll_check(wasme_ctx_t* ctx, const __wasi_subscription_t* subs, poll_sub_t* st, uint32_t n) {
+    int64_t now = wasme_clock_monotonic(ctx);
+    bool pending = false;
+    bool pending_checked = false;
+    uint32_t ready = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (!st[i].ready && !st[i].error) {
+            if (subs[i].u.tag == __WASI_EVENTTYPE_CLOCK) {
+                st[i].ready = now >= st[i].deadline;
+
+            } else if (subs[i].u.tag == __WASI_EVENTTYPE_FD_READ && poll_fd(&subs[i]) == WASME_POLL_EVENT_FD) {
+                if (!pending_checked) {
+                    pending = poll_events_pending(ctx);
+                    pending_checked = true;
+                }
+                st[i].ready = pending;
+            }
+        }
+
+        if (st[i].ready || st[i].error) {
+            ready += 1;
+        }
+    }
+
+    return ready;
+}
+
+// Earliest clock deadline, INT64_MAX if there is none
+static int64_t poll_deadline(const __wasi_subscription_t* subs, const poll_sub_t* st, uint32_t n) {
+    int64_t deadline = INT64_MAX;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (subs[i].u.tag == __WASI_EVENTTYPE_CLOCK && !st[i].error && st[i].deadline < deadline) {
+            deadline = st[i].deadline;
+        }
+    }
+
+    return deadline;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Bytes available to read, zero where the descriptor cannot report it
+static uint64_t poll_nbytes(int fd) {
+    int avail = 0;
+    if (ioctl(fd, FIONREAD, &avail) != 0 || avail < 0) {
+        return 0;
+    }
+    return (uint64_t)avail;
+}
+#endif
+
+#ifdef WASME_USE_EPOLL
+
+// epoll keys for the context's own descriptors, guest descriptors use their number
+#define POLL_KEY_EVENT ((uint64_t)1 << 32)
+#define POLL_KEY_TIMER ((uint64_t)2 << 32)
+
+static int32_t poll_errno(int err) {
+    switch (err) {
+    case EBADF: return __WASI_ERRNO_BADF;
+    case EMFILE:
+    case ENFILE: return __WASI_ERRNO_NFILE;
+    case ENOMEM: return __WASI_ERRNO_NOMEM;
+    default: return __WASI_ERRNO_IO;
+    }
+}
+
+// Create the epoll set with the wakeup and timer descriptors permanently registered
+static int32_t poll_setup(wasme_ctx_t* ctx) {
+    if (ctx->poll_init) {
+        return 0;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int err = errno;
+
+    if (epfd >= 0 && evfd >= 0 && tfd >= 0) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = POLL_KEY_EVENT };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &ev) == 0) {
+            ev.data.u64 = POLL_KEY_TIMER;
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) == 0) {
+                ctx->poll_epfd = epfd;
+                ctx->poll_evfd = evfd;
+                ctx->poll_tfd = tfd;
+                ctx->poll_init = true;
+
+                return 0;
+            }
+        }
+        err = errno;
+    }
+
+    if (epfd >= 0) close(epfd);
+    if (evfd >= 0) close(evfd);
+    if (tfd >= 0) close(tfd);
+
+    return poll_errno(err);
+}
+
+// Arm the timer relative to now, the hook clock may not match CLOCK_MONOTONIC
+static void poll_arm(wasme_ctx_t* ctx, int64_t deadline) {
+    struct itimerspec its = { 0 };
+
+    if (deadline != INT64_MAX) {
+        int64_t remaining = deadline - wasme_clock_monotonic(ctx);
+        // A zero value disarms the timer, expired deadlines fire after 1ns
+        if (remaining < 1) {
+            remaining = 1;
+        }
+        its.it_value.tv_sec = remaining / 1000000000;
+        its.it_value.tv_nsec = remaining % 1000000000;
+    }
+
+    timerfd_settime(ctx->poll_tfd, 0, &its, NULL);
+}
+
+// Register host descriptors, merging read and write interest on the same descriptor
+static void poll_register(wasme_ctx_t* ctx, const __wasi_subscription_t* subs, poll_sub_t* st, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (!poll_is_host_fd(&subs[i]) || st[i].error || st[i].ready) {
+            continue;
+        }
+
+        __wasi_fd_t fd = poll_fd(&subs[i]);
+        uint32_t events = 0;
+        bool first = true;
+
+        for (uint32_t j = 0; j < n; j++) {
+            if (!poll_is_host_fd(&subs[j]) || poll_fd(&subs[j]) != fd) {
+                continue;
+            }
+            if (j < i) {
+                first = false;
+                break;
+            }
+            events |= subs[j].u.tag == __WASI_EVENTTYPE_FD_READ ? EPOLLIN : EPOLLOUT;
+        }
+
+        if (!first) {
+            continue;
+        }
+
+        struct epoll_event ev = { .events = events, .data.u64 = fd };
+        if (epoll_ctl(ctx->poll_epfd, EPOLL_CTL_ADD, (int)fd, &ev) == 0) {
+            st[i].registered = true;
+            continue;
+        }
+
+        // Regular files are not pollable and never block
+        int err = errno;
+        for (uint32_t j = i; j < n; j++) {
+            if (poll_is_host_fd(&subs[j]) && poll_fd(&subs[j]) == fd) {
+                if (err == EPERM) {
+                    st[j].ready = true;
+                } else {
+                    st[j].error = poll_errno(err);
+                }
+            }
+        }
+    }
+}
+
+static void poll_unregister(wasme_ctx_t* ctx, const __wasi_subscription_t* subs, poll_sub_t* st, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (st[i].registered) {
+            epoll_ctl(ctx->poll_epfd, EPOLL_CTL_DEL, (int)poll_fd(&subs[i]), NULL);
+        }
+    }
+}
+
+// Record readiness reported for a host descriptor
+static void poll_mark(const __wasi_subscription_t* subs, poll_sub_t* st, uint32_t n, __wasi_fd_t fd, uint32_t events) {
+    bool hangup = events & (EPOLLHUP | EPOLLRDHUP);
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (!poll_is_host_fd(&subs[i]) || poll_fd(&subs[i]) != fd || st[i].error) {
+            continue;
+        }
+
+        uint32_t want = subs[i].u.tag == __WASI_EVENTTYPE_FD_READ ? EPOLLIN : EPOLLOUT;
+        if (events & (want | EPOLLHUP | EPOLLERR)) {
+            st[i].ready = true;
+            st[i].nbytes = want == EPOLLIN ? poll_nbytes((int)fd) : 0;
+            if (hangup) {
+                st[i].flags |= __WASI_EVENTRWFLAGS_FD_READWRITE_HANGUP;
+            }
+        }
+    }
+}
+
+static int32_t poll_wait(wasme_ctx_t* ctx, const __wasi_subscription_t* subs, poll_sub_t* st, uint32_t n) {
+    int32_t res = poll_setup(ctx);
+    if (res) {
+        return res;
+    }
+
+    poll_register(ctx, subs, st, n);
+
+    int64_t deadline = poll_deadline(subs, st, n);
+    struct epoll_event evs[WASME_POLL_MAX_SUBS + 2];
+
+    // Producers signal the event descriptor while this is set, so the
+    // pending check below cannot miss an event pushed before the wait
+    atomic_store(&ctx->poll_waiting, true);
+
+    while (true) {
+        uint32_t ready = poll_check(ctx, subs, st, n);
+
+        // Collect descriptor readiness without blocking once anything is ready
+        int timeout = ready ? 0 : -1;
+        if (!ready) {
+            poll_arm(ctx, deadline);
+        }
+
+        int num = epoll_wait(ctx->poll_epfd, evs, WASME_POLL_MAX_SUBS + 2, timeout);
+        if (num < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            res = poll_errno(errno);
+            break;
+        }
+
+        for (int i = 0; i < num; i++) {
+            uint64_t count;
+            if (evs[i].data.u64 == POLL_KEY_EVENT) {
+                (void)!read(ctx->poll_evfd, &count, sizeof(count));
+            } else if (evs[i].data.u64 == POLL_KEY_TIMER) {
+                (void)!read(ctx->poll_tfd, &count, sizeof(count));
+            } else {
+                poll_mark(subs, st, n, (__wasi_fd_t)evs[i].data.u64, evs[i].events);
+            }
+        }
+
+        // Wakeups may be spurious, a drained ring or an early timer
+        if (ready || poll_check(ctx, subs, st, n)) {
+            break;
+        }
+    }
+
+    atomic_store(&ctx->poll_waiting, false);
+
+    poll_arm(ctx, INT64_MAX);
+    poll_unregister(ctx, subs, st, n);
+
+    return res;
+}
+
+void wasme_poll_signal(wasme_ctx_t* ctx) {
+    uint64_t one = 1;
+
+    if (ctx->poll_init) {
+        (void)!write(ctx->poll_evfd, &one, sizeof(one));
+    }
+}
+
+void wasme_poll_deinit(wasme_ctx_t* ctx) {
+    if (!ctx->poll_init) {
+        return;
+    }
+
+    close(ctx->poll_tfd);
+    close(ctx->poll_evfd);
+    close(ctx->poll_epfd);
+    ctx->poll_init = false;
+}
+
+#else
+
+// Host descriptors cannot be waited on, they are reported ready and reads may block
+static int32_t poll_wait(wasme_ctx_t* ctx, const __wasi_subscription_t* subs, poll_sub_t* st, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (poll_is_host_fd(&subs[i])) {
+            st[i].ready = true;
+        }
+    }
+
+    int64_t deadline = poll_deadline(subs, st, n);
+
+    while (!poll_check(ctx, subs, st, n)) {
+#if defined(__unix__) || defined(__APPLE__)
+        // Sleep in short steps so driver events are seen promptly
+        int64_t step = 1000000;
+        if (deadline != INT64_MAX && deadline - wasme_clock_monotonic(ctx) < step) {
+            step = deadline - wasme_clock_monotonic(ctx);
+        }
+        if (step > 0) {
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = step };
+            nanosleep(&ts, NULL);
+        }
+#else
+        (void)deadline;
+#endif
+    }
+
+    return 0;
+}
+
+void wasme_poll_signal(wasme_ctx_t* ctx) {
+    (void)ctx;
+}
+
+void wasme_poll_deinit(wasme_ctx_t* ctx) {
+    (void)ctx;
+}
+
+#endif
+
+m3ApiRawFunction(m3_wasi_poll_oneoff)
+{
+    // Load arguments
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (uint32_t, in_ptr)
+    m3ApiGetArg      (uint32_t, out_ptr)
+    m3ApiGetArg      (uint32_t, nsubscriptions)
+    m3ApiGetArg      (uint32_t, nevents_ptr)
+
+    WASME_POLL_DEBUG_PRINTF("WASI poll_oneoff subscriptions: %u\r\n", nsubscriptions);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (nsubscriptions == 0) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+    if (nsubscriptions > WASME_POLL_MAX_SUBS) { m3ApiReturn(__WASI_ERRNO_2BIG); }
+
+    const uint8_t* in = wasme_mem_range(runtime, in_ptr, nsubscriptions * sizeof(__wasi_subscription_t));
+    uint8_t* out = wasme_mem_range(runtime, out_ptr, nsubscriptions * sizeof(__wasi_event_t));
+    uint8_t* nevents = wasme_mem_range(runtime, nevents_ptr, sizeof(uint32_t));
+    if (!in || !out || !nevents) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Copied out as guest memory may be unaligned and the guest may be running on another thread
+    __wasi_subscription_t subs[WASME_POLL_MAX_SUBS];
+    poll_sub_t st[WASME_POLL_MAX_SUBS];
+    memcpy(subs, in, nsubscriptions * sizeof(__wasi_subscription_t));
+    memset(st, 0, sizeof(st));
+
+    int64_t now = wasme_clock_monotonic(ctx);
+
+    for (uint32_t i = 0; i < nsubscriptions; i++) {
+        switch (subs[i].u.tag) {
+        case __WASI_EVENTTYPE_CLOCK: {
+            const __wasi_subscription_clock_t* clk = &subs[i].u.u.clock;
+            uint64_t timeout = clk->timeout;
+
+            // Absolute timeouts are converted against the subscribed clock
+            if (clk->flags & __WASI_SUBCLOCKFLAGS_SUBSCRIPTION_CLOCK_ABSTIME) {
+                uint64_t clk_now;
+                uint32_t err = m3_wasi_clock_time_get(&ctx->wasi, clk->id, &clk_now);
+                if (err) {
+                    st[i].error = err;
+                    break;
+                }
+                timeout = timeout > clk_now ? timeout - clk_now : 0;
+            }
+
+            st[i].deadline = timeout < (uint64_t)(INT64_MAX - now) ? now + (int64_t)timeout : INT64_MAX;
+            break;
+        }
+
+        case __WASI_EVENTTYPE_FD_READ:
+        case __WASI_EVENTTYPE_FD_WRITE:
+            if (subs[i].u.tag == __WASI_EVENTTYPE_FD_WRITE && poll_fd(&subs[i]) == WASME_POLL_EVENT_FD) {
+                st[i].error = __WASI_ERRNO_INVAL;
+            }
+            // VFS files are in memory so never block, and their fds are not host descriptors
+            if (poll_is_host_fd(&subs[i]) && wasme_vfs_owns(ctx->vfs, poll_fd(&subs[i]))) {
+                st[i].ready = true;
+            }
+            break;
+
+        default:
+            st[i].error = __WASI_ERRNO_INVAL;
+            break;
+        }
+    }
+
+    int32_t res = poll_wait(ctx, subs, st, nsubscriptions);
+    if (res) {
+        m3ApiReturn(res);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < nsubscriptions; i++) {
+        if (!st[i].ready && !st[i].error) {
+            continue;
+        }
+
+        __wasi_event_t ev = {
+            .userdata = subs[i].userdata,
+            .error = st[i].error,
+            .type = subs[i].u.tag,
+        };
+        if (poll_is_fd(&subs[i])) {
+            ev.fd_readwrite.nbytes = st[i].nbytes;
+            ev.fd_readwrite.flags = st[i].flags;
+        }
+
+        memcpy(out + count * sizeof(__wasi_event_t), &ev, sizeof(ev));
+        count += 1;
+    }
+
+    memcpy(nevents, &count, sizeof(count));
+
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+int32_t wasme_poll_link(wasme_ctx_t* ctx) {
+    static const char* namespaces[2] = { "wasi_unstable", "wasi_snapshot_preview1" };
+
+    for (int i = 0; i < 2; i++) {
+        M3Result m3_res = m3_LinkRawFunctionEx(ctx->mod, namespaces[i], "poll_oneoff", "i(**i*)", &m3_wasi_poll_oneoff, ctx);
+
+        // Modules that do not import poll_oneoff are fine
+        if (m3_res && m3_res != m3Err_functionLookupFailed) {
+            printf("Poll binding failed: %s\r\n", m3_res);
+
+            return -1;
+        }
+    }
+
+    return 0;
+}
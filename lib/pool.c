@@ -0,0 +1,205 @@
+#include "wasm_embedded/wasm3/pool.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WASME_USE_THREADS
+#include <pthread.h>
+#endif
+
+typedef struct {
+    // NULL when the entry could not be rebuilt
+    wasme_ctx_t* ctx;
+    // Set while acquired, guards against foreign and double releases
+    bool in_use;
+} pool_entry_t;
+
+struct wasme_pool_s {
+    // Module and setup used to rebuild entries that fail to reset
+    wasme_module_t* module;
+    uint32_t mem_limit;
+    wasme_pool_setup_f setup;
+    void* setup_arg;
+    // All entries owned by the pool
+    pool_entry_t* entries;
+    uint32_t size;
+    // Stack of free entry indices
+    uint32_t* free;
+    uint32_t free_count;
+
+#ifdef WASME_USE_THREADS
+    // Guards the free stack and in_use flags, contexts are reset outside it
+    pthread_mutex_t lock;
+#endif
+};
+
+static void pool_lock(wasme_pool_t* pool) {
+#ifdef WASME_USE_THREADS
+    pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static void pool_unlock(wasme_pool_t* pool) {
+#ifdef WASME_USE_THREADS
+    pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+// Instantiate, setup and snapshot the context for an entry
+static int pool_entry_build(wasme_pool_t* pool, uint32_t index) {
+    pool_entry_t* e = &pool->entries[index];
+
+    e->ctx = WASME_instantiate(pool->module, pool->mem_limit);
+    if (!e->ctx) {
+        return -1;
+    }
+
+    if (pool->setup && pool->setup(e->ctx, pool->setup_arg) < 0) {
+        printf("Pool setup %d failed\r\n", index);
+        WASME_deinit(&e->ctx);
+        return -1;
+    }
+
+    // Capture post-setup state for resets
+    if (WASME_snapshot(e->ctx) < 0) {
+        WASME_deinit(&e->ctx);
+        return -1;
+    }
+
+    return 0;
+}
+
+wasme_pool_t* WASME_pool_init(wasme_module_t* module, uint32_t mem_limit, uint32_t size,
+        wasme_pool_setup_f setup, void* setup_arg) {
+
+    wasme_pool_t* pool = malloc(sizeof(wasme_pool_t));
+    if (!pool) {
+        printf("Allocating wasme_pool_t failed\r\n");
+        return NULL;
+    }
+    memset(pool, 0, sizeof(wasme_pool_t));
+
+#ifdef WASME_USE_THREADS
+    pthread_mutex_init(&pool->lock, NULL);
+#endif
+
+    pool->module = module;
+    pool->mem_limit = mem_limit;
+    pool->setup = setup;
+    pool->setup_arg = setup_arg;
+
+    pool->entries = calloc(size, sizeof(pool_entry_t));
+    pool->free = calloc(size, sizeof(uint32_t));
+    if (!pool->entries || !pool->free) {
+        printf("Allocating pool entries failed\r\n");
+        goto teardown_pool;
+    }
+
+    for (uint32_t i = 0; i < size; i++) {
+        pool->size += 1;
+
+        if (pool_entry_build(pool, i) < 0) {
+            goto teardown_pool;
+        }
+
+        pool->free[pool->free_count++] = i;
+    }
+
+    return pool;
+
+teardown_pool:
+    WASME_pool_deinit(&pool);
+
+    return NULL;
+}
+
+wasme_ctx_t* WASME_pool_acquire(wasme_pool_t* pool) {
+    pool_lock(pool);
+
+    if (pool->free_count == 0) {
+        pool_unlock(pool);
+        return NULL;
+    }
+
+    pool_entry_t* e = &pool->entries[pool->free[--pool->free_count]];
+    e->in_use = true;
+
+    pool_unlock(pool);
+
+    return e->ctx;
+}
+
+int WASME_pool_release(wasme_pool_t* pool, wasme_ctx_t* ctx) {
+    pool_lock(pool);
+
+    uint32_t index = 0;
+    while (index < pool->size && (!ctx || pool->entries[index].ctx != ctx)) {
+        index++;
+    }
+
+    // Only contexts currently acquired from this pool may be released
+    if (index == pool->size || !pool->entries[index].in_use) {
+        pool_unlock(pool);
+        printf("Pool release of a context not acquired from the pool\r\n");
+        return -1;
+    }
+
+    // Claim the release so a concurrent release of the same context fails,
+    // the entry is in neither state until it is back on the free stack
+    pool_entry_t* e = &pool->entries[index];
+    e->in_use = false;
+
+    pool_unlock(pool);
+
+    int res = WASME_reset(ctx);
+
+    pool_lock(pool);
+
+    if (res < 0) {
+        // The context state is unknown, replace it so the pool keeps its size.
+        // Rebuilt under the lock as releases compare against entry contexts.
+        printf("Pool reset failed: %d, rebuilding entry %d\r\n", res, index);
+
+        WASME_deinit(&e->ctx);
+
+        if (pool_entry_build(pool, index) < 0) {
+            // Left out of the free stack, the pool is one context smaller
+            pool_unlock(pool);
+            printf("Pool rebuild of entry %d failed\r\n", index);
+            return -2;
+        }
+    }
+
+    pool->free[pool->free_count++] = index;
+
+    pool_unlock(pool);
+
+    return 0;
+}
+
+void WASME_pool_deinit(wasme_pool_t** pool) {
+    if (!*pool) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < (*pool)->size; i++) {
+        WASME_deinit(&(*pool)->entries[i].ctx);
+    }
+
+    if ((*pool)->entries) {
+        free((*pool)->entries);
+    }
+    if ((*pool)->free) {
+        free((*pool)->free);
+    }
+
+#ifdef WASME_USE_THREADS
+    pthread_mutex_destroy(&(*pool)->lock);
+#endif
+
+    free(*pool);
+
+    *pool = NULL;
+}
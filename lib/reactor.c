@@ -0,0 +1,166 @@
+
+#include "wasm_embedded/wasm3/reactor.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "wasm3.h"
+
+struct wasme_reactor_s {
+    wasme_ctx_t* ctx;
+
+    // Resolved handlers
+    IM3Function handlers[WASME_REACTOR_MAX_HANDLERS];
+    uint32_t num_handlers;
+
+    // Single producer / single consumer event queue
+    wasme_event_t* queue;
+    uint32_t queue_mask;
+    atomic_uint head;
+    atomic_uint tail;
+};
+
+wasme_reactor_t* WASME_reactor_init(wasme_ctx_t* ctx, uint32_t queue_len) {
+    if (queue_len == 0 || (queue_len & (queue_len - 1)) != 0) {
+        wasme_console_printf(ctx, "Reactor queue length must be a power of two\r\n");
+        return NULL;
+    }
+
+    wasme_reactor_t* reactor = malloc(sizeof(wasme_reactor_t));
+    if (!reactor) {
+        wasme_console_printf(ctx, "Allocating wasme_reactor_t failed\r\n");
+        return NULL;
+    }
+    memset(reactor, 0, sizeof(wasme_reactor_t));
+
+    reactor->ctx = ctx;
+    reactor->queue_mask = queue_len - 1;
+    atomic_init(&reactor->head, 0);
+    atomic_init(&reactor->tail, 0);
+
+    reactor->queue = calloc(queue_len, sizeof(wasme_event_t));
+    if (!reactor->queue) {
+        wasme_console_printf(ctx, "Allocating reactor queue failed\r\n");
+        free(reactor);
+        return NULL;
+    }
+
+    // Initialise module once, snapshotting the result for later resets
+    if (WASME_initialize(ctx) < 0) {
+        free(reactor->queue);
+        free(reactor);
+        return NULL;
+    }
+
+    return reactor;
+}
+
+int32_t WASME_reactor_handler(wasme_reactor_t* reactor, const char* name) {
+    IM3Function f;
+
+    if (reactor->num_handlers >= WASME_REACTOR_MAX_HANDLERS) {
+        return -1;
+    }
+
+    M3Result m3_res = m3_FindFunction(&f, reactor->ctx->rt, name);
+    if (m3_res) {
+        wasme_console_printf(reactor->ctx, "FindFunction %s failed: %s\r\n", name, m3_res);
+        return -2;
+    }
+
+    // Check handler signature is i32 (i32, i32, i64)
+    if (m3_GetArgCount(f) != 3 || m3_GetRetCount(f) != 1
+            || m3_GetArgType(f, 0) != c_m3Type_i32
+            || m3_GetArgType(f, 1) != c_m3Type_i32
+            || m3_GetArgType(f, 2) != c_m3Type_i64
+            || m3_GetRetType(f, 0) != c_m3Type_i32) {
+        wasme_console_printf(reactor->ctx, "Handler %s has invalid signature\r\n", name);
+        return -3;
+    }
+
+    reactor->handlers[reactor->num_handlers] = f;
+
+    return reactor->num_handlers++;
+}
+
+int WASME_reactor_post(wasme_reactor_t* reactor, const wasme_event_t* event) {
+    uint32_t head = atomic_load_explicit(&reactor->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&reactor->tail, memory_order_acquire);
+
+    if (head - tail > reactor->queue_mask) {
+        return -1;
+    }
+
+    reactor->queue[head & reactor->queue_mask] = *event;
+    atomic_store_explicit(&reactor->head, head + 1, memory_order_release);
+
+    return 0;
+}
+
+int WASME_reactor_call(wasme_reactor_t* reactor, const wasme_event_t* event, int32_t* result) {
+    if (event->handler >= reactor->num_handlers) {
+        return -1;
+    }
+
+    const wasme_val_t args[3] = {
+        { .type = WASME_TYPE_I32, .of.i32 = event->source },
+        { .type = WASME_TYPE_I32, .of.i32 = event->value },
+        { .type = WASME_TYPE_I64, .of.i64 = event->timestamp },
+    };
+    wasme_val_t ret;
+
+    // Executed as a call so handlers are metered and may park on async drivers
+    int res = WASME_call(reactor->ctx, (wasme_func_t*)reactor->handlers[event->handler], args, 3, &ret, 1);
+    if (res < 0) {
+        wasme_console_printf(reactor->ctx, "Handler %d failed: %d\r\n", event->handler, res);
+        return res;
+    }
+
+    if (res == 0) {
+        *result = ret.of.i32;
+    }
+
+    return res;
+}
+
+int WASME_reactor_dispatch(wasme_reactor_t* reactor, uint32_t max) {
+    uint32_t tail = atomic_load_explicit(&reactor->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&reactor->head, memory_order_acquire);
+    int32_t result;
+    uint32_t n = 0;
+
+    // Events wait in the queue while a handler is suspended
+    while (tail != head && n < max && !reactor->ctx->exec.suspended) {
+        const wasme_event_t* event = &reactor->queue[tail & reactor->queue_mask];
+
+        int res = WASME_reactor_call(reactor, event, &result);
+
+        // Release the slot before handling errors so a trapped event is dropped
+        atomic_store_explicit(&reactor->tail, ++tail, memory_order_release);
+
+        if (res < 0) {
+            return res;
+        }
+
+        n++;
+    }
+
+    return n;
+}
+
+void WASME_reactor_deinit(wasme_reactor_t** reactor) {
+    if (!*reactor) {
+        return;
+    }
+
+    if ((*reactor)->queue) {
+        free((*reactor)->queue);
+    }
+
+    free(*reactor);
+
+    *reactor = NULL;
+}
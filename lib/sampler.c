@@ -0,0 +1,448 @@
+
+#include "wasm3.h"
+#include "m3_env.h"
+#include "m3_exception.h"
+#include "extra/wasi_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wasm_embedded/wasm3/sampler.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+// Sampler threads wait on a condition variable using the monotonic clock
+#if defined(WASME_USE_THREADS) && defined(__linux__)
+#define WASME_SAMPLER_THREAD
+#include <pthread.h>
+#endif
+
+#define TAG "WASME_SAMPLER"
+
+#define WASME_DEBUG_SAMPLER
+
+// Debug print helper
+#ifdef WASME_DEBUG_SAMPLER
+#define WASME_SAMPLER_DEBUG_PRINTF(...) if(sampler_debug) printf(__VA_ARGS__);
+#else
+#define WASME_SAMPLER_DEBUG_PRINTF(...)
+#endif
+
+// Sampler debug logging flag
+static bool sampler_debug = false;
+
+// Header words of a sample ring in guest memory
+#define RING_HEAD 0
+#define RING_TAIL 1
+#define RING_SIZE 2
+#define RING_DROPPED 3
+
+struct wasme_sampler_host_s {
+#ifdef WASME_SAMPLER_THREAD
+    pthread_t thread;
+    // Protects sampler slots, held by the thread while executing samples
+    pthread_mutex_t lock;
+    // Signalled when samplers change or on shutdown
+    pthread_cond_t cond;
+    bool running;
+#endif
+};
+
+static void sampler_lock(wasme_ctx_t* ctx) {
+#ifdef WASME_SAMPLER_THREAD
+    if (ctx->sampler_host) {
+        pthread_mutex_lock(&ctx->sampler_host->lock);
+    }
+#endif
+}
+
+static void sampler_unlock(wasme_ctx_t* ctx) {
+#ifdef WASME_SAMPLER_THREAD
+    if (ctx->sampler_host) {
+        pthread_mutex_unlock(&ctx->sampler_host->lock);
+    }
+#endif
+}
+
+// Total ring space taken by one sample
+static uint32_t sampler_record_len(const wasme_sampler_cfg_t* cfg) {
+    return WASME_SAMPLER_SAMPLE_HDR + ((cfg->len + 3) & ~3u);
+}
+
+// Resolve the ring header, NULL if memory no longer covers the ring
+static _Atomic uint32_t* sampler_ring_hdr(wasme_ctx_t* ctx, struct wasme_sampler_s* s) {
+    return (_Atomic uint32_t*)wasme_mem_range(ctx->rt, s->cfg.ring_ptr, WASME_SAMPLER_RING_HDR + s->size);
+}
+
+// Store a whole sample record in the ring, or count it as dropped
+static void sampler_push(wasme_ctx_t* ctx, struct wasme_sampler_s* s, const uint8_t* rec, uint32_t rec_len) {
+    _Atomic uint32_t* hdr = sampler_ring_hdr(ctx, s);
+    if (!hdr) {
+        return;
+    }
+    uint8_t* ring = (uint8_t*)hdr + WASME_SAMPLER_RING_HDR;
+
+    if (!wasme_ring_push(hdr, ring, s->size, rec, rec_len, true)) {
+        atomic_fetch_add_explicit(&hdr[RING_DROPPED], 1, memory_order_relaxed);
+        return;
+    }
+
+    // Wake a waiting guest, the exchange ensures only one side completes the wait
+    if (atomic_exchange(&s->waiting, false)) {
+        WASME_async_complete(ctx, 0);
+    }
+    wasme_poll_notify(ctx);
+}
+
+// Execute one sample transaction and store the result
+static void sampler_sample(wasme_ctx_t* ctx, struct wasme_sampler_s* s, int64_t now) {
+    uint8_t rec[WASME_SAMPLER_SAMPLE_HDR + WASME_SAMPLER_MAX_LEN + 4] = { 0 };
+    uint8_t* data = rec + WASME_SAMPLER_SAMPLE_HDR;
+    const wasme_sampler_cfg_t* cfg = &s->cfg;
+    int32_t res;
+
+    if (cfg->bus == WASME_SAMPLER_BUS_I2C) {
+        uint8_t reg = (uint8_t)cfg->reg;
+        res = ctx->i2c_drv->write_read(ctx->i2c_drv_ctx, cfg->handle, (uint16_t)cfg->addr, &reg, 1, data, cfg->len);
+
+    } else {
+        // Register byte is clocked out first, data is clocked in after it
+        uint8_t tx[WASME_SAMPLER_MAX_LEN + 1] = { 0 };
+        uint8_t rx[WASME_SAMPLER_MAX_LEN + 1];
+        tx[0] = (uint8_t)cfg->reg;
+
+        res = ctx->spi_drv->transfer(ctx->spi_drv_ctx, cfg->handle, rx, tx, cfg->len + 1);
+        memcpy(data, rx + 1, cfg->len);
+    }
+
+    int64_t ts = now;
+    uint32_t len = cfg->len;
+    memcpy(rec, &ts, sizeof(ts));
+    memcpy(rec + 8, &res, sizeof(res));
+    memcpy(rec + 12, &len, sizeof(len));
+
+    sampler_push(ctx, s, rec, sampler_record_len(cfg));
+}
+
+// Execute due samplers with the lock held, returning the next due time
+static int64_t sampler_run(wasme_ctx_t* ctx, int64_t now) {
+    int64_t next = INT64_MAX;
+
+    for (uint32_t i = 0; i < WASME_SAMPLER_MAX; i++) {
+        struct wasme_sampler_s* s = &ctx->samplers[i];
+        if (!s->active) {
+            continue;
+        }
+
+        if (s->next_ns <= now) {
+            sampler_sample(ctx, s, now);
+
+            // Overrun periods are skipped rather than sampled late in a burst
+            int64_t missed = (now - s->next_ns) / s->period_ns + 1;
+            s->next_ns += missed * s->period_ns;
+        }
+
+        if (s->next_ns < next) {
+            next = s->next_ns;
+        }
+    }
+
+    return next;
+}
+
+int64_t WASME_sampler_tick(wasme_ctx_t* ctx, int64_t now_ns) {
+    sampler_lock(ctx);
+    int64_t next = sampler_run(ctx, now_ns);
+    sampler_unlock(ctx);
+
+    return next;
+}
+
+#ifdef WASME_SAMPLER_THREAD
+static void* sampler_thread(void* arg) {
+    wasme_ctx_t* ctx = (wasme_ctx_t*)arg;
+    wasme_sampler_host_t* host = ctx->sampler_host;
+
+    pthread_mutex_lock(&host->lock);
+
+    while (host->running) {
+        int64_t next = sampler_run(ctx, wasme_clock_monotonic(ctx));
+
+        if (next == INT64_MAX) {
+            pthread_cond_wait(&host->cond, &host->lock);
+        } else {
+            // Deadlines are CLOCK_MONOTONIC, as should be any clock hook set on linux
+            struct timespec ts = {
+                .tv_sec = next / 1000000000,
+                .tv_nsec = next % 1000000000,
+            };
+            pthread_cond_timedwait(&host->cond, &host->lock, &ts);
+        }
+    }
+
+    pthread_mutex_unlock(&host->lock);
+
+    return NULL;
+}
+#endif
+
+// Start the timer thread on first use, hosts without threads call WASME_sampler_tick
+static int32_t sampler_host_start(wasme_ctx_t* ctx) {
+#ifdef WASME_SAMPLER_THREAD
+    if (ctx->sampler_host) {
+        return 0;
+    }
+
+    wasme_sampler_host_t* host = calloc(1, sizeof(wasme_sampler_host_t));
+    if (!host) {
+        return __WASI_ERRNO_NOMEM;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&host->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&host->lock, NULL);
+    host->running = true;
+
+    ctx->sampler_host = host;
+
+    if (pthread_create(&host->thread, NULL, sampler_thread, ctx) != 0) {
+        ctx->sampler_host = NULL;
+        pthread_cond_destroy(&host->cond);
+        pthread_mutex_destroy(&host->lock);
+        free(host);
+        return __WASI_ERRNO_AGAIN;
+    }
+#endif
+
+    return 0;
+}
+
+static void sampler_host_wake(wasme_ctx_t* ctx) {
+#ifdef WASME_SAMPLER_THREAD
+    if (ctx->sampler_host) {
+        pthread_cond_signal(&ctx->sampler_host->cond);
+    }
+#endif
+}
+
+void wasme_sampler_drop(wasme_ctx_t* ctx, uint32_t bus, int32_t drv_handle) {
+    sampler_lock(ctx);
+    for (uint32_t i = 0; i < WASME_SAMPLER_MAX; i++) {
+        struct wasme_sampler_s* s = &ctx->samplers[i];
+        if (s->active && s->cfg.bus == bus && s->cfg.handle == drv_handle) {
+            s->active = false;
+        }
+    }
+    sampler_unlock(ctx);
+}
+
+void wasme_sampler_deinit(wasme_ctx_t* ctx) {
+    sampler_lock(ctx);
+    for (uint32_t i = 0; i < WASME_SAMPLER_MAX; i++) {
+        ctx->samplers[i].active = false;
+    }
+    sampler_unlock(ctx);
+
+#ifdef WASME_SAMPLER_THREAD
+    wasme_sampler_host_t* host = ctx->sampler_host;
+    if (!host) {
+        return;
+    }
+
+    pthread_mutex_lock(&host->lock);
+    host->running = false;
+    pthread_cond_signal(&host->cond);
+    pthread_mutex_unlock(&host->lock);
+
+    pthread_join(host->thread, NULL);
+
+    pthread_cond_destroy(&host->cond);
+    pthread_mutex_destroy(&host->lock);
+    free(host);
+
+    ctx->sampler_host = NULL;
+#endif
+}
+
+m3ApiRawFunction(m3_sampler_start)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (uint32_t, cfg_ptr)
+    m3ApiGetArg      (uint32_t, id_ptr)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    const uint8_t* cfg_mem = wasme_mem_range(runtime, cfg_ptr, sizeof(wasme_sampler_cfg_t));
+    uint8_t* id_mem = wasme_mem_range(runtime, id_ptr, sizeof(uint32_t));
+    if (!cfg_mem || !id_mem) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    wasme_sampler_cfg_t cfg;
+    memcpy(&cfg, cfg_mem, sizeof(cfg));
+
+    WASME_SAMPLER_DEBUG_PRINTF("Sampler start bus: %d handle: %d addr: 0x%x reg: 0x%x len: %d period: %d us\r\n",
+            cfg.bus, cfg.handle, cfg.addr, cfg.reg, cfg.len, cfg.period_us);
+
+    if (cfg.bus == WASME_SAMPLER_BUS_I2C) {
+        if (!ctx->i2c_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+        if (!ctx->i2c_drv->write_read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    } else if (cfg.bus == WASME_SAMPLER_BUS_SPI) {
+        if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+        if (!ctx->spi_drv->transfer) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    } else {
+        m3ApiReturn(__WASI_ERRNO_INVAL);
+    }
+
+    if (cfg.len == 0 || cfg.len > WASME_SAMPLER_MAX_LEN || cfg.period_us == 0) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    // Resolve guest handle to driver handle
+    wasme_handle_kind_t kind = cfg.bus == WASME_SAMPLER_BUS_I2C ? WASME_HANDLE_I2C : WASME_HANDLE_SPI;
+    if (wasme_handle_get(ctx, kind, cfg.handle, &cfg.handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    // Ring data must be a power of two for free-running indices and hold a sample
+    uint32_t size = cfg.ring_len > WASME_SAMPLER_RING_HDR ? cfg.ring_len - WASME_SAMPLER_RING_HDR : 0;
+    if (size == 0 || (size & (size - 1)) || (cfg.ring_ptr & 3)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+    if (size < sampler_record_len(&cfg)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    _Atomic uint32_t* hdr = (_Atomic uint32_t*)wasme_mem_range(runtime, cfg.ring_ptr, cfg.ring_len);
+    if (!hdr) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    int32_t res = sampler_host_start(ctx);
+    if (res) { m3ApiReturn(res); }
+
+    sampler_lock(ctx);
+
+    uint32_t id = WASME_SAMPLER_MAX;
+    for (uint32_t i = 0; i < WASME_SAMPLER_MAX && id == WASME_SAMPLER_MAX; i++) {
+        if (!ctx->samplers[i].active) {
+            id = i;
+        }
+    }
+    if (id == WASME_SAMPLER_MAX) {
+        sampler_unlock(ctx);
+        m3ApiReturn(__WASI_ERRNO_NFILE);
+    }
+
+    atomic_store(&hdr[RING_HEAD], 0);
+    atomic_store(&hdr[RING_TAIL], 0);
+    atomic_store(&hdr[RING_SIZE], size);
+    atomic_store(&hdr[RING_DROPPED], 0);
+
+    struct wasme_sampler_s* s = &ctx->samplers[id];
+    s->cfg = cfg;
+    s->size = size;
+    s->period_ns = (int64_t)cfg.period_us * 1000;
+    s->next_ns = wasme_clock_monotonic(ctx);
+    atomic_store(&s->waiting, false);
+    s->active = true;
+
+    sampler_unlock(ctx);
+    sampler_host_wake(ctx);
+    wasme_mem_pin_update(ctx);
+
+    memcpy(id_mem, &id, sizeof(id));
+
+    m3ApiReturn(0);
+}
+
+m3ApiRawFunction(m3_sampler_stop)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (uint32_t, id)
+
+    WASME_SAMPLER_DEBUG_PRINTF("Sampler stop id: %d\r\n", id);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (id >= WASME_SAMPLER_MAX || !ctx->samplers[id].active) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    // Waits for an in-flight sample so the ring is not written after return
+    sampler_lock(ctx);
+    ctx->samplers[id].active = false;
+    sampler_unlock(ctx);
+    wasme_mem_pin_update(ctx);
+
+    m3ApiReturn(0);
+}
+
+m3ApiRawFunction(m3_sampler_wait)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (uint32_t, id)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (id >= WASME_SAMPLER_MAX || !ctx->samplers[id].active) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    struct wasme_sampler_s* s = &ctx->samplers[id];
+
+    _Atomic uint32_t* hdr = sampler_ring_hdr(ctx, s);
+    if (!hdr) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Flag waiting before re-checking so a concurrent sample cannot be missed
+    atomic_store(&s->waiting, true);
+
+    if (atomic_load(&hdr[RING_HEAD]) != atomic_load(&hdr[RING_TAIL])) {
+        if (atomic_exchange(&s->waiting, false)) {
+            m3ApiReturn(0);
+        }
+        // Sample claimed the wait and completes it below
+    }
+
+    // Park or block until the next sample is stored
+    int32_t res = wasme_async_wait(ctx, WASME_DRV_PENDING);
+
+    m3ApiReturn(res);
+}
+
+const static char* wasme_sampler_mod = "sampler";
+
+int32_t WASME_bind_sampler(wasme_ctx_t* ctx) {
+    M3Result m3_res;
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_sampler_mod, "start", "i(ii)", &m3_sampler_start, ctx);
+    if (m3_res) {
+        goto sampler_bind_err;
+    }
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_sampler_mod, "stop", "i(i)", &m3_sampler_stop, ctx);
+    if (m3_res) {
+        goto sampler_bind_err;
+    }
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_sampler_mod, "wait", "i(i)", &m3_sampler_wait, ctx);
+    if (m3_res) {
+        goto sampler_bind_err;
+    }
+
+    return 0;
+
+sampler_bind_err:
+    if (m3_res) {
+        printf("Sampler binding failed: %s\r\n", m3_res);
+    }
+
+    return -1;
+}
@@ -0,0 +1,564 @@
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "wasm_embedded/wasm3/sched.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WASME_USE_THREADS
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Queued run or call request
+struct wasme_job_s {
+    struct wasme_job_s* next;
+
+    // Function by name for runs, or resolved function for calls
+    const char* name;
+    wasme_func_t* func;
+
+    wasme_val_t args[WASME_MAX_VALS];
+    uint32_t argc;
+    wasme_val_t* results;
+    uint32_t resc;
+
+    wasme_sched_cb_f cb;
+    void* cb_arg;
+
+    // Set once the job has been suspended and must be resumed
+    bool started;
+};
+
+// Per-worker deque of runnable contexts, the owner pushes and pops at the back
+// and thieves steal from the front
+typedef struct {
+    pthread_mutex_t lock;
+    wasme_ctx_t** items;
+    uint32_t cap;
+    uint32_t head;
+    uint32_t count;
+} wasme_deque_t;
+
+typedef struct {
+    wasme_sched_t* sched;
+    uint32_t index;
+    pthread_t thread;
+    wasme_deque_t deque;
+} wasme_worker_t;
+
+struct wasme_sched_s {
+    wasme_worker_t* workers;
+    uint32_t num_workers;
+    uint32_t num_started;
+
+    // Protects context job lists and counters below
+    pthread_mutex_t lock;
+    // Signalled when contexts become runnable or on shutdown
+    pthread_cond_t ready_cond;
+    // Signalled when all requests have completed
+    pthread_cond_t idle_cond;
+
+    // Number of contexts in worker deques
+    uint32_t ready;
+    // Number of requests queued or executing
+    uint32_t outstanding;
+    bool running;
+
+    // Home worker for the next context submitted to this scheduler
+    uint32_t next_home;
+
+    // Fuel granted per slice, 0 to run requests to completion
+    uint64_t fuel_slice;
+};
+
+static bool deque_grow(wasme_deque_t* d) {
+    if (d->count == d->cap) {
+        uint32_t cap = d->cap ? d->cap * 2 : 16;
+        wasme_ctx_t** items = malloc(cap * sizeof(wasme_ctx_t*));
+        if (!items) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < d->count; i++) {
+            items[i] = d->items[(d->head + i) % d->cap];
+        }
+        free(d->items);
+
+        d->items = items;
+        d->cap = cap;
+        d->head = 0;
+    }
+
+    return true;
+}
+
+static bool deque_push(wasme_deque_t* d, wasme_ctx_t* ctx) {
+    pthread_mutex_lock(&d->lock);
+
+    if (!deque_grow(d)) {
+        pthread_mutex_unlock(&d->lock);
+        return false;
+    }
+
+    d->items[(d->head + d->count) % d->cap] = ctx;
+    d->count++;
+
+    pthread_mutex_unlock(&d->lock);
+
+    return true;
+}
+
+// Push to the front so the context is stolen before newer local work
+static bool deque_push_front(wasme_deque_t* d, wasme_ctx_t* ctx) {
+    pthread_mutex_lock(&d->lock);
+
+    if (!deque_grow(d)) {
+        pthread_mutex_unlock(&d->lock);
+        return false;
+    }
+
+    d->head = (d->head + d->cap - 1) % d->cap;
+    d->items[d->head] = ctx;
+    d->count++;
+
+    pthread_mutex_unlock(&d->lock);
+
+    return true;
+}
+
+static wasme_ctx_t* deque_pop_back(wasme_deque_t* d) {
+    wasme_ctx_t* ctx = NULL;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->count) {
+        d->count--;
+        ctx = d->items[(d->head + d->count) % d->cap];
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return ctx;
+}
+
+static wasme_ctx_t* deque_steal_front(wasme_deque_t* d) {
+    wasme_ctx_t* ctx = NULL;
+
+    // Skip contended victims rather than waiting on them
+    if (pthread_mutex_trylock(&d->lock) != 0) {
+        return NULL;
+    }
+    if (d->count) {
+        ctx = d->items[d->head];
+        d->head = (d->head + 1) % d->cap;
+        d->count--;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return ctx;
+}
+
+// Make a context runnable on its home worker, called with the scheduler lock held
+static int sched_make_ready(wasme_sched_t* sched, wasme_ctx_t* ctx) {
+    wasme_worker_t* w = &sched->workers[ctx->sched_home % sched->num_workers];
+
+    if (!deque_push(&w->deque, ctx)) {
+        return -1;
+    }
+
+    sched->ready++;
+    pthread_cond_signal(&sched->ready_cond);
+
+    return 0;
+}
+
+// Find a runnable context, preferring the local deque to keep memory warm
+static wasme_ctx_t* sched_find(wasme_worker_t* w) {
+    wasme_sched_t* sched = w->sched;
+
+    wasme_ctx_t* ctx = deque_pop_back(&w->deque);
+    if (ctx) {
+        return ctx;
+    }
+
+    for (uint32_t i = 1; i < sched->num_workers; i++) {
+        wasme_worker_t* victim = &sched->workers[(w->index + i) % sched->num_workers];
+
+        ctx = deque_steal_front(&victim->deque);
+        if (ctx) {
+            // Stolen contexts now live on this worker
+            ctx->sched_home = w->index;
+            return ctx;
+        }
+    }
+
+    return NULL;
+}
+
+// Fail every request queued for a context that could not be requeued, called with
+// the scheduler lock held. Callbacks run unlocked as they may submit new requests
+static void sched_fail_jobs(wasme_sched_t* sched, wasme_ctx_t* ctx) {
+    struct wasme_job_s* job = ctx->sched_jobs;
+    ctx->sched_jobs = ctx->sched_jobs_tail = NULL;
+    ctx->sched_queued = false;
+
+    pthread_mutex_unlock(&sched->lock);
+
+    uint32_t failed = 0;
+    while (job) {
+        struct wasme_job_s* next = job->next;
+        if (job->cb) {
+            job->cb(ctx, -1, job->cb_arg);
+        }
+        free(job);
+        job = next;
+        failed++;
+    }
+
+    pthread_mutex_lock(&sched->lock);
+
+    sched->outstanding -= failed;
+    if (sched->outstanding == 0) {
+        pthread_cond_broadcast(&sched->idle_cond);
+        pthread_cond_broadcast(&sched->ready_cond);
+    }
+}
+
+static int sched_exec(wasme_sched_t* sched, wasme_ctx_t* ctx, struct wasme_job_s* job) {
+    if (sched->fuel_slice) {
+        WASME_set_fuel(ctx, sched->fuel_slice);
+    }
+
+    bool resume = job->started;
+    job->started = true;
+
+    if (resume) {
+        return WASME_resume(ctx, job->results, job->resc);
+    }
+
+    if (job->func) {
+        return WASME_call(ctx, job->func, job->args, job->argc, job->results, job->resc);
+    }
+
+    return WASME_run(ctx, job->name, 0, NULL);
+}
+
+static void* sched_worker(void* arg) {
+    wasme_worker_t* w = (wasme_worker_t*)arg;
+    wasme_sched_t* sched = w->sched;
+
+    while (true) {
+        wasme_ctx_t* ctx = sched_find(w);
+
+        pthread_mutex_lock(&sched->lock);
+
+        if (!ctx) {
+            if (!sched->running && sched->outstanding == 0) {
+                pthread_mutex_unlock(&sched->lock);
+                break;
+            }
+
+            // Sleep until work is queued, re-checking after each wake
+            if (sched->ready == 0) {
+                pthread_cond_wait(&sched->ready_cond, &sched->lock);
+            }
+            pthread_mutex_unlock(&sched->lock);
+            continue;
+        }
+
+        sched->ready--;
+
+        // Job stays at the head of the list until complete
+        struct wasme_job_s* job = ctx->sched_jobs;
+
+        pthread_mutex_unlock(&sched->lock);
+
+        int res = sched_exec(sched, ctx, job);
+
+        if (res == WASME_SUSPENDED) {
+            // Out of fuel, yield the worker behind other runnable contexts
+            pthread_mutex_lock(&sched->lock);
+            if (deque_push_front(&w->deque, ctx)) {
+                ctx->sched_home = w->index;
+                sched->ready++;
+                pthread_cond_signal(&sched->ready_cond);
+                pthread_mutex_unlock(&sched->lock);
+                continue;
+            }
+            pthread_mutex_unlock(&sched->lock);
+
+            // Unable to requeue, run the remainder to completion
+            WASME_disable_fuel(ctx);
+            res = WASME_resume(ctx, job->results, job->resc);
+        }
+
+        // Parked on a driver, completion makes the context ready again
+        if (res == WASME_PENDING) {
+            continue;
+        }
+
+        pthread_mutex_lock(&sched->lock);
+        ctx->sched_jobs = job->next;
+        if (!ctx->sched_jobs) {
+            ctx->sched_jobs_tail = NULL;
+        }
+        pthread_mutex_unlock(&sched->lock);
+
+        if (job->cb) {
+            job->cb(ctx, res, job->cb_arg);
+        }
+        free(job);
+
+        pthread_mutex_lock(&sched->lock);
+
+        // Requeue locally if more requests arrived for this context
+        if (ctx->sched_jobs) {
+            ctx->sched_home = w->index;
+            if (sched_make_ready(sched, ctx) < 0) {
+                wasme_console_printf(ctx, "Requeue failed, failing queued requests\r\n");
+                sched_fail_jobs(sched, ctx);
+            }
+        } else {
+            ctx->sched_queued = false;
+        }
+
+        sched->outstanding--;
+        if (sched->outstanding == 0) {
+            pthread_cond_broadcast(&sched->idle_cond);
+            pthread_cond_broadcast(&sched->ready_cond);
+        }
+
+        pthread_mutex_unlock(&sched->lock);
+    }
+
+    return NULL;
+}
+
+// Requeue a context once its driver operation completes
+static void sched_async_notify(wasme_ctx_t* ctx, void* arg) {
+    wasme_sched_t* sched = (wasme_sched_t*)arg;
+
+    pthread_mutex_lock(&sched->lock);
+    if (sched_make_ready(sched, ctx) < 0) {
+        // The parked request cannot continue, it is failed with those behind it
+        wasme_console_printf(ctx, "Requeue failed after driver completion, failing queued requests\r\n");
+        sched_fail_jobs(sched, ctx);
+    }
+    pthread_mutex_unlock(&sched->lock);
+}
+
+static int sched_submit(wasme_sched_t* sched, wasme_ctx_t* ctx, struct wasme_job_s* job) {
+    int res = 0;
+
+    pthread_mutex_lock(&sched->lock);
+
+    if (!sched->running) {
+        pthread_mutex_unlock(&sched->lock);
+        free(job);
+        return -1;
+    }
+
+    // First submission to this scheduler
+    if (ctx->async_notify_arg != sched) {
+        // Driver operations park the task rather than blocking the worker
+        WASME_async_enable(ctx, sched_async_notify, sched);
+
+        // Spread new contexts across workers rather than relying on stealing
+        ctx->sched_home = sched->next_home++ % sched->num_workers;
+    }
+
+    if (ctx->sched_jobs_tail) {
+        ctx->sched_jobs_tail->next = job;
+    } else {
+        ctx->sched_jobs = job;
+    }
+    ctx->sched_jobs_tail = job;
+
+    // Contexts already queued or executing pick up the new job when done
+    if (!ctx->sched_queued) {
+        res = sched_make_ready(sched, ctx);
+        if (res < 0) {
+            ctx->sched_jobs = ctx->sched_jobs_tail = NULL;
+            pthread_mutex_unlock(&sched->lock);
+            free(job);
+            return res;
+        }
+        ctx->sched_queued = true;
+    }
+
+    sched->outstanding++;
+
+    pthread_mutex_unlock(&sched->lock);
+
+    return res;
+}
+
+wasme_sched_t* WASME_sched_init(const wasme_sched_cfg_t* cfg) {
+    wasme_sched_t* sched = malloc(sizeof(wasme_sched_t));
+    if (!sched) {
+        printf("Allocating wasme_sched_t failed\r\n");
+        return NULL;
+    }
+    memset(sched, 0, sizeof(wasme_sched_t));
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) {
+        cores = 1;
+    }
+
+    sched->num_workers = cfg->workers ? cfg->workers : cores;
+    sched->running = true;
+    sched->fuel_slice = cfg->fuel_slice;
+
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->ready_cond, NULL);
+    pthread_cond_init(&sched->idle_cond, NULL);
+
+    sched->workers = calloc(sched->num_workers, sizeof(wasme_worker_t));
+    if (!sched->workers) {
+        printf("Allocating scheduler workers failed\r\n");
+        free(sched);
+        return NULL;
+    }
+
+    // Deques must all exist before any worker can attempt to steal
+    for (uint32_t i = 0; i < sched->num_workers; i++) {
+        wasme_worker_t* w = &sched->workers[i];
+
+        w->sched = sched;
+        w->index = i;
+        pthread_mutex_init(&w->deque.lock, NULL);
+    }
+
+    for (uint32_t i = 0; i < sched->num_workers; i++) {
+        wasme_worker_t* w = &sched->workers[i];
+
+        if (pthread_create(&w->thread, NULL, sched_worker, w) != 0) {
+            printf("Starting worker %d failed\r\n", i);
+            sched->num_started = i;
+            WASME_sched_deinit(&sched);
+            return NULL;
+        }
+
+#ifdef __linux__
+        if (cfg->pin_workers) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % cores, &cpus);
+            pthread_setaffinity_np(w->thread, sizeof(cpus), &cpus);
+        }
+#endif
+    }
+
+    sched->num_started = sched->num_workers;
+
+    return sched;
+}
+
+int WASME_sched_run(wasme_sched_t* sched, wasme_ctx_t* ctx, const char* name,
+        wasme_sched_cb_f cb, void* cb_arg) {
+
+    struct wasme_job_s* job = calloc(1, sizeof(struct wasme_job_s));
+    if (!job) {
+        return -1;
+    }
+
+    job->name = name;
+    job->cb = cb;
+    job->cb_arg = cb_arg;
+
+    return sched_submit(sched, ctx, job);
+}
+
+int WASME_sched_call(wasme_sched_t* sched, wasme_ctx_t* ctx, wasme_func_t* func,
+        const wasme_val_t* args, uint32_t argc, wasme_val_t* results, uint32_t resc,
+        wasme_sched_cb_f cb, void* cb_arg) {
+
+    if (argc > WASME_MAX_VALS) {
+        return -1;
+    }
+
+    struct wasme_job_s* job = calloc(1, sizeof(struct wasme_job_s));
+    if (!job) {
+        return -1;
+    }
+
+    job->func = func;
+    memcpy(job->args, args, argc * sizeof(wasme_val_t));
+    job->argc = argc;
+    job->results = results;
+    job->resc = resc;
+    job->cb = cb;
+    job->cb_arg = cb_arg;
+
+    return sched_submit(sched, ctx, job);
+}
+
+void WASME_sched_wait(wasme_sched_t* sched) {
+    pthread_mutex_lock(&sched->lock);
+    while (sched->outstanding) {
+        pthread_cond_wait(&sched->idle_cond, &sched->lock);
+    }
+    pthread_mutex_unlock(&sched->lock);
+}
+
+void WASME_sched_deinit(wasme_sched_t** sched) {
+    if (!*sched) {
+        return;
+    }
+
+    wasme_sched_t* s = *sched;
+
+    // Workers exit once outstanding requests drain
+    pthread_mutex_lock(&s->lock);
+    s->running = false;
+    pthread_cond_broadcast(&s->ready_cond);
+    pthread_mutex_unlock(&s->lock);
+
+    for (uint32_t i = 0; i < s->num_started; i++) {
+        pthread_join(s->workers[i].thread, NULL);
+    }
+
+    for (uint32_t i = 0; i < s->num_workers; i++) {
+        pthread_mutex_destroy(&s->workers[i].deque.lock);
+        free(s->workers[i].deque.items);
+    }
+
+    pthread_cond_destroy(&s->idle_cond);
+    pthread_cond_destroy(&s->ready_cond);
+    pthread_mutex_destroy(&s->lock);
+
+    free(s->workers);
+    free(s);
+
+    *sched = NULL;
+}
+
+#else
+
+wasme_sched_t* WASME_sched_init(const wasme_sched_cfg_t* cfg) {
+    printf("Scheduler requires thread support\r\n");
+    return NULL;
+}
+
+int WASME_sched_run(wasme_sched_t* sched, wasme_ctx_t* ctx, const char* name,
+        wasme_sched_cb_f cb, void* cb_arg) {
+    return -1;
+}
+
+int WASME_sched_call(wasme_sched_t* sched, wasme_ctx_t* ctx, wasme_func_t* func,
+        const wasme_val_t* args, uint32_t argc, wasme_val_t* results, uint32_t resc,
+        wasme_sched_cb_f cb, void* cb_arg) {
+    return -1;
+}
+
+void WASME_sched_wait(wasme_sched_t* sched) {}
+
+void WASME_sched_deinit(wasme_sched_t** sched) {}
+
+#endif
@@ -0,0 +1,298 @@
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "wasm_embedded/wasm3/core.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wasm3.h"
+#include "m3_env.h"
+
+#ifdef WASME_COW_SNAPSHOT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Find the length of linear memory up to and including the last non-zero byte,
+// anything beyond this is restored with memset rather than copied
+static uint32_t mem_used_len(const uint8_t* mem, uint32_t len) {
+    while (len > 0 && mem[len - 1] == 0) {
+        len--;
+    }
+    return len;
+}
+
+static void snapshot_free(wasme_snapshot_t* snap) {
+    if (snap->mem) {
+        free(snap->mem);
+    }
+    if (snap->globals) {
+        free(snap->globals);
+    }
+#ifdef WASME_COW_SNAPSHOT
+    if (snap->cow_fd >= 0) {
+        close(snap->cow_fd);
+    }
+#endif
+    memset(snap, 0, sizeof(wasme_snapshot_t));
+#ifdef WASME_COW_SNAPSHOT
+    snap->cow_fd = -1;
+#endif
+}
+
+#ifdef WASME_COW_SNAPSHOT
+
+// Store the whole pages within linear memory in a memfd so they can be restored
+// by mapping the file privately over memory, only pages touched after a restore
+// are then copied by the kernel. Bytes outside these pages are kept in snap->mem.
+static void snapshot_cow_take(wasme_snapshot_t* snap, const uint8_t* mem, uint32_t mem_len) {
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)mem + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)mem + mem_len) & ~(page - 1);
+
+    // Too small to be worth mapping, use the copy path
+    if (end <= start) {
+        return;
+    }
+
+    int fd = memfd_create("wasme_snapshot", MFD_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    uint32_t offset = start - (uintptr_t)mem;
+    uint32_t len = end - start;
+
+    // Zero tail pages are left as holes in the file
+    uint32_t used = mem_used_len(mem + offset, len);
+
+    if (ftruncate(fd, len) < 0) {
+        goto cow_err;
+    }
+
+    for (uint32_t written = 0; written < used; ) {
+        ssize_t res = pwrite(fd, mem + offset + written, used - written, written);
+        if (res <= 0) {
+            goto cow_err;
+        }
+        written += res;
+    }
+
+    snap->cow_fd = fd;
+    snap->cow_offset = offset;
+    snap->cow_len = len;
+
+    return;
+
+cow_err:
+    printf("Writing snapshot memfd failed, using copy snapshot\r\n");
+    close(fd);
+}
+
+// Restore linear memory from the memfd, returns 0 on success.
+// Only built with WASME_MMAP_LINEAR_MEMORY, where linear memory is a mapping
+// owned by the embedder's allocator rather than malloc heap.
+static int snapshot_cow_restore(wasme_snapshot_t* snap, uint8_t* mem, uint32_t mem_len) {
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)mem + page - 1) & ~(page - 1);
+    uint32_t offset = start - (uintptr_t)mem;
+
+    // Memory moved to a different page alignment, copy back from the file
+    if (offset != snap->cow_offset || offset + snap->cow_len > mem_len) {
+        ssize_t res = pread(snap->cow_fd, mem + snap->cow_offset, snap->cow_len, 0);
+        if (res != (ssize_t)snap->cow_len) {
+            return -1;
+        }
+
+    } else {
+        // Replace dirty pages with a fresh private mapping of the snapshot
+        void* p = mmap((void*)start, snap->cow_len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, snap->cow_fd, 0);
+        if (p == MAP_FAILED) {
+            printf("Snapshot mmap failed\r\n");
+            return -1;
+        }
+    }
+
+    // Restore the partial pages either side of the mapping
+    uint32_t tail = snap->cow_offset + snap->cow_len;
+
+    memcpy(mem, snap->mem, snap->cow_offset);
+    memcpy(mem + tail, snap->mem + snap->cow_offset, mem_len - tail);
+
+    return 0;
+}
+
+#endif
+
+int WASME_snapshot(wasme_ctx_t* ctx) {
+    M3Result m3_res;
+    wasme_snapshot_t* snap = &ctx->snapshot;
+
+    // Drop any existing snapshot
+    snapshot_free(snap);
+
+    // Capture linear memory
+    uint32_t mem_len = 0;
+    uint8_t* mem = m3_GetMemory(ctx->rt, &mem_len, 0);
+
+    snap->num_pages = ctx->rt->memory.numPages;
+
+#ifdef WASME_COW_SNAPSHOT
+    if (mem) {
+        snapshot_cow_take(snap, mem, mem_len);
+    }
+
+    // Only the partial pages outside the mapping are held in memory
+    if (snap->cow_fd >= 0) {
+        uint32_t tail = snap->cow_offset + snap->cow_len;
+
+        snap->mem_len = snap->cow_offset + (mem_len - tail);
+        snap->mem = malloc(snap->mem_len);
+        if (!snap->mem) {
+            printf("Allocating snapshot memory failed\r\n");
+            snapshot_free(snap);
+            return -1;
+        }
+
+        memcpy(snap->mem, mem, snap->cow_offset);
+        memcpy(snap->mem + snap->cow_offset, mem + tail, mem_len - tail);
+
+    } else
+#endif
+    {
+        snap->mem_len = mem ? mem_used_len(mem, mem_len) : 0;
+
+        if (snap->mem_len) {
+            snap->mem = malloc(snap->mem_len);
+            if (!snap->mem) {
+                printf("Allocating snapshot memory failed\r\n");
+                return -1;
+            }
+            memcpy(snap->mem, mem, snap->mem_len);
+        }
+    }
+
+    // Capture mutable globals, immutable globals are left with type none
+    snap->num_globals = ctx->mod->numGlobals;
+    if (snap->num_globals) {
+        snap->globals = calloc(snap->num_globals, sizeof(M3TaggedValue));
+        if (!snap->globals) {
+            printf("Allocating snapshot globals failed\r\n");
+            snapshot_free(snap);
+            return -2;
+        }
+    }
+
+    for (uint32_t i = 0; i < snap->num_globals; i++) {
+        IM3Global g = &ctx->mod->globals[i];
+        if (!g->isMutable) {
+            continue;
+        }
+
+        m3_res = m3_GetGlobal(g, &snap->globals[i]);
+        if (m3_res) {
+            printf("GetGlobal %d failed: %s\r\n", i, m3_res);
+            snapshot_free(snap);
+            return -3;
+        }
+    }
+
+    snap->handle_seq = ctx->handles.seq;
+    snap->valid = true;
+
+    return 0;
+}
+
+int WASME_reset(wasme_ctx_t* ctx) {
+    M3Result m3_res;
+    wasme_snapshot_t* snap = &ctx->snapshot;
+
+    if (!snap->valid) {
+        return -1;
+    }
+
+    // Stop anything writing into memory being restored and close driver handles
+    // opened since the snapshot, those opened before remain valid in restored memory
+    wasme_handles_release(ctx, snap->handle_seq);
+    wasme_vfs_release(ctx);
+    wasme_gpio_flush(ctx);
+
+    // Drop any memory grown since the snapshot was taken
+    if (ctx->rt->memory.numPages != snap->num_pages) {
+        m3_res = ResizeMemory(ctx->rt, snap->num_pages);
+        if (m3_res) {
+            printf("ResizeMemory failed: %s\r\n", m3_res);
+            return -2;
+        }
+    }
+
+    // Restore linear memory in place
+    uint32_t mem_len = 0;
+    uint8_t* mem = m3_GetMemory(ctx->rt, &mem_len, 0);
+#ifdef WASME_COW_SNAPSHOT
+    if (mem && snap->cow_fd >= 0) {
+        if (snapshot_cow_restore(snap, mem, mem_len) < 0) {
+            return -4;
+        }
+    } else
+#endif
+    if (mem) {
+        memcpy(mem, snap->mem, snap->mem_len);
+        memset(mem + snap->mem_len, 0, mem_len - snap->mem_len);
+    }
+
+    // Restore mutable globals
+    for (uint32_t i = 0; i < snap->num_globals; i++) {
+        if (snap->globals[i].type == c_m3Type_none) {
+            continue;
+        }
+
+        m3_res = m3_SetGlobal(&ctx->mod->globals[i], &snap->globals[i]);
+        if (m3_res) {
+            printf("SetGlobal %d failed: %s\r\n", i, m3_res);
+            return -3;
+        }
+    }
+
+    // Clear any trap or exit state left by the previous run
+    m3_ResetErrorInfo(ctx->rt);
+    ctx->wasi.exit_code = 0;
+
+    // Any suspended execution is abandoned, its fiber is restarted by the next run
+    ctx->exec.suspended = false;
+    ctx->exec.pending = false;
+
+    return 0;
+}
+
+int WASME_initialize(wasme_ctx_t* ctx) {
+    IM3Function f;
+
+    // Reactor modules export _initialize, command modules have nothing to run
+    M3Result m3_res = m3_FindFunction(&f, ctx->rt, "_initialize");
+    if (!m3_res) {
+        m3_res = m3_CallV(f);
+        if (m3_res) {
+            printf("_initialize failed: %s\r\n", m3_res);
+            return -1;
+        }
+    }
+
+    return WASME_snapshot(ctx);
+}
+
+void wasme_snapshot_init(wasme_ctx_t* ctx) {
+    memset(&ctx->snapshot, 0, sizeof(wasme_snapshot_t));
+#ifdef WASME_COW_SNAPSHOT
+    ctx->snapshot.cow_fd = -1;
+#endif
+}
+
+void wasme_snapshot_deinit(wasme_ctx_t* ctx) {
+    snapshot_free(&ctx->snapshot);
+}
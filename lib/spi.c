@@ -1,7 +1,6 @@
 
 #include "wasm3.h"
 #include "m3_env.h"
-#include "m3_api_wasi.h"
 #include "m3_env.h"
 #include "m3_exception.h"
 #include "m3_info.h"
@@ -10,6 +9,10 @@
 #include "wasm_embedded/wasm3/spi.h"
 #include "wasm_embedded/wasm3/internal.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
 #define TAG "WASME_SPI"
 
 
@@ -22,11 +25,6 @@
 #define WASME_SPI_DEBUG_PRINTF(...)
 #endif
 
-// Shared I2C driver objects
-// TODO: work out how to bind these to wasm3 context
-static const spi_drv_t* spi_drv = NULL;
-static const void* spi_drv_ctx = NULL;
-
 // SPI debug logging flag
 static bool spi_debug = false;
 
@@ -47,16 +45,29 @@ m3ApiRawFunction(m3_spi_init)
     WASME_SPI_DEBUG_PRINTF("SPI init port: %d freq: %d mosi: %d miso: %d sck: %d cs: %d\r\n",
             dev, baud, mosi, miso, sck, cs);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!spi_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->spi_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = spi_drv->init(spi_drv_ctx, dev, baud, mosi, miso, sck, cs);
+    int32_t res = ctx->spi_drv->init(ctx->spi_drv_ctx, dev, baud, mosi, miso, sck, cs);
 
     if(res >= 0) {
-        *handle = res;
-        WASME_SPI_DEBUG_PRINTF("SPI handle: %d\r\n", res);
+        // Guest receives a table handle in place of the driver handle
+        int32_t h = wasme_handle_alloc(ctx, WASME_HANDLE_SPI, res);
+        if (h < 0) {
+            if (ctx->spi_drv->deinit) {
+                ctx->spi_drv->deinit(ctx->spi_drv_ctx, res);
+            }
+            m3ApiReturn(__WASI_ERRNO_NFILE);
+        }
+        *handle = h;
+        res = h;
+        WASME_SPI_DEBUG_PRINTF("SPI handle: %d\r\n", h);
     }
 
     m3ApiReturn(res);
@@ -70,13 +81,17 @@ m3ApiRawFunction(m3_spi_deinit)
 
     WASME_SPI_DEBUG_PRINTF("SPI deinit handle: %d\r\n", handle);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!spi_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
-
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->spi_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = spi_drv->deinit(spi_drv_ctx, handle);
+    // Streams, subscriptions and samplers on the handle are stopped with it
+    int32_t res = wasme_handle_close(ctx, WASME_HANDLE_SPI, handle);
 
     m3ApiReturn(res);
 }
@@ -102,14 +117,24 @@ m3ApiRawFunction(m3_spi_read)
 
     WASME_SPI_DEBUG_PRINTF("SPI read data: %p len: %d\r\n", data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!spi_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->spi_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
     WASME_SPI_DEBUG_PRINTF("SPI read port: %d, %d bytes (%p)\r\n", handle, *len, data);
 
-    int32_t res = spi_drv->read(spi_drv_ctx, handle, data, *len);
+    int32_t res = ctx->spi_drv->read(ctx->spi_drv_ctx, handle, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     m3ApiReturn(res);
 }
@@ -130,14 +155,24 @@ m3ApiRawFunction(m3_spi_write)
 
     WASME_SPI_DEBUG_PRINTF("SPI write data: %p len: %d\r\n", data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!spi_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->spi_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
     WASME_SPI_DEBUG_PRINTF("SPI write port: %d, %d bytes (%p)\r\n", handle, *len, data);
 
-    int32_t res = spi_drv->write(spi_drv_ctx, handle, data, *len);
+    int32_t res = ctx->spi_drv->write(ctx->spi_drv_ctx, handle, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     m3ApiReturn(res);
 }
@@ -158,21 +193,31 @@ m3ApiRawFunction(m3_spi_transfer)
     uint32_t* read_len = m3ApiOffsetToPtr(read_ptr+4);
 
     // Resolve relative buffer object pointer
-    uint32_t* write_mem_p = m3ApiOffsetToPtr(read_ptr);
+    uint32_t* write_mem_p = m3ApiOffsetToPtr(write_ptr);
     // Resolve relative data pointer im buffer
     uint8_t* write_data = m3ApiOffsetToPtr(*write_mem_p);
     // Fetch length, imo this should be *mem_p + 4 but, idk
-    uint32_t* write_len = m3ApiOffsetToPtr(read_ptr+4);
+    uint32_t* write_len = m3ApiOffsetToPtr(write_ptr+4);
 
 
     WASME_SPI_DEBUG_PRINTF("SPI transfer port: %d, read: %p write %p len: %d\r\n", handle, read_data, write_data, *read_len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!spi_drv->transfer) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->spi_drv->transfer) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = spi_drv->transfer(spi_drv_ctx, handle, read_data, write_data, *read_len);
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    int32_t res = ctx->spi_drv->transfer(ctx->spi_drv_ctx, handle, read_data, write_data, *read_len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     WASME_SPI_DEBUG_PRINTF("SPI transfer port: %d, %d bytes (read: %p write: %p)\r\n", handle, *read_len, read_data, write_data);
 
@@ -195,43 +240,302 @@ m3ApiRawFunction(m3_spi_transfer_inplace)
 
     WASME_SPI_DEBUG_PRINTF("SPI transfer_inplace port: %d, data: %p len: %d\r\n", handle, data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!spi_drv->transfer) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->spi_drv->transfer) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = spi_drv->transfer_inplace(spi_drv_ctx, handle, data, *len);
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    int32_t res = ctx->spi_drv->transfer_inplace(ctx->spi_drv_ctx, handle, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     WASME_SPI_DEBUG_PRINTF("SPI transfer_inplace port: %d, %d bytes (%p)\r\n", handle, *len, data);
 
     m3ApiReturn(res);
 }
 
-// TODO: implement exec wasm3 function
+// Delay between operations when executing without an exec driver
+static int32_t spi_delay_us(uint32_t us) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec ts = {
+        .tv_sec = us / 1000000,
+        .tv_nsec = (us % 1000000) * 1000,
+    };
+    nanosleep(&ts, NULL);
+    return 0;
+#else
+    return __WASI_ERRNO_NOTSUP;
+#endif
+}
+
+// Execute operations individually using the SPI driver
+static int32_t spi_exec_fallback(wasme_ctx_t* ctx, int32_t handle, const wasme_spi_xfer_t* ops, uint32_t num_ops) {
+    const spi_drv_t* drv = ctx->spi_drv;
+    int32_t res = 0;
+
+    for (uint32_t i = 0; i < num_ops && res == 0; i++) {
+        const wasme_spi_xfer_t* op = &ops[i];
+
+        switch (op->kind) {
+            case WASME_SPI_OP_WRITE:
+                res = drv->write ? drv->write(ctx->spi_drv_ctx, handle, op->write, op->len) : __WASI_ERRNO_NOENT;
+                break;
+            case WASME_SPI_OP_READ:
+                res = drv->read ? drv->read(ctx->spi_drv_ctx, handle, op->read, op->len) : __WASI_ERRNO_NOENT;
+                break;
+            case WASME_SPI_OP_TRANSFER:
+                res = drv->transfer ? drv->transfer(ctx->spi_drv_ctx, handle, op->read, op->write, op->len) : __WASI_ERRNO_NOENT;
+                break;
+            case WASME_SPI_OP_TRANSFER_INPLACE:
+                res = drv->transfer_inplace ? drv->transfer_inplace(ctx->spi_drv_ctx, handle, op->read, op->len) : __WASI_ERRNO_NOENT;
+                break;
+            case WASME_SPI_OP_DELAY_US:
+                res = spi_delay_us(op->len);
+                break;
+            default:
+                // Chip select operations are rejected before the fallback runs
+                res = __WASI_ERRNO_NOTSUP;
+                break;
+        }
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    }
+
+    return res;
+}
+
+m3ApiRawFunction(m3_spi_exec)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, ops_ptr)
+    m3ApiGetArg      (uint32_t, num_ops)
+
+    WASME_SPI_DEBUG_PRINTF("SPI exec port: %d, ops: 0x%x count: %d\r\n", handle, ops_ptr, num_ops);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (num_ops > WASME_SPI_MAX_OPS) { m3ApiReturn(__WASI_ERRNO_2BIG); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    const wasme_spi_op_t* guest_ops = (const wasme_spi_op_t*)wasme_mem_range(runtime, ops_ptr, num_ops * sizeof(wasme_spi_op_t));
+    if (!guest_ops) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Chip select control needs an exec driver, the fallback cannot hold it
+    bool has_exec = ctx->spi_exec_drv && ctx->spi_exec_drv->exec;
+
+    // Resolve and bounds check all buffers before touching the bus
+    wasme_spi_xfer_t ops[WASME_SPI_MAX_OPS];
+    for (uint32_t i = 0; i < num_ops; i++) {
+        const wasme_spi_op_t* g = &guest_ops[i];
+        wasme_spi_xfer_t* op = &ops[i];
+
+        op->kind = (wasme_spi_op_kind_t)g->kind;
+        op->read = NULL;
+        op->write = NULL;
+        op->len = g->len;
+
+        switch (g->kind) {
+            case WASME_SPI_OP_WRITE:
+                op->write = wasme_mem_range(runtime, g->write_ptr, g->len);
+                if (!op->write) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+                break;
+            case WASME_SPI_OP_READ:
+                op->read = wasme_mem_range(runtime, g->read_ptr, g->len);
+                if (!op->read) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+                break;
+            case WASME_SPI_OP_TRANSFER:
+                op->read = wasme_mem_range(runtime, g->read_ptr, g->len);
+                op->write = wasme_mem_range(runtime, g->write_ptr, g->len);
+                if (!op->read || !op->write) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+                break;
+            case WASME_SPI_OP_TRANSFER_INPLACE:
+                op->read = op->write = wasme_mem_range(runtime, g->read_ptr, g->len);
+                if (!op->read) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+                break;
+            case WASME_SPI_OP_DELAY_US:
+                break;
+            case WASME_SPI_OP_CS:
+                if (!has_exec) { m3ApiReturn(__WASI_ERRNO_NOTSUP); }
+                break;
+            default:
+                m3ApiReturn(__WASI_ERRNO_INVAL);
+        }
+    }
+
+    int32_t res;
+    if (has_exec) {
+        res = ctx->spi_exec_drv->exec(ctx->spi_exec_drv_ctx, handle, ops, num_ops);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    } else {
+        res = spi_exec_fallback(ctx, handle, ops, num_ops);
+    }
+
+    WASME_SPI_DEBUG_PRINTF("SPI exec port: %d, %d ops res: %d\r\n", handle, num_ops, res);
+
+    m3ApiReturn(res);
+}
+
+
+// Single buffer operations for emulating scatter-gather transfers
+static int32_t spi_iov_write(wasme_ctx_t* ctx, const void* arg, uint8_t* data, uint32_t len) {
+    return ctx->spi_drv->write(ctx->spi_drv_ctx, *(const int32_t*)arg, data, len);
+}
+
+static int32_t spi_iov_read(wasme_ctx_t* ctx, const void* arg, uint8_t* data, uint32_t len) {
+    return ctx->spi_drv->read(ctx->spi_drv_ctx, *(const int32_t*)arg, data, len);
+}
+
+m3ApiRawFunction(m3_spi_writev)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, iovs_ptr)
+    m3ApiGetArg      (uint32_t, iovs_len)
+
+    WASME_SPI_DEBUG_PRINTF("SPI writev port: %d, iovs: 0x%x count: %d\r\n", handle, iovs_ptr, iovs_len);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_iovec_t iov[WASME_MAX_IOVS];
+    int32_t res = wasme_iov_resolve(runtime, iovs_ptr, iovs_len, iov);
+    if (res) { m3ApiReturn(res); }
+
+    if (ctx->spi_vec_drv && ctx->spi_vec_drv->writev) {
+        res = ctx->spi_vec_drv->writev(ctx->spi_vec_drv_ctx, handle, iov, iovs_len);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    } else if (ctx->spi_drv->write) {
+        res = wasme_iov_fallback(ctx, true, iov, iovs_len, spi_iov_write, &handle);
+    } else {
+        res = __WASI_ERRNO_NOENT;
+    }
+
+    m3ApiReturn(res);
+}
+
+m3ApiRawFunction(m3_spi_readv)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, iovs_ptr)
+    m3ApiGetArg      (uint32_t, iovs_len)
+
+    WASME_SPI_DEBUG_PRINTF("SPI readv port: %d, iovs: 0x%x count: %d\r\n", handle, iovs_ptr, iovs_len);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->spi_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_SPI, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_iovec_t iov[WASME_MAX_IOVS];
+    int32_t res = wasme_iov_resolve(runtime, iovs_ptr, iovs_len, iov);
+    if (res) { m3ApiReturn(res); }
 
+    if (ctx->spi_vec_drv && ctx->spi_vec_drv->readv) {
+        res = ctx->spi_vec_drv->readv(ctx->spi_vec_drv_ctx, handle, iov, iovs_len);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    } else if (ctx->spi_drv->read) {
+        res = wasme_iov_fallback(ctx, false, iov, iovs_len, spi_iov_read, &handle);
+    } else {
+        res = __WASI_ERRNO_NOENT;
+    }
+
+    m3ApiReturn(res);
+}
 
 const static char* wasme_spi_mod = "spi";
 
 int32_t WASME_bind_spi(wasme_ctx_t* ctx, const spi_drv_t* drv, void* drv_ctx) {
     M3Result m3_res;
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "init", "i(iiiiiii)", &m3_spi_init);
+    ctx->spi_drv = drv;
+    ctx->spi_drv_ctx = drv_ctx;
+    // Set again by WASME_bind_spi_bus when binding a bus
+    ctx->spi_bus_client.bus = NULL;
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "init", "i(iiiiiii)", &m3_spi_init, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "deinit", "i(i)", &m3_spi_deinit);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "deinit", "i(i)", &m3_spi_deinit, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "read", "i(ii)", &m3_spi_read);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "read", "i(ii)", &m3_spi_read, ctx);
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "write", "i(ii)", &m3_spi_write);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "write", "i(ii)", &m3_spi_write, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "transfer", "i(iii)", &m3_spi_transfer);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "transfer", "i(iii)", &m3_spi_transfer, ctx);
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "transfer_inplace", "i(ii)", &m3_spi_transfer_inplace);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "transfer_inplace", "i(ii)", &m3_spi_transfer_inplace, ctx);
     
-    // TODO: link exec function here when implemented
-    //m3_res = m3_LinkRawFunction(ctx->mod, wasme_spi_mod, "write_read", "i(iiii)", &m3_spi_write_read);
-    
-    spi_drv = drv;
-    spi_drv_ctx = drv_ctx;
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "exec", "i(iii)", &m3_spi_exec, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "writev", "i(iii)", &m3_spi_writev, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_spi_mod, "readv", "i(iii)", &m3_spi_readv, ctx);
     
     return 0;
 }
+
+int32_t WASME_bind_spi_exec(wasme_ctx_t* ctx, const wasme_spi_exec_drv_t* drv, void* drv_ctx) {
+    // Would bypass bus arbitration
+    if (ctx->spi_bus_client.bus) {
+        return -1;
+    }
+
+    // Used by the exec function linked in WASME_bind_spi
+    ctx->spi_exec_drv = drv;
+    ctx->spi_exec_drv_ctx = drv_ctx;
+
+    return 0;
+}
+
+int32_t WASME_bind_spi_vec(wasme_ctx_t* ctx, const wasme_spi_vec_drv_t* drv, void* drv_ctx) {
+    // Would bypass bus arbitration
+    if (ctx->spi_bus_client.bus) {
+        return -1;
+    }
+
+    // Used by the writev/readv functions linked in WASME_bind_spi
+    ctx->spi_vec_drv = drv;
+    ctx->spi_vec_drv_ctx = drv_ctx;
+
+    return 0;
+}
@@ -1,12 +1,14 @@
 
 #include "wasm3.h"
 #include "m3_env.h"
-#include "m3_api_wasi.h"
 #include "m3_env.h"
 #include "m3_exception.h"
 #include "m3_info.h"
 #include "extra/wasi_core.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "wasm_embedded/wasm3/uart.h"
 #include "wasm_embedded/wasm3/internal.h"
 
@@ -21,11 +23,6 @@
 #define WASME_UART_DEBUG_PRINTF(...)
 #endif
 
-// Shared UART driver objects
-// TODO: work out how to bind these to wasm3 context
-static const uart_drv_t* uart_drv = NULL;
-static const void* uart_drv_ctx = NULL;
-
 // UART debug logging flag
 static bool uart_debug = false;
 
@@ -44,16 +41,29 @@ m3ApiRawFunction(m3_uart_init)
 
     WASME_UART_DEBUG_PRINTF("UART init port: %d freq: %d tx: %d rx: %d\r\n", dev, baud, tx, rx);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!uart_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->uart_drv->init) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = uart_drv->init(uart_drv_ctx, dev, baud, tx, rx);
+    int32_t res = ctx->uart_drv->init(ctx->uart_drv_ctx, dev, baud, tx, rx);
 
     if(res >= 0) {
-        *handle = res;
-        WASME_UART_DEBUG_PRINTF("UART handle: %d\r\n", res);
+        // Guest receives a table handle in place of the driver handle
+        int32_t h = wasme_handle_alloc(ctx, WASME_HANDLE_UART, res);
+        if (h < 0) {
+            if (ctx->uart_drv->deinit) {
+                ctx->uart_drv->deinit(ctx->uart_drv_ctx, res);
+            }
+            m3ApiReturn(__WASI_ERRNO_NFILE);
+        }
+        *handle = h;
+        res = h;
+        WASME_UART_DEBUG_PRINTF("UART handle: %d\r\n", h);
     }
 
     m3ApiReturn(res);
@@ -67,13 +77,17 @@ m3ApiRawFunction(m3_uart_deinit)
 
     WASME_UART_DEBUG_PRINTF("UART deinit handle: %d\r\n", handle);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!uart_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
-
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->uart_drv->deinit) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = uart_drv->deinit(uart_drv_ctx, handle);
+    // Streams, subscriptions and samplers on the handle are stopped with it
+    int32_t res = wasme_handle_close(ctx, WASME_HANDLE_UART, handle);
 
     m3ApiReturn(res);
 }
@@ -100,14 +114,24 @@ m3ApiRawFunction(m3_uart_write)
 
     WASME_UART_DEBUG_PRINTF("UART write data: %p len: %d\r\n", data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!uart_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->uart_drv->write) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
     WASME_UART_DEBUG_PRINTF("UART write port: %d flags: 0x%x, %d bytes (%p)\r\n", handle, flags, *len, data);
 
-    int32_t res = uart_drv->write(uart_drv_ctx, handle, flags, data, *len);
+    int32_t res = ctx->uart_drv->write(ctx->uart_drv_ctx, handle, flags, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     m3ApiReturn(res);
 }
@@ -129,34 +153,491 @@ m3ApiRawFunction(m3_uart_read)
 
     WASME_UART_DEBUG_PRINTF("UART read data: %p len: %d\r\n", data, *len);
 
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
     // Check args are valid
     if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
-    if (!uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
-    if (!uart_drv->read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->uart_drv->read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
 
-    int32_t res = uart_drv->read(uart_drv_ctx, handle, flags, data, *len);
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    int32_t res = ctx->uart_drv->read(ctx->uart_drv_ctx, handle, flags, data, *len);
+
+    // Park the task if the driver completes asynchronously
+    res = wasme_async_wait(ctx, res);
 
     WASME_UART_DEBUG_PRINTF("UART read port: %d flags: 0x%x, %d bytes (%p)\r\n", handle, flags, *len, data);
 
     m3ApiReturn(res);
 }
 
+// Arguments for single buffer operations emulating scatter-gather transfers
+typedef struct {
+    int32_t handle;
+    uint32_t flags;
+} uart_iov_arg_t;
+
+static int32_t uart_iov_write(wasme_ctx_t* ctx, const void* arg, uint8_t* data, uint32_t len) {
+    const uart_iov_arg_t* a = (const uart_iov_arg_t*)arg;
+    return ctx->uart_drv->write(ctx->uart_drv_ctx, a->handle, a->flags, data, len);
+}
+
+static int32_t uart_iov_read(wasme_ctx_t* ctx, const void* arg, uint8_t* data, uint32_t len) {
+    const uart_iov_arg_t* a = (const uart_iov_arg_t*)arg;
+    return ctx->uart_drv->read(ctx->uart_drv_ctx, a->handle, a->flags, data, len);
+}
+
+m3ApiRawFunction(m3_uart_writev)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, flags)
+    m3ApiGetArg      (uint32_t, iovs_ptr)
+    m3ApiGetArg      (uint32_t, iovs_len)
+
+    WASME_UART_DEBUG_PRINTF("UART writev port: %d flags: 0x%x, iovs: 0x%x count: %d\r\n", handle, flags, iovs_ptr, iovs_len);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_iovec_t iov[WASME_MAX_IOVS];
+    int32_t res = wasme_iov_resolve(runtime, iovs_ptr, iovs_len, iov);
+    if (res) { m3ApiReturn(res); }
+
+    uart_iov_arg_t arg = { .handle = handle, .flags = flags };
+
+    if (ctx->uart_vec_drv && ctx->uart_vec_drv->writev) {
+        res = ctx->uart_vec_drv->writev(ctx->uart_vec_drv_ctx, handle, flags, iov, iovs_len);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    } else if (ctx->uart_drv->write) {
+        res = wasme_iov_fallback(ctx, true, iov, iovs_len, uart_iov_write, &arg);
+    } else {
+        res = __WASI_ERRNO_NOENT;
+    }
+
+    m3ApiReturn(res);
+}
+
+m3ApiRawFunction(m3_uart_readv)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, flags)
+    m3ApiGetArg      (uint32_t, iovs_ptr)
+    m3ApiGetArg      (uint32_t, iovs_len)
+
+    WASME_UART_DEBUG_PRINTF("UART readv port: %d flags: 0x%x, iovs: 0x%x count: %d\r\n", handle, flags, iovs_ptr, iovs_len);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_iovec_t iov[WASME_MAX_IOVS];
+    int32_t res = wasme_iov_resolve(runtime, iovs_ptr, iovs_len, iov);
+    if (res) { m3ApiReturn(res); }
+
+    uart_iov_arg_t arg = { .handle = handle, .flags = flags };
+
+    if (ctx->uart_vec_drv && ctx->uart_vec_drv->readv) {
+        res = ctx->uart_vec_drv->readv(ctx->uart_vec_drv_ctx, handle, flags, iov, iovs_len);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+    } else if (ctx->uart_drv->read) {
+        res = wasme_iov_fallback(ctx, false, iov, iovs_len, uart_iov_read, &arg);
+    } else {
+        res = __WASI_ERRNO_NOENT;
+    }
+
+    m3ApiReturn(res);
+}
+
+// Header words of a stream ring in guest memory
+#define STREAM_HEAD 0
+#define STREAM_TAIL 1
+#define STREAM_SIZE 2
+#define STREAM_DROPPED 3
+
+static wasme_uart_stream_t* uart_stream_find(wasme_ctx_t* ctx, int32_t handle) {
+    for (uint32_t i = 0; i < WASME_UART_MAX_STREAMS; i++) {
+        if (ctx->uart_streams[i].active && ctx->uart_streams[i].handle == handle) {
+            return &ctx->uart_streams[i];
+        }
+    }
+    return NULL;
+}
+
+// Resolve the ring header, NULL if memory no longer covers the ring
+static _Atomic uint32_t* uart_stream_hdr(wasme_uart_stream_t* stream) {
+    return (_Atomic uint32_t*)wasme_mem_range(stream->ctx->rt, stream->ring_ptr, WASME_UART_STREAM_HDR + stream->size);
+}
+
+uint32_t WASME_uart_stream_push(wasme_uart_stream_t* stream, const uint8_t* data, uint32_t len) {
+    if (!stream->active) {
+        return 0;
+    }
+
+    _Atomic uint32_t* hdr = uart_stream_hdr(stream);
+    if (!hdr) {
+        return 0;
+    }
+    uint8_t* ring = (uint8_t*)hdr + WASME_UART_STREAM_HDR;
+
+    uint32_t n = wasme_ring_push(hdr, ring, stream->size, data, len, false);
+
+    if (n < len) {
+        atomic_fetch_add_explicit(&hdr[STREAM_DROPPED], len - n, memory_order_relaxed);
+    }
+
+    // Wake a waiting guest, the exchange ensures only one side completes the wait
+    if (n && atomic_exchange(&stream->waiting, false)) {
+        WASME_async_complete(stream->ctx, 0);
+    }
+    if (n) {
+        wasme_poll_notify(stream->ctx);
+    }
+
+    return n;
+}
+
+m3ApiRawFunction(m3_uart_stream_open)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, ring_ptr)
+    m3ApiGetArg      (uint32_t, ring_len)
+
+    WASME_UART_DEBUG_PRINTF("UART stream open port: %d ring: 0x%x len: %d\r\n", handle, ring_ptr, ring_len);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_stream_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->uart_stream_drv->start) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle, streams are tracked by driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+    if (uart_stream_find(ctx, handle)) { m3ApiReturn(__WASI_ERRNO_BUSY); }
+
+    // Ring data must be a power of two for free-running indices
+    uint32_t size = ring_len > WASME_UART_STREAM_HDR ? ring_len - WASME_UART_STREAM_HDR : 0;
+    if (size == 0 || (size & (size - 1)) || (ring_ptr & 3)) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    _Atomic uint32_t* hdr = (_Atomic uint32_t*)wasme_mem_range(runtime, ring_ptr, ring_len);
+    if (!hdr) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    wasme_uart_stream_t* stream = NULL;
+    for (uint32_t i = 0; i < WASME_UART_MAX_STREAMS && !stream; i++) {
+        if (!ctx->uart_streams[i].active) {
+            stream = &ctx->uart_streams[i];
+        }
+    }
+    if (!stream) { m3ApiReturn(__WASI_ERRNO_NFILE); }
+
+    atomic_store(&hdr[STREAM_HEAD], 0);
+    atomic_store(&hdr[STREAM_TAIL], 0);
+    atomic_store(&hdr[STREAM_SIZE], size);
+    atomic_store(&hdr[STREAM_DROPPED], 0);
+
+    stream->ctx = ctx;
+    stream->handle = handle;
+    stream->ring_ptr = ring_ptr;
+    stream->size = size;
+    atomic_store(&stream->waiting, false);
+    stream->active = true;
+
+    int32_t res = ctx->uart_stream_drv->start(ctx->uart_stream_drv_ctx, handle, stream);
+    if (res != 0) {
+        stream->active = false;
+    }
+    wasme_mem_pin_update(ctx);
+
+    m3ApiReturn(res);
+}
+
+m3ApiRawFunction(m3_uart_stream_close)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+
+    WASME_UART_DEBUG_PRINTF("UART stream close port: %d\r\n", handle);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_stream_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_uart_stream_t* stream = uart_stream_find(ctx, handle);
+    if (!stream) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    // Driver stops pushing before the ring is released
+    int32_t res = 0;
+    if (ctx->uart_stream_drv->stop) {
+        res = ctx->uart_stream_drv->stop(ctx->uart_stream_drv_ctx, handle);
+    }
+    stream->active = false;
+    wasme_mem_pin_update(ctx);
+
+    m3ApiReturn(res);
+}
+
+m3ApiRawFunction(m3_uart_stream_wait)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_uart_stream_t* stream = uart_stream_find(ctx, handle);
+    if (!stream) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    _Atomic uint32_t* hdr = uart_stream_hdr(stream);
+    if (!hdr) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    // Flag waiting before re-checking so a concurrent push cannot be missed
+    atomic_store(&stream->waiting, true);
+
+    if (atomic_load(&hdr[STREAM_HEAD]) != atomic_load(&hdr[STREAM_TAIL])) {
+        if (atomic_exchange(&stream->waiting, false)) {
+            m3ApiReturn(0);
+        }
+        // Push claimed the wait and completes it below
+    }
+
+    // Park or block until the driver pushes data
+    int32_t res = wasme_async_wait(ctx, WASME_DRV_PENDING);
+
+    m3ApiReturn(res);
+}
+
+static wasme_uart_framer_t* uart_framer_find(wasme_ctx_t* ctx, int32_t handle) {
+    for (uint32_t i = 0; i < WASME_UART_MAX_FRAMERS; i++) {
+        if (ctx->uart_framers[i].active && ctx->uart_framers[i].handle == handle) {
+            return &ctx->uart_framers[i];
+        }
+    }
+    return NULL;
+}
+
+m3ApiRawFunction(m3_uart_frame_config)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, mode)
+    m3ApiGetArg      (uint32_t, param)
+    m3ApiGetArg      (uint32_t, crc)
+    m3ApiGetArg      (uint32_t, max_len)
+
+    WASME_UART_DEBUG_PRINTF("UART frame config port: %d mode: %d param: %d crc: %d max: %d\r\n", handle, mode, param, crc, max_len);
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (mode > WASME_FRAME_LEN || crc > WASME_FRAME_CRC32 || max_len == 0) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+    if (mode == WASME_FRAME_LEN && param != 1 && param != 2 && param != 4) { m3ApiReturn(__WASI_ERRNO_INVAL); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    // Reconfiguring replaces any existing decoder for the handle
+    wasme_uart_framer_t* framer = uart_framer_find(ctx, handle);
+    if (framer) {
+        free(framer->frame.buf);
+        framer->active = false;
+    } else {
+        for (uint32_t i = 0; i < WASME_UART_MAX_FRAMERS && !framer; i++) {
+            if (!ctx->uart_framers[i].active) {
+                framer = &ctx->uart_framers[i];
+            }
+        }
+        if (!framer) { m3ApiReturn(__WASI_ERRNO_NFILE); }
+    }
+
+    // Frame buffer includes room for a trailing CRC
+    uint32_t cap = max_len + 4;
+    uint8_t* buf = malloc(cap);
+    if (!buf) { m3ApiReturn(__WASI_ERRNO_NOMEM); }
+
+    wasme_frame_cfg_t cfg = {
+        .mode = (wasme_frame_mode_t)mode,
+        .param = (uint8_t)param,
+        .crc = (wasme_frame_crc_t)crc,
+    };
+    WASME_frame_init(&framer->frame, &cfg, buf, cap);
+
+    framer->handle = handle;
+    framer->active = true;
+
+    m3ApiReturn(0);
+}
+
+m3ApiRawFunction(m3_uart_read_frame)
+{
+    // Load arguments
+    m3ApiReturnType  (int32_t)
+    m3ApiGetArg      (int32_t, handle)
+    m3ApiGetArg      (uint32_t, flags)
+    m3ApiGetArg      (uint32_t, buf_ptr)
+    m3ApiGetArg      (uint32_t, buf_len)
+    m3ApiGetArgMem   (uint32_t*, frame_len)
+
+    // Fetch context bound at link time
+    wasme_ctx_t* ctx = (wasme_ctx_t*)_ctx->userdata;
+
+    // Check args are valid
+    if (!runtime) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+    if (!ctx->uart_drv) { m3ApiReturn(__WASI_ERRNO_NODEV); }
+    if (!ctx->uart_drv->read) { m3ApiReturn(__WASI_ERRNO_NOENT); }
+
+    // Resolve guest handle to driver handle
+    if (wasme_handle_get(ctx, WASME_HANDLE_UART, handle, &handle)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    uint8_t* data = wasme_mem_range(runtime, buf_ptr, buf_len);
+    if (!data || !wasme_mem_range(runtime, m3ApiPtrToOffset(frame_len), sizeof(uint32_t))) { m3ApiReturn(__WASI_ERRNO_FAULT); }
+
+    wasme_uart_framer_t* framer = uart_framer_find(ctx, handle);
+    if (!framer) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    wasme_frame_t* f = &framer->frame;
+    uint8_t chunk[64];
+    int32_t res;
+
+    // Pull from the driver until a frame completes, never reading past its end
+    // so following bytes stay with the driver for the next call
+    while (true) {
+        uint32_t want = WASME_frame_want(f);
+        if (want > sizeof(chunk)) {
+            want = sizeof(chunk);
+        }
+
+        res = ctx->uart_drv->read(ctx->uart_drv_ctx, handle, flags, chunk, want);
+
+        // Park the task if the driver completes asynchronously
+        res = wasme_async_wait(ctx, res);
+        if (res < 0) {
+            m3ApiReturn(res);
+        }
+
+        uint32_t consumed;
+        res = WASME_frame_feed(f, chunk, want, &consumed);
+        if (res != WASME_FRAME_MORE) {
+            break;
+        }
+    }
+
+    switch (res) {
+        case WASME_FRAME_READY:
+            break;
+        case WASME_FRAME_ERR_OVERFLOW:
+            m3ApiReturn(__WASI_ERRNO_MSGSIZE);
+        default:
+            m3ApiReturn(__WASI_ERRNO_ILSEQ);
+    }
+
+    if (f->frame_len > buf_len) { m3ApiReturn(__WASI_ERRNO_MSGSIZE); }
+
+    memcpy(data, f->buf, f->frame_len);
+    *frame_len = f->frame_len;
+
+    WASME_UART_DEBUG_PRINTF("UART read frame port: %d, %d bytes\r\n", handle, f->frame_len);
+
+    m3ApiReturn(0);
+}
+
 
 const static char* wasme_uart_mod = "uart";
 
 int32_t WASME_bind_uart(wasme_ctx_t* ctx, const uart_drv_t* drv, void* drv_ctx) {
     M3Result m3_res;
 
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_uart_mod, "init", "i(iiiii)", &m3_uart_init);
-    
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_uart_mod, "deinit", "i(i)", &m3_uart_deinit);
+    ctx->uart_drv = drv;
+    ctx->uart_drv_ctx = drv_ctx;
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "init", "i(iiiii)", &m3_uart_init, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_uart_mod, "write", "i(iii)", &m3_uart_write);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "deinit", "i(i)", &m3_uart_deinit, ctx);
     
-    m3_res = m3_LinkRawFunction(ctx->mod, wasme_uart_mod, "read", "i(iii)", &m3_uart_read);
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "write", "i(iii)", &m3_uart_write, ctx);
     
-    uart_drv = drv;
-    uart_drv_ctx = drv_ctx;
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "read", "i(iii)", &m3_uart_read, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "writev", "i(iiii)", &m3_uart_writev, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "readv", "i(iiii)", &m3_uart_readv, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "stream_open", "i(iii)", &m3_uart_stream_open, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "stream_close", "i(i)", &m3_uart_stream_close, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "stream_wait", "i(i)", &m3_uart_stream_wait, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "frame_config", "i(iiiii)", &m3_uart_frame_config, ctx);
+
+    m3_res = m3_LinkRawFunctionEx(ctx->mod, wasme_uart_mod, "read_frame", "i(iiiii)", &m3_uart_read_frame, ctx);
     
     return 0;
 }
+
+int32_t WASME_bind_uart_vec(wasme_ctx_t* ctx, const wasme_uart_vec_drv_t* drv, void* drv_ctx) {
+    // Used by the writev/readv functions linked in WASME_bind_uart
+    ctx->uart_vec_drv = drv;
+    ctx->uart_vec_drv_ctx = drv_ctx;
+
+    return 0;
+}
+
+int32_t WASME_bind_uart_stream(wasme_ctx_t* ctx, const wasme_uart_stream_drv_t* drv, void* drv_ctx) {
+    // Used by the stream functions linked in WASME_bind_uart
+    ctx->uart_stream_drv = drv;
+    ctx->uart_stream_drv_ctx = drv_ctx;
+
+    return 0;
+}
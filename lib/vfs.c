@@ -0,0 +1,973 @@
+
+#include "wasm3.h"
+#include "extra/wasi_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wasm_embedded/wasm3/vfs.h"
+#include "wasm_embedded/wasm3/internal.h"
+
+// Guest fd of the first file opened by the guest
+#define VFS_FILE_BASE (WASME_VFS_FD_BASE + WASME_VFS_MAX_MOUNTS)
+
+// Largest file size or offset, transfers report their length as int32_t
+#define VFS_SIZE_MAX INT32_MAX
+
+// Mounted filesystem
+typedef struct {
+    const wasme_vfs_ops_t* ops;
+    void* fs;
+    char path[WASME_VFS_PATH_MAX];
+} vfs_mount_t;
+
+// File or directory opened by the guest
+typedef struct {
+    bool used;
+    uint32_t mount;
+    void* node;
+    uint8_t type;
+    uint16_t fdflags;
+    bool readable;
+    bool writable;
+    uint64_t pos;
+} vfs_file_t;
+
+struct wasme_vfs_s {
+    uint32_t num_mounts;
+    vfs_mount_t mounts[WASME_VFS_MAX_MOUNTS];
+    vfs_file_t files[WASME_VFS_MAX_FILES];
+};
+
+int32_t WASME_vfs_mount(wasme_ctx_t* ctx, const char* path, const wasme_vfs_ops_t* ops, void* fs) {
+    if (!ops || !ops->root || !ops->lookup || !ops->stat || !ops->read || !ops->readdir) {
+        return -1;
+    }
+    if (strlen(path) >= WASME_VFS_PATH_MAX) {
+        return -1;
+    }
+
+    if (!ctx->vfs) {
+        ctx->vfs = calloc(1, sizeof(wasme_vfs_t));
+        if (!ctx->vfs) {
+            return -1;
+        }
+        ctx->wasi.vfs = ctx->vfs;
+    }
+
+    wasme_vfs_t* vfs = ctx->vfs;
+    if (vfs->num_mounts >= WASME_VFS_MAX_MOUNTS) {
+        return -1;
+    }
+
+    vfs_mount_t* m = &vfs->mounts[vfs->num_mounts++];
+    m->ops = ops;
+    m->fs = fs;
+    strcpy(m->path, path);
+
+    return 0;
+}
+
+void wasme_vfs_release(wasme_ctx_t* ctx) {
+    if (ctx->vfs) {
+        memset(ctx->vfs->files, 0, sizeof(ctx->vfs->files));
+    }
+}
+
+void wasme_vfs_deinit(wasme_ctx_t* ctx) {
+    free(ctx->vfs);
+    ctx->vfs = NULL;
+    ctx->wasi.vfs = NULL;
+}
+
+bool wasme_vfs_owns(wasme_vfs_t* vfs, uint32_t fd) {
+    return vfs && fd >= WASME_VFS_FD_BASE;
+}
+
+static vfs_file_t* vfs_file(wasme_vfs_t* vfs, uint32_t fd) {
+    if (fd < VFS_FILE_BASE || fd - VFS_FILE_BASE >= WASME_VFS_MAX_FILES) {
+        return NULL;
+    }
+
+    vfs_file_t* f = &vfs->files[fd - VFS_FILE_BASE];
+
+    return f->used ? f : NULL;
+}
+
+static vfs_mount_t* vfs_preopen(wasme_vfs_t* vfs, uint32_t fd) {
+    if (fd < WASME_VFS_FD_BASE || fd - WASME_VFS_FD_BASE >= vfs->num_mounts) {
+        return NULL;
+    }
+
+    return &vfs->mounts[fd - WASME_VFS_FD_BASE];
+}
+
+uint32_t wasme_vfs_prestat(wasme_vfs_t* vfs, uint32_t fd, const char** path) {
+    vfs_mount_t* m = vfs_preopen(vfs, fd);
+    if (!m) {
+        return __WASI_ERRNO_BADF;
+    }
+
+    *path = m->path;
+
+    return 0;
+}
+
+// Resolve a directory fd to its mount and node
+static uint32_t vfs_dir(wasme_vfs_t* vfs, uint32_t fd, uint32_t* mount, void** node) {
+    vfs_mount_t* m = vfs_preopen(vfs, fd);
+    if (m) {
+        *mount = fd - WASME_VFS_FD_BASE;
+        *node = m->ops->root(m->fs);
+        return 0;
+    }
+
+    vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) {
+        return __WASI_ERRNO_BADF;
+    }
+    if (f->type != WASME_VFS_DIR) {
+        return __WASI_ERRNO_NOTDIR;
+    }
+
+    *mount = f->mount;
+    *node = f->node;
+
+    return 0;
+}
+
+// Walk a relative path from `dir`, which it may not escape, creating the final
+// component as a file when `create` is set
+static uint32_t vfs_resolve(vfs_mount_t* m, void* dir, const char* path, uint32_t len, bool create, void** node) {
+    void* stack[WASME_VFS_DEPTH_MAX + 1];
+    uint32_t depth = 0;
+    uint32_t i = 0;
+
+    stack[0] = dir;
+
+    // Absolute paths are not relative to any capability
+    if (len && path[0] == '/') {
+        return __WASI_ERRNO_NOTCAPABLE;
+    }
+
+    while (i < len) {
+        uint32_t start = i;
+        while (i < len && path[i] != '/') {
+            i++;
+        }
+        uint32_t n = i - start;
+        while (i < len && path[i] == '/') {
+            i++;
+        }
+
+        if (n == 0 || (n == 1 && path[start] == '.')) {
+            continue;
+        }
+
+        if (n == 2 && path[start] == '.' && path[start + 1] == '.') {
+            if (depth == 0) {
+                return __WASI_ERRNO_NOTCAPABLE;
+            }
+            depth -= 1;
+            continue;
+        }
+
+        if (depth == WASME_VFS_DEPTH_MAX) {
+            return __WASI_ERRNO_NAMETOOLONG;
+        }
+
+        wasme_vfs_stat_t st;
+        int32_t res = m->ops->stat(m->fs, stack[depth], &st);
+        if (res < 0) {
+            return -res;
+        }
+        if (st.type != WASME_VFS_DIR) {
+            return __WASI_ERRNO_NOTDIR;
+        }
+
+        res = m->ops->lookup(m->fs, stack[depth], path + start, n, create && i >= len, &stack[depth + 1]);
+        if (res < 0) {
+            return -res;
+        }
+        depth += 1;
+    }
+
+    *node = stack[depth];
+
+    return 0;
+}
+
+uint32_t wasme_vfs_open(wasme_vfs_t* vfs, uint32_t dirfd, const char* path, uint32_t path_len,
+        uint32_t oflags, uint64_t rights, uint32_t fdflags, uint32_t* fd) {
+    uint32_t mount;
+    void* dir;
+    uint32_t res = vfs_dir(vfs, dirfd, &mount, &dir);
+    if (res) {
+        return res;
+    }
+
+    vfs_mount_t* m = &vfs->mounts[mount];
+
+    if ((oflags & __WASI_OFLAGS_TRUNC) && !m->ops->truncate) {
+        return __WASI_ERRNO_ROFS;
+    }
+
+    // Find a free slot before creating anything
+    uint32_t index = 0;
+    while (index < WASME_VFS_MAX_FILES && vfs->files[index].used) {
+        index++;
+    }
+    if (index == WASME_VFS_MAX_FILES) {
+        return __WASI_ERRNO_NFILE;
+    }
+
+    void* node;
+    res = vfs_resolve(m, dir, path, path_len, false, &node);
+    if (res == 0 && (oflags & __WASI_OFLAGS_CREAT) && (oflags & __WASI_OFLAGS_EXCL)) {
+        return __WASI_ERRNO_EXIST;
+    }
+    if (res == __WASI_ERRNO_NOENT && (oflags & __WASI_OFLAGS_CREAT)) {
+        if (!m->ops->write) {
+            return __WASI_ERRNO_ROFS;
+        }
+        res = vfs_resolve(m, dir, path, path_len, true, &node);
+    }
+    if (res) {
+        return res;
+    }
+
+    wasme_vfs_stat_t st;
+    int32_t r = m->ops->stat(m->fs, node, &st);
+    if (r < 0) {
+        return -r;
+    }
+
+    if ((oflags & __WASI_OFLAGS_DIRECTORY) && st.type != WASME_VFS_DIR) {
+        return __WASI_ERRNO_NOTDIR;
+    }
+    if (st.type == WASME_VFS_DIR && (oflags & __WASI_OFLAGS_TRUNC)) {
+        return __WASI_ERRNO_ISDIR;
+    }
+
+    // Rights are an upper bound, guests commonly request all of them, so write
+    // access is only granted where the filesystem and node support it
+    bool writable = (rights & __WASI_RIGHTS_FD_WRITE) && m->ops->write && st.type == WASME_VFS_FILE;
+
+    if (oflags & __WASI_OFLAGS_TRUNC) {
+        r = m->ops->truncate(m->fs, node, 0);
+        if (r < 0) {
+            return -r;
+        }
+    }
+
+    vfs->files[index] = (vfs_file_t){
+        .used = true,
+        .mount = mount,
+        .node = node,
+        .type = st.type,
+        .fdflags = (uint16_t)fdflags,
+        .readable = (rights & __WASI_RIGHTS_FD_READ) != 0,
+        .writable = writable,
+    };
+
+    *fd = VFS_FILE_BASE + index;
+
+    return 0;
+}
+
+uint32_t wasme_vfs_close(wasme_vfs_t* vfs, uint32_t fd) {
+    // Preopens stay open for the lifetime of the context
+    if (vfs_preopen(vfs, fd)) {
+        return __WASI_ERRNO_NOTSUP;
+    }
+
+    vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) {
+        return __WASI_ERRNO_BADF;
+    }
+
+    f->used = false;
+
+    return 0;
+}
+
+// Resolve a regular file fd
+static uint32_t vfs_regular(wasme_vfs_t* vfs, uint32_t fd, vfs_file_t** file, vfs_mount_t** mount) {
+    vfs_file_t* f = vfs_file(vfs, fd);
+    if (!f) {
+        return vfs_preopen(vfs, fd) ? __WASI_ERRNO_ISDIR : __WASI_ERRNO_BADF;
+    }
+    if (f->type == WASME_VFS_DIR) {
+        return __WASI_ERRNO_ISDIR;
+    }
+
+    *file = f;
+    *mount = &vfs->mounts[f->mount];
+
+    return 0;
+}
+
+uint32_t wasme_vfs_read(wasme_vfs_t* vfs, uint32_t fd, uint8_t* data, uint32_t len, const uint64_t* offset, uint32_t* n) {
+    vfs_file_t* f;
+    vfs_mount_t* m;
+    uint32_t res = vfs_regular(vfs, fd, &f, &m);
+    if (res) {
+        return res;
+    }
+    if (!f->readable) {
+        return __WASI_ERRNO_NOTCAPABLE;
+    }
+
+    int32_t r = m->ops->read(m->fs, f->node, offset ? *offset : f->pos, data, len);
+    if (r < 0) {
+        return -r;
+    }
+
+    // Positional reads leave the file position unchanged
+    if (!offset) {
+        f->pos += r;
+    }
+    *n = r;
+
+    return 0;
+}
+
+uint32_t wasme_vfs_write(wasme_vfs_t* vfs, uint32_t fd, const uint8_t* data, uint32_t len, const uint64_t* offset, uint32_t* n) {
+    vfs_file_t* f;
+    vfs_mount_t* m;
+    uint32_t res = vfs_regular(vfs, fd, &f, &m);
+    if (res) {
+        return res;
+    }
+    if (!f->writable) {
+        return __WASI_ERRNO_NOTCAPABLE;
+    }
+
+    uint64_t pos = f->pos;
+    if (offset) {
+        pos = *offset;
+    } else if (f->fdflags & __WASI_FDFLAGS_APPEND) {
+        wasme_vfs_stat_t st;
+        int32_t r = m->ops->stat(m->fs, f->node, &st);
+        if (r < 0) {
+            return -r;
+        }
+        pos = st.size;
+    }
+
+    int32_t r = m->ops->write(m->fs, f->node, pos, data, len);
+    if (r < 0) {
+        return -r;
+    }
+
+    if (!offset) {
+        f->pos = pos + r;
+    }
+    *n = r;
+
+    return 0;
+}
+
+uint32_t wasme_vfs_seek(wasme_vfs_t* vfs, uint32_t fd, int64_t offset, int whence, uint64_t* pos) {
+    vfs_file_t* f;
+    vfs_mount_t* m;
+    uint32_t res = vfs_regular(vfs, fd, &f, &m);
+    if (res) {
+        return res;
+    }
+
+    int64_t base;
+    switch (whence) {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = (int64_t)f->pos;
+        break;
+    case SEEK_END: {
+        wasme_vfs_stat_t st;
+        int32_t r = m->ops->stat(m->fs, f->node, &st);
+        if (r < 0) {
+            return -r;
+        }
+        base = (int64_t)st.size;
+        break;
+    }
+    default:
+        return __WASI_ERRNO_INVAL;
+    }
+
+    if ((offset < 0 && base + offset < 0) || (offset > 0 && base > INT64_MAX - offset)) {
+        return __WASI_ERRNO_INVAL;
+    }
+    if (base + offset > VFS_SIZE_MAX) {
+        return __WASI_ERRNO_FBIG;
+    }
+
+    f->pos = (uint64_t)(base + offset);
+    *pos = f->pos;
+
+    return 0;
+}
+
+uint32_t wasme_vfs_stat(wasme_vfs_t* vfs, uint32_t fd, wasme_vfs_stat_t* st, uint16_t* fdflags, bool* writable) {
+    vfs_mount_t* m = vfs_preopen(vfs, fd);
+    void* node;
+    uint16_t flags = 0;
+    bool w = false;
+
+    if (m) {
+        node = m->ops->root(m->fs);
+        w = m->ops->write != NULL;
+    } else {
+        vfs_file_t* f = vfs_file(vfs, fd);
+        if (!f) {
+            return __WASI_ERRNO_BADF;
+        }
+        m = &vfs->mounts[f->mount];
+        node = f->node;
+        flags = f->fdflags;
+        w = f->writable;
+    }
+
+    int32_t r = m->ops->stat(m->fs, node, st);
+    if (r < 0) {
+        return -r;
+    }
+
+    if (fdflags) {
+        *fdflags = flags;
+    }
+    if (writable) {
+        *writable = w;
+    }
+
+    return 0;
+}
+
+uint32_t wasme_vfs_readdir(wasme_vfs_t* vfs, uint32_t fd, uint8_t* buf, uint32_t len, uint64_t cookie, uint32_t* used) {
+    uint32_t mount;
+    void* dir;
+    uint32_t res = vfs_dir(vfs, fd, &mount, &dir);
+    if (res) {
+        return res;
+    }
+
+    vfs_mount_t* m = &vfs->mounts[mount];
+    uint32_t n = 0;
+
+    // Entries are packed as a dirent then the name, the last may be truncated
+    // in which case the guest retries from its cookie with a larger buffer
+    while (n < len) {
+        wasme_vfs_dirent_t ent;
+        int32_t r = m->ops->readdir(m->fs, dir, cookie, &ent);
+        if (r == -__WASI_ERRNO_NOENT) {
+            break;
+        }
+        if (r < 0) {
+            return -r;
+        }
+
+        __wasi_dirent_t d = {
+            .d_next = cookie + 1,
+            .d_ino = ent.ino,
+            .d_namlen = ent.name_len,
+            .d_type = ent.type,
+        };
+
+        uint32_t chunk = len - n < sizeof(d) ? len - n : sizeof(d);
+        memcpy(buf + n, &d, chunk);
+        n += chunk;
+
+        chunk = len - n < ent.name_len ? len - n : ent.name_len;
+        memcpy(buf + n, ent.name, chunk);
+        n += chunk;
+
+        cookie += 1;
+    }
+
+    *used = n;
+
+    return 0;
+}
+
+/*
+ * RAM filesystem
+ */
+
+typedef struct ramfs_node_s {
+    struct ramfs_node_s* parent;
+    struct ramfs_node_s* child;
+    struct ramfs_node_s* next;
+    uint8_t type;
+    uint64_t ino;
+    char* name;
+    uint32_t name_len;
+    uint8_t* data;
+    uint32_t size;
+    uint32_t cap;
+} ramfs_node_t;
+
+struct wasme_ramfs_s {
+    ramfs_node_t root;
+    // Total file storage allocated and the limit on it
+    uint32_t used;
+    uint32_t capacity;
+    uint64_t next_ino;
+};
+
+static ramfs_node_t* ramfs_find(ramfs_node_t* dir, const char* name, uint32_t name_len) {
+    for (ramfs_node_t* n = dir->child; n; n = n->next) {
+        if (n->name_len == name_len && memcmp(n->name, name, name_len) == 0) {
+            return n;
+        }
+    }
+
+    return NULL;
+}
+
+// Append a node so directory indices stay stable while the guest lists them
+static ramfs_node_t* ramfs_new(wasme_ramfs_t* fs, ramfs_node_t* dir, const char* name, uint32_t name_len, uint8_t type) {
+    ramfs_node_t* n = calloc(1, sizeof(ramfs_node_t));
+    if (!n) {
+        return NULL;
+    }
+
+    n->name = malloc(name_len);
+    if (!n->name) {
+        free(n);
+        return NULL;
+    }
+    memcpy(n->name, name, name_len);
+
+    n->name_len = name_len;
+    n->type = type;
+    n->ino = fs->next_ino++;
+    n->parent = dir;
+
+    ramfs_node_t** tail = &dir->child;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = n;
+
+    return n;
+}
+
+static void ramfs_free(ramfs_node_t* n) {
+    ramfs_node_t* child = n->child;
+    while (child) {
+        ramfs_node_t* next = child->next;
+        ramfs_free(child);
+        free(child);
+        child = next;
+    }
+
+    free(n->name);
+    free(n->data);
+}
+
+static void* ramfs_root(void* fs) {
+    return &((wasme_ramfs_t*)fs)->root;
+}
+
+static int32_t ramfs_lookup(void* fs, void* dir, const char* name, uint32_t name_len, bool create, void** node) {
+    ramfs_node_t* n = ramfs_find(dir, name, name_len);
+
+    if (!n && create) {
+        n = ramfs_new(fs, dir, name, name_len, WASME_VFS_FILE);
+        if (!n) {
+            return -__WASI_ERRNO_NOMEM;
+        }
+    }
+    if (!n) {
+        return -__WASI_ERRNO_NOENT;
+    }
+
+    *node = n;
+
+    return 0;
+}
+
+static int32_t ramfs_stat(void* fs, void* node, wasme_vfs_stat_t* stat) {
+    ramfs_node_t* n = node;
+    (void)fs;
+
+    stat->ino = n->ino;
+    stat->size = n->size;
+    stat->type = n->type;
+
+    return 0;
+}
+
+static int32_t ramfs_read(void* fs, void* node, uint64_t offset, uint8_t* data, uint32_t len) {
+    ramfs_node_t* n = node;
+    (void)fs;
+
+    if (offset >= n->size) {
+        return 0;
+    }
+    if (len > n->size - offset) {
+        len = n->size - (uint32_t)offset;
+    }
+    if (len > INT32_MAX) {
+        len = INT32_MAX;
+    }
+
+    memcpy(data, n->data + offset, len);
+
+    return (int32_t)len;
+}
+
+// Grow file storage to at least `size` bytes, doubling to limit reallocation
+static int32_t ramfs_reserve(wasme_ramfs_t* fs, ramfs_node_t* n, uint64_t size) {
+    if (size <= n->cap) {
+        return 0;
+    }
+    if (size > VFS_SIZE_MAX) {
+        return -__WASI_ERRNO_FBIG;
+    }
+
+    uint64_t cap = n->cap ? n->cap : 64;
+    while (cap < size) {
+        cap *= 2;
+    }
+    if (fs->used - n->cap + cap > fs->capacity) {
+        cap = size;
+    }
+    if (fs->used - n->cap + cap > fs->capacity) {
+        return -__WASI_ERRNO_NOSPC;
+    }
+
+    uint8_t* data = realloc(n->data, cap);
+    if (!data) {
+        return -__WASI_ERRNO_NOMEM;
+    }
+
+    fs->used = fs->used - n->cap + (uint32_t)cap;
+    n->data = data;
+    n->cap = (uint32_t)cap;
+
+    return 0;
+}
+
+static int32_t ramfs_write(void* fs, void* node, uint64_t offset, const uint8_t* data, uint32_t len) {
+    ramfs_node_t* n = node;
+
+    if (len > VFS_SIZE_MAX) {
+        len = VFS_SIZE_MAX;
+    }
+
+    // Guest offsets are unchecked (pwrite), reject any the file could not reach
+    // before they are used to size or index storage
+    if (offset > VFS_SIZE_MAX || offset + len > VFS_SIZE_MAX) {
+        return -__WASI_ERRNO_FBIG;
+    }
+
+    int32_t res = ramfs_reserve(fs, n, offset + len);
+    if (res < 0) {
+        return res;
+    }
+
+    // Writing past the end leaves a zeroed gap
+    if (offset > n->size) {
+        memset(n->data + n->size, 0, offset - n->size);
+    }
+    memcpy(n->data + offset, data, len);
+
+    if (offset + len > n->size) {
+        n->size = (uint32_t)(offset + len);
+    }
+
+    return (int32_t)len;
+}
+
+static int32_t ramfs_truncate(void* fs, void* node, uint64_t size) {
+    ramfs_node_t* n = node;
+
+    if (size > VFS_SIZE_MAX) {
+        return -__WASI_ERRNO_FBIG;
+    }
+
+    int32_t res = ramfs_reserve(fs, n, size);
+    if (res < 0) {
+        return res;
+    }
+
+    if (size > n->size) {
+        memset(n->data + n->size, 0, size - n->size);
+    }
+    n->size = (uint32_t)size;
+
+    return 0;
+}
+
+static int32_t ramfs_readdir(void* fs, void* dir, uint64_t index, wasme_vfs_dirent_t* entry) {
+    ramfs_node_t* n = ((ramfs_node_t*)dir)->child;
+    (void)fs;
+
+    while (n && index) {
+        n = n->next;
+        index--;
+    }
+    if (!n) {
+        return -__WASI_ERRNO_NOENT;
+    }
+
+    entry->ino = n->ino;
+    entry->type = n->type;
+    entry->name = n->name;
+    entry->name_len = n->name_len;
+
+    return 0;
+}
+
+static const wasme_vfs_ops_t ramfs_ops = {
+    .root = ramfs_root,
+    .lookup = ramfs_lookup,
+    .stat = ramfs_stat,
+    .read = ramfs_read,
+    .write = ramfs_write,
+    .truncate = ramfs_truncate,
+    .readdir = ramfs_readdir,
+};
+
+wasme_ramfs_t* WASME_ramfs_init(uint32_t capacity) {
+    wasme_ramfs_t* fs = calloc(1, sizeof(wasme_ramfs_t));
+    if (!fs) {
+        return NULL;
+    }
+
+    fs->root.type = WASME_VFS_DIR;
+    fs->root.ino = 1;
+    fs->next_ino = 2;
+    fs->capacity = capacity;
+
+    return fs;
+}
+
+int32_t WASME_ramfs_add(wasme_ramfs_t* fs, const char* path, const uint8_t* data, uint32_t len) {
+    ramfs_node_t* dir = &fs->root;
+    const char* p = path;
+
+    while (*p == '/') {
+        p++;
+    }
+
+    // Create missing parent directories
+    while (true) {
+        const char* end = strchr(p, '/');
+        if (!end) {
+            break;
+        }
+
+        if (end != p) {
+            ramfs_node_t* n = ramfs_find(dir, p, (uint32_t)(end - p));
+            if (!n) {
+                n = ramfs_new(fs, dir, p, (uint32_t)(end - p), WASME_VFS_DIR);
+            }
+            if (!n || n->type != WASME_VFS_DIR) {
+                return -1;
+            }
+            dir = n;
+        }
+        p = end + 1;
+    }
+
+    if (!*p) {
+        return -1;
+    }
+
+    void* node;
+    if (ramfs_lookup(fs, dir, p, (uint32_t)strlen(p), true, &node) < 0) {
+        return -1;
+    }
+    if (((ramfs_node_t*)node)->type != WASME_VFS_FILE) {
+        return -1;
+    }
+
+    if (ramfs_truncate(fs, node, 0) < 0 || (len && ramfs_write(fs, node, 0, data, len) < 0)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t WASME_vfs_mount_ramfs(wasme_ctx_t* ctx, const char* path, wasme_ramfs_t* fs) {
+    return WASME_vfs_mount(ctx, path, &ramfs_ops, fs);
+}
+
+void WASME_ramfs_deinit(wasme_ramfs_t** fs) {
+    if (!*fs) {
+        return;
+    }
+
+    ramfs_free(&(*fs)->root);
+    free(*fs);
+
+    *fs = NULL;
+}
+
+/*
+ * Image filesystem
+ */
+
+// Entries are copied out as images need not be aligned, fields are little-endian as are all supported targets
+static void imgfs_entry(const wasme_imgfs_t* fs, uint32_t index, wasme_imgfs_entry_t* entry) {
+    memcpy(entry, fs->image + sizeof(wasme_imgfs_hdr_t) + index * sizeof(wasme_imgfs_entry_t), sizeof(*entry));
+}
+
+// Nodes are entry indices offset by one so the root is not NULL
+static uint32_t imgfs_index(void* node) {
+    return (uint32_t)((uintptr_t)node - 1);
+}
+
+static void* imgfs_node(uint32_t index) {
+    return (void*)((uintptr_t)index + 1);
+}
+
+static void* imgfs_root(void* fs) {
+    (void)fs;
+    return imgfs_node(0);
+}
+
+static int32_t imgfs_lookup(void* fs, void* dir, const char* name, uint32_t name_len, bool create, void** node) {
+    const wasme_imgfs_t* img = fs;
+    uint32_t parent = imgfs_index(dir);
+
+    for (uint32_t i = 1; i < img->num_entries; i++) {
+        wasme_imgfs_entry_t e;
+        imgfs_entry(img, i, &e);
+
+        if (e.parent == parent && e.name_len == name_len && memcmp(img->image + e.name_off, name, name_len) == 0) {
+            *node = imgfs_node(i);
+            return 0;
+        }
+    }
+
+    return create ? -__WASI_ERRNO_ROFS : -__WASI_ERRNO_NOENT;
+}
+
+static int32_t imgfs_stat(void* fs, void* node, wasme_vfs_stat_t* stat) {
+    wasme_imgfs_entry_t e;
+    imgfs_entry(fs, imgfs_index(node), &e);
+
+    stat->ino = imgfs_index(node) + 1;
+    stat->size = e.type == WASME_VFS_FILE ? e.size : 0;
+    stat->type = (uint8_t)e.type;
+
+    return 0;
+}
+
+static int32_t imgfs_read(void* fs, void* node, uint64_t offset, uint8_t* data, uint32_t len) {
+    const wasme_imgfs_t* img = fs;
+    wasme_imgfs_entry_t e;
+    imgfs_entry(img, imgfs_index(node), &e);
+
+    if (offset >= e.size) {
+        return 0;
+    }
+    if (len > e.size - offset) {
+        len = e.size - (uint32_t)offset;
+    }
+    if (len > INT32_MAX) {
+        len = INT32_MAX;
+    }
+
+    // Copied straight from the image into guest memory
+    memcpy(data, img->image + e.data_off + offset, len);
+
+    return (int32_t)len;
+}
+
+static int32_t imgfs_readdir(void* fs, void* dir, uint64_t index, wasme_vfs_dirent_t* entry) {
+    const wasme_imgfs_t* img = fs;
+    uint32_t parent = imgfs_index(dir);
+
+    for (uint32_t i = 1; i < img->num_entries; i++) {
+        wasme_imgfs_entry_t e;
+        imgfs_entry(img, i, &e);
+
+        if (e.parent != parent) {
+            continue;
+        }
+        if (index) {
+            index--;
+            continue;
+        }
+
+        entry->ino = i + 1;
+        entry->type = (uint8_t)e.type;
+        entry->name = (const char*)img->image + e.name_off;
+        entry->name_len = e.name_len;
+
+        return 0;
+    }
+
+    return -__WASI_ERRNO_NOENT;
+}
+
+static const wasme_vfs_ops_t imgfs_ops = {
+    .root = imgfs_root,
+    .lookup = imgfs_lookup,
+    .stat = imgfs_stat,
+    .read = imgfs_read,
+    .readdir = imgfs_readdir,
+};
+
+int32_t WASME_imgfs_init(wasme_imgfs_t* fs, const uint8_t* image, uint32_t len) {
+    wasme_imgfs_hdr_t hdr;
+
+    if (len < sizeof(hdr)) {
+        return -1;
+    }
+    memcpy(&hdr, image, sizeof(hdr));
+
+    if (hdr.magic != WASME_IMGFS_MAGIC || hdr.version != WASME_IMGFS_VERSION || hdr.num_entries == 0) {
+        return -1;
+    }
+    if ((uint64_t)hdr.num_entries * sizeof(wasme_imgfs_entry_t) > len - sizeof(hdr)) {
+        return -1;
+    }
+
+    fs->image = image;
+    fs->len = len;
+    fs->num_entries = hdr.num_entries;
+
+    // Check every entry once so lookups and reads need no bounds checks
+    for (uint32_t i = 0; i < hdr.num_entries; i++) {
+        wasme_imgfs_entry_t e;
+        imgfs_entry(fs, i, &e);
+
+        if (e.type != WASME_VFS_DIR && e.type != WASME_VFS_FILE) {
+            return -1;
+        }
+        if (i == 0 && e.type != WASME_VFS_DIR) {
+            return -1;
+        }
+        if ((uint64_t)e.name_off + e.name_len > len) {
+            return -1;
+        }
+        if (e.type == WASME_VFS_FILE && (uint64_t)e.data_off + e.size > len) {
+            return -1;
+        }
+
+        if (i != 0) {
+            wasme_imgfs_entry_t p;
+            if (e.parent >= hdr.num_entries) {
+                return -1;
+            }
+            imgfs_entry(fs, e.parent, &p);
+            if (p.type != WASME_VFS_DIR) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int32_t WASME_vfs_mount_imgfs(wasme_ctx_t* ctx, const char* path, wasme_imgfs_t* fs) {
+    return WASME_vfs_mount(ctx, path, &imgfs_ops, fs);
+}
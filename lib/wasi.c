@@ -8,6 +8,8 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "wasm_embedded/wasm3/wasi.h"
+#include "wasm_embedded/wasm3/core.h"
+#include "wasm_embedded/wasm3/internal.h"
 
 #include "m3_core.h"
 #include "m3_env.h"
@@ -25,7 +27,20 @@ typedef uint32_t __wasi_size_t;
 #include <fcntl.h>
 #include <unistd.h>
 
-static m3_wasi_context_t* wasi_context;
+// Guest iovecs are passed to readv/writev in a single call on posix hosts
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(WASME_NO_IOVEC)
+#  define HAS_IOVEC
+#  include <sys/uio.h>
+#endif
+
+// clock_gettime/clock_getres are only assumed on posix hosts, bare-metal newlib
+// declares them conditionally so targets there use the clock hook or clock()
+#if defined(__unix__) || defined(__APPLE__)
+#  define HAS_CLOCK_GETTIME
+#endif
+
+// Host iovecs per readv/writev call, well under any platform IOV_MAX
+#define WASI_IOV_BATCH 16
 
 typedef struct wasi_iovec_t
 {
@@ -90,10 +105,18 @@ __wasi_errno_t errno_to_wasi(int errnum) {
     return __WASI_ERRNO_INVAL;
 }
 
+#ifdef HAS_CLOCK_GETTIME
 static inline
-int convert_clockid(__wasi_clockid_t in) {
+clockid_t convert_clockid(__wasi_clockid_t in) {
     switch (in) {
-    case __WASI_CLOCKID_MONOTONIC:            return 0;
+    case __WASI_CLOCKID_REALTIME:             return CLOCK_REALTIME;
+    case __WASI_CLOCKID_MONOTONIC:            return CLOCK_MONOTONIC;
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    case __WASI_CLOCKID_PROCESS_CPUTIME_ID:   return CLOCK_PROCESS_CPUTIME_ID;
+#endif
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    case __WASI_CLOCKID_THREAD_CPUTIME_ID:    return CLOCK_THREAD_CPUTIME_ID;
+#endif
     default: return -1;
     }
 }
@@ -106,6 +129,19 @@ __wasi_timestamp_t convert_timespec(const struct timespec *ts) {
         return UINT64_MAX;
     return (__wasi_timestamp_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
 }
+#else
+// Only clock() processor time is available, standing in for the monotonic and process clocks
+static inline
+__wasi_errno_t check_clockid(__wasi_clockid_t in) {
+    switch (in) {
+    case __WASI_CLOCKID_MONOTONIC:
+    case __WASI_CLOCKID_PROCESS_CPUTIME_ID:   return __WASI_ERRNO_SUCCESS;
+    case __WASI_CLOCKID_REALTIME:
+    case __WASI_CLOCKID_THREAD_CPUTIME_ID:    return __WASI_ERRNO_NOSYS;
+    default: return __WASI_ERRNO_INVAL;
+    }
+}
+#endif
 
 
 /*
@@ -199,6 +235,18 @@ m3ApiRawFunction(m3_wasi_generic_fd_prestat_dir_name)
 
     m3ApiCheckMem(path, path_len);
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    // Preopens are the filesystems mounted in the VFS
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        const char* name;
+        __wasi_errno_t ret = wasme_vfs_prestat(context->vfs, fd, &name);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+        memcpy(path, name, M3_MIN(strlen(name), path_len));
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
     if (fd < 3 || fd >= PREOPEN_CNT) { m3ApiReturn(__WASI_ERRNO_BADF); }
     size_t slen = strlen(preopen[fd].path) + 1;
     memcpy(path, preopen[fd].path, M3_MIN(slen, path_len));
@@ -213,6 +261,18 @@ m3ApiRawFunction(m3_wasi_generic_fd_prestat_get)
 
     m3ApiCheckMem(buf, 8);
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        const char* name;
+        __wasi_errno_t ret = wasme_vfs_prestat(context->vfs, fd, &name);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+        m3ApiWriteMem32(buf+0, __WASI_PREOPENTYPE_DIR);
+        m3ApiWriteMem32(buf+4, strlen(name));
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
     if (fd < 3 || fd >= PREOPEN_CNT) { m3ApiReturn(__WASI_ERRNO_BADF); }
 
     m3ApiWriteMem32(buf+0, __WASI_PREOPENTYPE_DIR);
@@ -228,6 +288,25 @@ m3ApiRawFunction(m3_wasi_generic_fd_fdstat_get)
 
     m3ApiCheckMem(fdstat, sizeof(__wasi_fdstat_t));
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        wasme_vfs_stat_t st;
+        uint16_t flags;
+        bool writable;
+        __wasi_errno_t ret = wasme_vfs_stat(context->vfs, fd, &st, &flags, &writable);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+        fdstat->fs_filetype = st.type;
+        m3ApiWriteMem16(&fdstat->fs_flags, flags);
+        fdstat->fs_rights_base = (uint64_t)-1;
+        if (!writable) {
+            fdstat->fs_rights_base &= ~__WASI_RIGHTS_FD_WRITE;
+        }
+        fdstat->fs_rights_inheriting = (uint64_t)-1;
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
     struct stat fd_stat;
     int fl = fcntl(fd, F_GETFL);
     if (fl < 0) { m3ApiReturn(errno_to_wasi(errno)); }
@@ -287,6 +366,16 @@ m3ApiRawFunction(m3_wasi_unstable_fd_seek)
     default:                m3ApiReturn(__WASI_ERRNO_INVAL);
     }
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        __wasi_filesize_t pos;
+        __wasi_errno_t err = wasme_vfs_seek(context->vfs, fd, offset, whence, &pos);
+        if (err != __WASI_ERRNO_SUCCESS) m3ApiReturn(err);
+        m3ApiWriteMem64(result, pos);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
     int64_t ret;
     ret = lseek(fd, offset, whence);
     if (ret < 0) { m3ApiReturn(errno_to_wasi(errno)); }
@@ -313,6 +402,16 @@ m3ApiRawFunction(m3_wasi_snapshot_preview1_fd_seek)
     default:                m3ApiReturn(__WASI_ERRNO_INVAL);
     }
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        __wasi_filesize_t pos;
+        __wasi_errno_t err = wasme_vfs_seek(context->vfs, fd, offset, whence, &pos);
+        if (err != __WASI_ERRNO_SUCCESS) m3ApiReturn(err);
+        m3ApiWriteMem64(result, pos);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
     int64_t ret;
     ret = lseek(fd, offset, whence);
     if (ret < 0) { m3ApiReturn(errno_to_wasi(errno)); }
@@ -346,6 +445,19 @@ m3ApiRawFunction(m3_wasi_generic_path_open)
     memcpy (host_path, path, path_len);
     host_path[path_len] = '\0'; // NULL terminator
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    // Paths are only opened within filesystems mounted in the VFS
+    if (context && wasme_vfs_owns(context->vfs, dirfd)) {
+        __wasi_fd_t new_fd;
+        __wasi_errno_t ret = wasme_vfs_open(context->vfs, dirfd, host_path, path_len,
+                oflags, fs_rights_base, fs_flags, &new_fd);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+        m3ApiWriteMem32(fd, new_fd);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
     // TODO
     m3ApiReturn(__WASI_ERRNO_NOSYS);
 }
@@ -361,17 +473,60 @@ m3ApiRawFunction(m3_wasi_generic_fd_read)
     m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
     m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
     ssize_t res = 0;
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        for (__wasi_size_t i = 0; i < iovs_len; i++) {
+            void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
+            size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
+            if (len == 0) continue;
+            m3ApiCheckMem(addr, len);
+
+            __wasi_size_t n;
+            __wasi_errno_t ret = wasme_vfs_read(context->vfs, fd, addr, len, NULL, &n);
+            if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+            res += n;
+            if (n < len) break;
+        }
+        m3ApiWriteMem32(nread, res);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
+#if defined(HAS_IOVEC)
+    struct iovec iovs[WASI_IOV_BATCH];
+
+    // One readv per batch, further batches only follow a complete transfer
+    for (__wasi_size_t i = 0; i < iovs_len; i += WASI_IOV_BATCH) {
+        __wasi_size_t n = iovs_len - i < WASI_IOV_BATCH ? iovs_len - i : WASI_IOV_BATCH;
+        size_t total = 0;
+
+        for (__wasi_size_t j = 0; j < n; j++) {
+            iovs[j].iov_base = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i + j].buf));
+            iovs[j].iov_len  = m3ApiReadMem32(&wasi_iovs[i + j].buf_len);
+            m3ApiCheckMem(iovs[j].iov_base, iovs[j].iov_len);
+            total += iovs[j].iov_len;
+        }
+
+        ssize_t ret = readv (fd, iovs, n);
+        if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
+        res += ret;
+        if ((size_t)ret < total) break;
+    }
+#else
     for (__wasi_size_t i = 0; i < iovs_len; i++) {
         void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
         size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
         if (len == 0) continue;
+        m3ApiCheckMem(addr, len);
 
         int ret = read (fd, addr, len);
         if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
         res += ret;
         if ((size_t)ret < len) break;
     }
+#endif
     m3ApiWriteMem32(nread, res);
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
 }
@@ -387,26 +542,233 @@ m3ApiRawFunction(m3_wasi_generic_fd_write)
     m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
     m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
     ssize_t res = 0;
+
+    // Console output is buffered by the context sink rather than written per call
+    if ((fd == 1 || fd == 2) && context && context->console_write) {
+        for (__wasi_size_t i = 0; i < iovs_len; i++) {
+            void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
+            size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
+            if (len == 0) continue;
+            m3ApiCheckMem(addr, len);
+
+            res += context->console_write(context->console_arg, fd, addr, len);
+        }
+        m3ApiWriteMem32(nwritten, res);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        for (__wasi_size_t i = 0; i < iovs_len; i++) {
+            void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
+            size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
+            if (len == 0) continue;
+            m3ApiCheckMem(addr, len);
+
+            __wasi_size_t n;
+            __wasi_errno_t ret = wasme_vfs_write(context->vfs, fd, addr, len, NULL, &n);
+            if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+            res += n;
+            if (n < len) break;
+        }
+        m3ApiWriteMem32(nwritten, res);
+        m3ApiReturn(__WASI_ERRNO_SUCCESS);
+    }
+
+#if defined(HAS_IOVEC)
+    struct iovec iovs[WASI_IOV_BATCH];
+
+    // One writev per batch, further batches only follow a complete transfer
+    for (__wasi_size_t i = 0; i < iovs_len; i += WASI_IOV_BATCH) {
+        __wasi_size_t n = iovs_len - i < WASI_IOV_BATCH ? iovs_len - i : WASI_IOV_BATCH;
+        size_t total = 0;
+
+        for (__wasi_size_t j = 0; j < n; j++) {
+            iovs[j].iov_base = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i + j].buf));
+            iovs[j].iov_len  = m3ApiReadMem32(&wasi_iovs[i + j].buf_len);
+            m3ApiCheckMem(iovs[j].iov_base, iovs[j].iov_len);
+            total += iovs[j].iov_len;
+        }
+
+        ssize_t ret = writev (fd, iovs, n);
+        if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
+        res += ret;
+        if ((size_t)ret < total) break;
+    }
+#else
     for (__wasi_size_t i = 0; i < iovs_len; i++) {
         void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
         size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
         if (len == 0) continue;
+        m3ApiCheckMem(addr, len);
 
         int ret = write (fd, addr, len);
         if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
         res += ret;
         if ((size_t)ret < len) break;
     }
+#endif
     m3ApiWriteMem32(nwritten, res);
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
 }
 
+m3ApiRawFunction(m3_wasi_generic_fd_pread)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArg      (__wasi_filesize_t    , offset)
+    m3ApiGetArgMem   (__wasi_size_t *      , nread)
+
+    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
+    m3ApiCheckMem(nread,        sizeof(__wasi_size_t));
+
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+    bool vfs = context && wasme_vfs_owns(context->vfs, fd);
+
+    ssize_t res = 0;
+    for (__wasi_size_t i = 0; i < iovs_len; i++) {
+        void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
+        size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
+        if (len == 0) continue;
+        m3ApiCheckMem(addr, len);
+
+        __wasi_filesize_t pos = offset + res;
+        __wasi_size_t n;
+        if (vfs) {
+            __wasi_errno_t ret = wasme_vfs_read(context->vfs, fd, addr, len, &pos, &n);
+            if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+        } else {
+            ssize_t ret = pread (fd, addr, len, pos);
+            if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
+            n = ret;
+        }
+        res += n;
+        if (n < len) break;
+    }
+    m3ApiWriteMem32(nread, res);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_fd_pwrite)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (wasi_iovec_t *       , wasi_iovs)
+    m3ApiGetArg      (__wasi_size_t        , iovs_len)
+    m3ApiGetArg      (__wasi_filesize_t    , offset)
+    m3ApiGetArgMem   (__wasi_size_t *      , nwritten)
+
+    m3ApiCheckMem(wasi_iovs,    iovs_len * sizeof(wasi_iovec_t));
+    m3ApiCheckMem(nwritten,     sizeof(__wasi_size_t));
+
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+    bool vfs = context && wasme_vfs_owns(context->vfs, fd);
+
+    ssize_t res = 0;
+    for (__wasi_size_t i = 0; i < iovs_len; i++) {
+        void* addr = m3ApiOffsetToPtr(m3ApiReadMem32(&wasi_iovs[i].buf));
+        size_t len = m3ApiReadMem32(&wasi_iovs[i].buf_len);
+        if (len == 0) continue;
+        m3ApiCheckMem(addr, len);
+
+        __wasi_filesize_t pos = offset + res;
+        __wasi_size_t n;
+        if (vfs) {
+            __wasi_errno_t ret = wasme_vfs_write(context->vfs, fd, addr, len, &pos, &n);
+            if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+        } else {
+            ssize_t ret = pwrite (fd, addr, len, pos);
+            if (ret < 0) m3ApiReturn(errno_to_wasi(errno));
+            n = ret;
+        }
+        res += n;
+        if (n < len) break;
+    }
+    m3ApiWriteMem32(nwritten, res);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_fd_readdir)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (uint8_t *            , buf)
+    m3ApiGetArg      (__wasi_size_t        , buf_len)
+    m3ApiGetArg      (__wasi_dircookie_t   , cookie)
+    m3ApiGetArgMem   (__wasi_size_t *      , bufused)
+
+    m3ApiCheckMem(buf,          buf_len);
+    m3ApiCheckMem(bufused,      sizeof(__wasi_size_t));
+
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    // Host directories are not exposed
+    if (!context || !wasme_vfs_owns(context->vfs, fd)) { m3ApiReturn(__WASI_ERRNO_BADF); }
+
+    __wasi_size_t used;
+    __wasi_errno_t ret = wasme_vfs_readdir(context->vfs, fd, buf, buf_len, cookie, &used);
+    if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+    m3ApiWriteMem32(bufused, used);
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
+m3ApiRawFunction(m3_wasi_generic_fd_filestat_get)
+{
+    m3ApiReturnType  (uint32_t)
+    m3ApiGetArg      (__wasi_fd_t          , fd)
+    m3ApiGetArgMem   (uint8_t *            , buf)
+
+    m3ApiCheckMem(buf, sizeof(__wasi_filestat_t));
+
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    __wasi_filestat_t st = { 0 };
+    st.nlink = 1;
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        wasme_vfs_stat_t vst;
+        __wasi_errno_t ret = wasme_vfs_stat(context->vfs, fd, &vst, NULL, NULL);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+        st.ino = vst.ino;
+        st.filetype = vst.type;
+        st.size = vst.size;
+    } else {
+        struct stat fd_stat;
+        if (fstat(fd, &fd_stat) < 0) { m3ApiReturn(errno_to_wasi(errno)); }
+
+        int mode = fd_stat.st_mode;
+        st.dev = fd_stat.st_dev;
+        st.ino = fd_stat.st_ino;
+        st.filetype = S_ISDIR(mode) ? __WASI_FILETYPE_DIRECTORY :
+                      S_ISREG(mode) ? __WASI_FILETYPE_REGULAR_FILE :
+                      S_ISCHR(mode) ? __WASI_FILETYPE_CHARACTER_DEVICE :
+                      S_ISBLK(mode) ? __WASI_FILETYPE_BLOCK_DEVICE :
+                      S_ISLNK(mode) ? __WASI_FILETYPE_SYMBOLIC_LINK : __WASI_FILETYPE_UNKNOWN;
+        st.nlink = fd_stat.st_nlink;
+        st.size = fd_stat.st_size;
+    }
+
+    memcpy(buf, &st, sizeof(st));
+    m3ApiReturn(__WASI_ERRNO_SUCCESS);
+}
+
 m3ApiRawFunction(m3_wasi_generic_fd_close)
 {
     m3ApiReturnType  (uint32_t)
     m3ApiGetArg      (__wasi_fd_t, fd)
 
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    if (context && wasme_vfs_owns(context->vfs, fd)) {
+        m3ApiReturn(wasme_vfs_close(context->vfs, fd));
+    }
+
     int ret = close(fd);
     m3ApiReturn(ret == 0 ? __WASI_ERRNO_SUCCESS : ret);
 }
@@ -461,6 +823,37 @@ m3ApiRawFunction(m3_wasi_generic_random_get)
     }
 }
 
+u32 m3_wasi_clock_time_get(m3_wasi_context_t* context, u32 clock_id, u64* time)
+{
+    // Host hook takes precedence, for targets without clock_gettime
+    if (context && context->clock) {
+        return context->clock->time_get(context->clock_arg, clock_id, time);
+    }
+
+#ifdef HAS_CLOCK_GETTIME
+    clockid_t clk = convert_clockid(clock_id);
+    if (clk == (clockid_t)-1) return __WASI_ERRNO_INVAL;
+
+    // Served from the vDSO on linux without entering the kernel
+    struct timespec ts;
+    if (clock_gettime(clk, &ts) != 0) {
+        return errno_to_wasi(errno);
+    }
+
+    *time = convert_timespec(&ts);
+#else
+    __wasi_errno_t ret = check_clockid(clock_id);
+    if (ret != __WASI_ERRNO_SUCCESS) return ret;
+
+    clock_t t = clock();
+    if (t == (clock_t)-1) return __WASI_ERRNO_NOSYS;
+
+    *time = (uint64_t)t * 1000000000 / CLOCKS_PER_SEC;
+#endif
+
+    return __WASI_ERRNO_SUCCESS;
+}
+
 m3ApiRawFunction(m3_wasi_generic_clock_res_get)
 {
     m3ApiReturnType  (uint32_t)
@@ -469,10 +862,34 @@ m3ApiRawFunction(m3_wasi_generic_clock_res_get)
 
     m3ApiCheckMem(resolution, sizeof(__wasi_timestamp_t));
 
-    // TODO: proper impl here for multiple clocks / fix wasi binding mechanism?
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
 
-    clock_t t = clock();
-    m3ApiWriteMem64(resolution, (uint64_t)1000000 / CLOCKS_PER_SEC);
+    __wasi_timestamp_t res = 0;
+
+    if (context && context->clock) {
+        __wasi_errno_t ret = context->clock->res_get(context->clock_arg, wasi_clk_id, &res);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+    } else {
+#ifdef HAS_CLOCK_GETTIME
+        clockid_t clk = convert_clockid(wasi_clk_id);
+        if (clk == (clockid_t)-1) m3ApiReturn(__WASI_ERRNO_INVAL);
+
+        struct timespec tp;
+        if (clock_getres(clk, &tp) != 0) {
+            m3ApiReturn(errno_to_wasi(errno));
+        }
+
+        res = convert_timespec(&tp);
+#else
+        __wasi_errno_t ret = check_clockid(wasi_clk_id);
+        if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+        res = (uint64_t)1000000000 / CLOCKS_PER_SEC;
+#endif
+    }
+
+    m3ApiWriteMem64(resolution, res);
 
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
 }
@@ -486,10 +903,16 @@ m3ApiRawFunction(m3_wasi_generic_clock_time_get)
 
     m3ApiCheckMem(time, sizeof(__wasi_timestamp_t));
 
-    // TODO: proper impl here for multiple clocks / fix wasi binding mechanism?
+    m3_wasi_context_t* context = (m3_wasi_context_t*)(_ctx->userdata);
+
+    // Precision is a hint, clocks are always read at full resolution
+    (void)precision;
 
-    clock_t t = clock();
-    m3ApiWriteMem64(time, (uint64_t)t * 1000000 / CLOCKS_PER_SEC);
+    __wasi_timestamp_t t = 0;
+    __wasi_errno_t ret = m3_wasi_clock_time_get(context, wasi_clk_id, &t);
+    if (ret != __WASI_ERRNO_SUCCESS) m3ApiReturn(ret);
+
+    m3ApiWriteMem64(time, t);
 
     m3ApiReturn(__WASI_ERRNO_SUCCESS);
 }
@@ -517,30 +940,26 @@ M3Result SuppressLookupFailure(M3Result i_result)
         return i_result;
 }
 
-m3_wasi_context_t* m3_GetWasiContext()
-{
-    return wasi_context;
-}
-
-
-M3Result  m3_LinkWASI  (IM3Module module)
+M3Result  m3_LinkWASI  (IM3Module module, m3_wasi_context_t* wasi_context)
 {
     M3Result result = m3Err_none;
 
-    // TODO: Preopen dirs
+    // Preopen dirs are provided by filesystems mounted in the VFS
 
-    if (!wasi_context) {
-        wasi_context = (m3_wasi_context_t*)malloc(sizeof(m3_wasi_context_t));
-        wasi_context->exit_code = 0;
-        wasi_context->argc = 0;
-        wasi_context->argv = 0;
-    }
+    wasi_context->exit_code = 0;
+    wasi_context->argc = 0;
+    wasi_context->argv = 0;
+    wasi_context->clock = NULL;
+    wasi_context->clock_arg = NULL;
+    wasi_context->console_write = NULL;
+    wasi_context->console_arg = NULL;
+    wasi_context->vfs = NULL;
 
     static const char* namespaces[2] = { "wasi_unstable", "wasi_snapshot_preview1" };
 
     // fd_seek is incompatible
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_unstable",          "fd_seek",     "i(iIi*)", &m3_wasi_unstable_fd_seek)));
-_   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1", "fd_seek",     "i(iIi*)", &m3_wasi_snapshot_preview1_fd_seek)));
+_   (SuppressLookupFailure (m3_LinkRawFunctionEx (module, "wasi_unstable",          "fd_seek",     "i(iIi*)", &m3_wasi_unstable_fd_seek, wasi_context)));
+_   (SuppressLookupFailure (m3_LinkRawFunctionEx (module, "wasi_snapshot_preview1", "fd_seek",     "i(iIi*)", &m3_wasi_snapshot_preview1_fd_seek, wasi_context)));
 
     for (int i=0; i<2; i++)
     {
@@ -548,47 +967,48 @@ _   (SuppressLookupFailure (m3_LinkRawFunction (module, "wasi_snapshot_preview1"
 
 _       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_get",           "i(**)",   &m3_wasi_generic_args_get, wasi_context)));
 _       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "args_sizes_get",     "i(**)",   &m3_wasi_generic_args_sizes_get, wasi_context)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "clock_res_get",        "i(i*)",   &m3_wasi_generic_clock_res_get, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "clock_time_get",       "i(iI*)",  &m3_wasi_generic_clock_time_get, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "environ_get",          "i(**)",   &m3_wasi_generic_environ_get, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "environ_sizes_get",    "i(**)",   &m3_wasi_generic_environ_sizes_get, wasi_context)));
 
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_advise",            "i(iIIi)", )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_allocate",          "i(iII)",  )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_close",             "i(i)",    &m3_wasi_generic_fd_close, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_datasync",          "i(i)",    &m3_wasi_generic_fd_datasync, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_fdstat_get",        "i(i*)",   &m3_wasi_generic_fd_fdstat_get, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_fdstat_set_flags",  "i(ii)",   &m3_wasi_generic_fd_fdstat_set_flags, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_fdstat_set_rights", "i(iII)",  )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_get",      "i(i*)",   )));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_filestat_get",      "i(i*)",   &m3_wasi_generic_fd_filestat_get, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_size", "i(iI)",   )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_filestat_set_times","i(iIIi)", )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pread",             "i(i*iI*)",)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_pwrite",            "i(i*iI*)",)));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read)));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_readdir",           "i(i*iI*)",)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_pread",             "i(i*iI*)",&m3_wasi_generic_fd_pread, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_prestat_get",       "i(i*)",   &m3_wasi_generic_fd_prestat_get, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_prestat_dir_name",  "i(i*i)",  &m3_wasi_generic_fd_prestat_dir_name, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_pwrite",            "i(i*iI*)",&m3_wasi_generic_fd_pwrite, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_read",              "i(i*i*)", &m3_wasi_generic_fd_read, wasi_context)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_readdir",           "i(i*iI*)",&m3_wasi_generic_fd_readdir, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_renumber",          "i(ii)",   )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_sync",              "i(i)",    )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_tell",              "i(i*)",   )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "fd_write",             "i(i*i*)", &m3_wasi_generic_fd_write, wasi_context)));
 
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_create_directory",    "i(i*i)",       )));
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_filestat_get",        "i(ii*i*)",     &m3_wasi_generic_path_filestat_get)));
+//_     (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "path_filestat_get",        "i(ii*i*)",     &m3_wasi_generic_path_filestat_get, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_filestat_set_times",  "i(ii*iIIi)",   )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_link",                "i(ii*ii*i)",   )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "path_open",                "i(ii*iiIIi*)", &m3_wasi_generic_path_open, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_readlink",            "i(i*i*i*)",    )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_remove_directory",    "i(i*i)",       )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_rename",              "i(i*ii*i)",    )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_symlink",             "i(*ii*i)",     )));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "path_unlink_file",         "i(i*i)",       )));
 
-//_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "poll_oneoff",          "i(**i*)", &m3_wasi_generic_poll_oneoff)));
+// poll_oneoff waits on driver events and is linked per context in lib/poll.c
+//_     (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "poll_oneoff",          "i(**i*)", &m3_wasi_generic_poll_oneoff, wasi_context)));
 _       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "proc_exit",          "v(i)",    &m3_wasi_generic_proc_exit, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "proc_raise",           "i(i)",    )));
-_       (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get)));
+_       (SuppressLookupFailure (m3_LinkRawFunctionEx (module, wasi, "random_get",           "i(*i)",   &m3_wasi_generic_random_get, wasi_context)));
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sched_yield",          "i()",     )));
 
 //_     (SuppressLookupFailure (m3_LinkRawFunction (module, wasi, "sock_recv",            "i(i*ii**)",        )));
@@ -0,0 +1,131 @@
+
+use core::slice;
+use core::ops::{Deref, DerefMut};
+
+use crate::{
+    wasme_iovec_t, wasme_dma_pool_t,
+    WASME_dma_pool_init, WASME_dma_pool_deinit, WASME_dma_buf_size, WASME_dma_borrow, WASME_dma_return,
+};
+
+/// Guest buffer as (address, length, mutable) for alias checks
+pub(crate) type BufRange = (usize, usize, bool);
+
+/// Check whether a mutable buffer overlaps any other buffer. Guests may name
+/// the same memory more than once in a list, which must not be handed out as
+/// aliasing slices.
+pub(crate) fn bufs_alias<I>(bufs: I) -> bool
+where
+    I: Iterator<Item = BufRange> + Clone,
+{
+    bufs.clone().enumerate().any(|(i, (a, a_len, a_mut))| {
+        bufs.clone().skip(i + 1).any(|(b, b_len, b_mut)| {
+            (a_mut || b_mut) && a_len != 0 && b_len != 0 && a < b + b_len && b < a + a_len
+        })
+    })
+}
+
+/// Iterator over scatter-gather segments resolved from guest memory
+pub struct IoVecs<'a> {
+    pub(crate) iov: &'a [wasme_iovec_t],
+}
+
+impl<'a> Iterator for IoVecs<'a> {
+    type Item = &'a [u8];
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let (v, rest) = self.iov.split_first()?;
+        self.iov = rest;
+
+        // Segments are bounds checked against linear memory before the driver is called
+        Some(unsafe { slice::from_raw_parts(v.data, v.len as usize) })
+    }
+}
+
+/// Iterator over mutable scatter-gather segments resolved from guest memory
+pub struct IoVecsMut<'a> {
+    pub(crate) iov: &'a [wasme_iovec_t],
+}
+
+impl<'a> IoVecsMut<'a> {
+    /// Check whether any segments overlap, adaptors reject such lists
+    pub(crate) fn aliased(&self) -> bool {
+        bufs_alias(self.iov.iter().map(|v| (v.data as usize, v.len as usize, true)))
+    }
+}
+
+impl<'a> Iterator for IoVecsMut<'a> {
+    type Item = &'a mut [u8];
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let (v, rest) = self.iov.split_first()?;
+        self.iov = rest;
+
+        // Segments are bounds checked and checked not to overlap before the driver is called
+        Some(unsafe { slice::from_raw_parts_mut(v.data, v.len as usize) })
+    }
+}
+
+/// Pool of aligned bounce buffers for DMA, shared between drivers and contexts
+pub struct DmaPool {
+    pub(crate) pool: *mut wasme_dma_pool_t,
+}
+
+unsafe impl Send for DmaPool {}
+unsafe impl Sync for DmaPool {}
+
+impl DmaPool {
+    /// Allocate a pool of `count` buffers of at least `buf_size` bytes aligned to `align`
+    pub fn new(buf_size: u32, count: u32, align: u32) -> Option<Self> {
+        let pool = unsafe { WASME_dma_pool_init(core::ptr::null_mut(), 0, buf_size, count, align) };
+        if pool.is_null() {
+            return None;
+        }
+
+        Some(Self{ pool })
+    }
+
+    /// Borrow a buffer, returned to the pool on drop
+    pub fn borrow(&self) -> Option<DmaBuf<'_>> {
+        let data = unsafe { WASME_dma_borrow(self.pool) };
+        if data.is_null() {
+            return None;
+        }
+
+        let len = unsafe { WASME_dma_buf_size(self.pool) } as usize;
+
+        Some(DmaBuf{ pool: self, data, len })
+    }
+}
+
+impl Drop for DmaPool {
+    fn drop(&mut self) {
+        unsafe { WASME_dma_pool_deinit(&mut self.pool) }
+    }
+}
+
+/// Buffer borrowed from a [`DmaPool`]
+pub struct DmaBuf<'a> {
+    pool: &'a DmaPool,
+    data: *mut u8,
+    len: usize,
+}
+
+impl<'a> Deref for DmaBuf<'a> {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        unsafe { slice::from_raw_parts(self.data, self.len) }
+    }
+}
+
+impl<'a> DerefMut for DmaBuf<'a> {
+    fn deref_mut(&mut self) -> &mut [u8] {
+        unsafe { slice::from_raw_parts_mut(self.data, self.len) }
+    }
+}
+
+impl<'a> Drop for DmaBuf<'a> {
+    fn drop(&mut self) {
+        unsafe { WASME_dma_return(self.pool.pool, self.data) }
+    }
+}
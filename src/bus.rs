@@ -0,0 +1,74 @@
+
+use wasm_embedded_spec::{Spi, I2c, bindgen::{spi_drv_t, i2c_drv_t}};
+
+use crate::{
+    Driver, Wasm3Runtime, Wasm3Err,
+    wasme_bus_t, WASME_bus_init_spi, WASME_bus_init_i2c, WASME_bind_spi_bus, WASME_bind_i2c_bus,
+    WASME_bus_reconfigs, WASME_bus_deinit,
+};
+
+/// Bus manager sharing one SPI or I2C driver between runtimes, with cached
+/// device configurations and priority arbitration. The driver must outlive the
+/// bus and the bus must outlive runtimes bound to it.
+pub struct Bus {
+    pub(crate) bus: *mut wasme_bus_t,
+}
+
+unsafe impl Send for Bus {}
+
+// Shared use relies on the bus lock, which is only built with threads on posix hosts
+#[cfg(unix)]
+unsafe impl Sync for Bus {}
+
+impl Bus {
+    /// Create a bus manager for an SPI driver
+    pub fn spi<T: Spi>(drv: &mut T) -> Option<Self> {
+        let bus = unsafe { WASME_bus_init_spi(&<T as Driver<spi_drv_t>>::DRIVER, Driver::<spi_drv_t>::context(drv)) };
+        if bus.is_null() {
+            return None;
+        }
+
+        Some(Self{ bus })
+    }
+
+    /// Create a bus manager for an I2C driver
+    pub fn i2c<T: I2c>(drv: &mut T) -> Option<Self> {
+        let bus = unsafe { WASME_bus_init_i2c(&<T as Driver<i2c_drv_t>>::DRIVER, Driver::<i2c_drv_t>::context(drv)) };
+        if bus.is_null() {
+            return None;
+        }
+
+        Some(Self{ bus })
+    }
+
+    /// Bind an SPI bus to a runtime, arbitrating its transfers at `priority`
+    pub fn bind_spi(&self, rt: &mut Wasm3Runtime, priority: u32) -> Result<(), Wasm3Err> {
+        let res = unsafe { WASME_bind_spi_bus(rt.ctx, self.bus, priority) };
+        if res < 0 {
+            return Err(Wasm3Err::Spi(res));
+        }
+
+        Ok(())
+    }
+
+    /// Bind an I2C bus to a runtime, arbitrating its transfers at `priority`
+    pub fn bind_i2c(&self, rt: &mut Wasm3Runtime, priority: u32) -> Result<(), Wasm3Err> {
+        let res = unsafe { WASME_bind_i2c_bus(rt.ctx, self.bus, priority) };
+        if res < 0 {
+            return Err(Wasm3Err::I2c(res));
+        }
+
+        Ok(())
+    }
+
+    /// Number of times the controller has been reprogrammed
+    pub fn reconfigs(&self) -> u32 {
+        unsafe { WASME_bus_reconfigs(self.bus) }
+    }
+}
+
+impl Drop for Bus {
+    fn drop(&mut self) {
+        unsafe { WASME_bus_deinit(&mut self.bus) }
+    }
+}
@@ -0,0 +1,56 @@
+
+use core::ffi::c_void;
+
+use crate::{Driver, Wasm3Runtime, wasme_clock_t};
+
+/// WASI clock ids passed to [`HostClock`]
+pub const CLOCK_REALTIME: u32 = 0;
+pub const CLOCK_MONOTONIC: u32 = 1;
+pub const CLOCK_PROCESS_CPUTIME: u32 = 2;
+pub const CLOCK_THREAD_CPUTIME: u32 = 3;
+
+/// Host clock for targets without `clock_gettime`, errors are WASI errno values
+pub trait HostClock {
+    /// Current time of a clock in nanoseconds
+    fn now(&mut self, clock_id: u32) -> Result<u64, u32>;
+
+    /// Resolution of a clock in nanoseconds
+    fn resolution(&mut self, clock_id: u32) -> Result<u64, u32>;
+}
+
+/// Driver adaptor to C/wasm3 clock hook
+impl<T: HostClock> Driver<wasme_clock_t> for T {
+    const DRIVER: wasme_clock_t = wasme_clock_t {
+        time_get: Some(clock_time_get::<T>),
+        res_get: Some(clock_res_get::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_set_clock(rt.ctx, &Self::DRIVER, self.context()) };
+        0
+    }
+}
+
+pub extern "C" fn clock_time_get<T: HostClock>(ctx: *mut c_void, clock_id: u32, time: *mut u64) -> u32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match HostClock::now(ctx, clock_id) {
+        Ok(t) => {
+            unsafe { *time = t };
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+pub extern "C" fn clock_res_get<T: HostClock>(ctx: *mut c_void, clock_id: u32, res: *mut u64) -> u32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match HostClock::resolution(ctx, clock_id) {
+        Ok(r) => {
+            unsafe { *res = r };
+            0
+        }
+        Err(e) => e,
+    }
+}
@@ -0,0 +1,33 @@
+
+use core::ffi::c_void;
+
+use crate::{Driver, Wasm3Runtime, wasme_console_t};
+
+/// Console backend receiving buffered guest stdout (1) and stderr (2) output,
+/// called from the flush thread where one is available
+pub trait Console {
+    /// Write console output, returning the number of bytes written
+    fn write(&mut self, fd: u32, data: &[u8]) -> Result<usize, ()>;
+}
+
+/// Driver adaptor to C/wasm3 console sink, bound with the default line buffered policy
+impl<T: Console> Driver<wasme_console_t> for T {
+    const DRIVER: wasme_console_t = wasme_console_t {
+        write: Some(console_write::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_set_console(rt.ctx, &Self::DRIVER, self.context(), core::ptr::null()) }
+    }
+}
+
+pub extern "C" fn console_write<T: Console>(ctx: *mut c_void, fd: u32, data: *const u8, len: u32) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let data = unsafe { core::slice::from_raw_parts(data, len as usize) };
+
+    match Console::write(ctx, fd, data) {
+        Ok(n) => n.min(data.len()) as i32,
+        // Backends report no detail, any negative value drops the output
+        Err(_e) => -1,
+    }
+}
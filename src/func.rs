@@ -0,0 +1,117 @@
+
+use core::marker::PhantomData;
+
+use crate::{wasme_val_t, wasme_type_t, wasme_func_t};
+use crate::{
+    wasme_type_t_WASME_TYPE_I32, wasme_type_t_WASME_TYPE_I64,
+    wasme_type_t_WASME_TYPE_F32, wasme_type_t_WASME_TYPE_F64,
+    WASME_MAX_VALS,
+};
+
+/// Maximum number of arguments or results for a typed call
+pub const MAX_VALS: usize = WASME_MAX_VALS as usize;
+
+/// Value types that may be passed to or returned from WASM functions
+pub trait WasmType: Sized + Copy {
+    /// Matching WASME value type
+    const TYPE: wasme_type_t;
+
+    /// Convert to a tagged value
+    fn into_val(self) -> wasme_val_t;
+
+    /// Convert from a tagged value, returning None on type mismatch
+    fn from_val(v: &wasme_val_t) -> Option<Self>;
+}
+
+macro_rules! impl_wasm_type {
+    ($t:ty, $tag:ident, $field:ident) => {
+        impl WasmType for $t {
+            const TYPE: wasme_type_t = $tag;
+
+            fn into_val(self) -> wasme_val_t {
+                let mut v: wasme_val_t = unsafe { core::mem::zeroed() };
+                v.type_ = Self::TYPE;
+                v.of.$field = self;
+                v
+            }
+
+            fn from_val(v: &wasme_val_t) -> Option<Self> {
+                if v.type_ != Self::TYPE {
+                    return None;
+                }
+                Some(unsafe { v.of.$field })
+            }
+        }
+    };
+}
+
+impl_wasm_type!(i32, wasme_type_t_WASME_TYPE_I32, i32);
+impl_wasm_type!(i64, wasme_type_t_WASME_TYPE_I64, i64);
+impl_wasm_type!(f32, wasme_type_t_WASME_TYPE_F32, f32);
+impl_wasm_type!(f64, wasme_type_t_WASME_TYPE_F64, f64);
+
+/// Tuples of [`WasmType`] used as function arguments and results
+pub trait WasmTuple: Sized {
+    /// Number of values in the tuple
+    const COUNT: usize;
+
+    /// Write values into the provided buffer
+    fn into_vals(self, vals: &mut [wasme_val_t]);
+
+    /// Read values from the provided buffer, returning None on type mismatch
+    fn from_vals(vals: &[wasme_val_t]) -> Option<Self>;
+}
+
+impl WasmTuple for () {
+    const COUNT: usize = 0;
+
+    fn into_vals(self, _vals: &mut [wasme_val_t]) {}
+
+    fn from_vals(_vals: &[wasme_val_t]) -> Option<Self> {
+        Some(())
+    }
+}
+
+impl <A: WasmType> WasmTuple for A {
+    const COUNT: usize = 1;
+
+    fn into_vals(self, vals: &mut [wasme_val_t]) {
+        vals[0] = self.into_val();
+    }
+
+    fn from_vals(vals: &[wasme_val_t]) -> Option<Self> {
+        A::from_val(&vals[0])
+    }
+}
+
+macro_rules! impl_wasm_tuple {
+    ($n:expr, $($t:ident => $i:tt),+) => {
+        impl <$($t: WasmType),+> WasmTuple for ($($t,)+) {
+            const COUNT: usize = $n;
+
+            fn into_vals(self, vals: &mut [wasme_val_t]) {
+                $( vals[$i] = self.$i.into_val(); )+
+            }
+
+            fn from_vals(vals: &[wasme_val_t]) -> Option<Self> {
+                Some(( $( $t::from_val(&vals[$i])?, )+ ))
+            }
+        }
+    };
+}
+
+impl_wasm_tuple!(1, A => 0);
+impl_wasm_tuple!(2, A => 0, B => 1);
+impl_wasm_tuple!(3, A => 0, B => 1, C => 2);
+impl_wasm_tuple!(4, A => 0, B => 1, C => 2, D => 3);
+impl_wasm_tuple!(5, A => 0, B => 1, C => 2, D => 3, E => 4);
+impl_wasm_tuple!(6, A => 0, B => 1, C => 2, D => 3, E => 4, F => 5);
+
+/// Typed handle to an exported function, resolved once via [`crate::Wasm3Runtime::lookup`]
+/// and only callable on the runtime it was resolved on
+pub struct Wasm3Func<Args, Rets> {
+    pub(crate) func: *mut wasme_func_t,
+    // Identity of the owning runtime
+    pub(crate) rt: usize,
+    pub(crate) _t: PhantomData<fn(Args) -> Rets>,
+}
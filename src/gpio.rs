@@ -1,10 +1,15 @@
 
 use core::ffi::c_void;
 
-use wasm_embedded_spec::{Gpio, bindgen::gpio_drv_t};
+use wasm_embedded_spec::{Gpio, Error, bindgen::gpio_drv_t};
 use embedded_hal::digital::PinState;
 
-use crate::{Driver, Wasm3Runtime};
+use crate::{
+    Driver, Wasm3Runtime, WASI_ERRNO_IO, WASI_ERRNO_NOTSUP,
+    wasme_gpio_irq_drv_t, wasme_gpio_irq_t, WASME_gpio_irq_fire, WASME_gpio_irq_fire_at,
+    WASME_gpio_irq_fire_isr, WASME_gpio_irq_service,
+    wasme_gpio_port_drv_t, wasme_gpio_step_t,
+};
 
 /// Driver adaptor to C/wasm3 I2C API
 impl<T: Gpio> Driver<gpio_drv_t> for T {
@@ -89,6 +94,162 @@ pub extern "C" fn gpio_set<T: Gpio>(ctx: *const c_void, handle: i32, value: u32)
     }
 }
 
+
+/// Handle for reporting interrupts on a subscribed pin
+pub struct GpioIrqSource {
+    irq: *mut wasme_gpio_irq_t,
+}
+
+// Each subscription has its own ring so sources may report from another thread
+unsafe impl Send for GpioIrqSource {}
+
+impl GpioIrqSource {
+    /// Report an interrupt with the current pin state, timestamped by the host.
+    /// Wakes the guest directly so must not be called from interrupt context.
+    pub fn fire(&mut self, state: PinState) {
+        unsafe { WASME_gpio_irq_fire(self.irq, state as i32) }
+    }
+
+    /// Report an interrupt with a driver captured timestamp in nanoseconds,
+    /// not from interrupt context
+    pub fn fire_at(&mut self, state: PinState, timestamp: i64) {
+        unsafe { WASME_gpio_irq_fire_at(self.irq, state as i32, timestamp) }
+    }
+
+    /// Report an interrupt from interrupt context, the guest is woken by the
+    /// next [`GpioIrqSource::service`]
+    pub fn fire_isr(&mut self, state: PinState, timestamp: i64) {
+        unsafe { WASME_gpio_irq_fire_isr(self.irq, state as i32, timestamp) }
+    }
+
+    /// Wake the guest for events reported with [`GpioIrqSource::fire_isr`],
+    /// from thread context
+    pub fn service(&mut self) {
+        unsafe { WASME_gpio_irq_service(self.irq) }
+    }
+}
+
+/// GPIO extension for interrupt subscription, `triggers` is a mask of
+/// `WASME_GPIO_EDGE_*` / `WASME_GPIO_LEVEL_*`. The source must not be used
+/// after `unsubscribe` returns.
+pub trait GpioIrq {
+    fn subscribe(&mut self, handle: i32, triggers: u32, source: GpioIrqSource) -> Result<(), Error>;
+    fn unsubscribe(&mut self, handle: i32) -> Result<(), Error>;
+}
+
+/// Driver adaptor to C/wasm3 GPIO interrupt API
+impl<T: GpioIrq> Driver<wasme_gpio_irq_drv_t> for T {
+    const DRIVER: wasme_gpio_irq_drv_t = wasme_gpio_irq_drv_t {
+        subscribe: Some(gpio_subscribe::<T>),
+        unsubscribe: Some(gpio_unsubscribe::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_gpio_irq(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn gpio_subscribe<T: GpioIrq>(
+    ctx: *const c_void,
+    handle: i32,
+    triggers: u32,
+    irq: *mut wasme_gpio_irq_t,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match GpioIrq::subscribe(ctx, handle, triggers, GpioIrqSource{ irq }) {
+        Ok(_) => 0,
+        Err(e) => {
+            log::debug!("gpio_subscribe error: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+pub extern "C" fn gpio_unsubscribe<T: GpioIrq>(ctx: *const c_void, handle: i32) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match GpioIrq::unsubscribe(ctx, handle) {
+        Ok(_) => 0,
+        Err(e) => {
+            log::debug!("gpio_unsubscribe error: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+/// GPIO extension for port-wide masked access
+pub trait GpioPort {
+    fn write(&mut self, port: i32, mask: u32, value: u32) -> Result<(), Error>;
+    fn read(&mut self, port: i32) -> Result<u32, Error>;
+
+    /// Play out a timed sequence of port states natively, returning `None` to
+    /// have the host play it through [`GpioPort::write`]
+    fn waveform(&mut self, _port: i32, _steps: &[wasme_gpio_step_t]) -> Option<Result<(), Error>> {
+        None
+    }
+}
+
+/// Driver adaptor to C/wasm3 GPIO port API
+impl<T: GpioPort> Driver<wasme_gpio_port_drv_t> for T {
+    const DRIVER: wasme_gpio_port_drv_t = wasme_gpio_port_drv_t {
+        write: Some(gpio_port_write::<T>),
+        read: Some(gpio_port_read::<T>),
+        waveform: Some(gpio_waveform::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_gpio_port(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn gpio_port_write<T: GpioPort>(ctx: *const c_void, port: i32, mask: u32, value: u32) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match GpioPort::write(ctx, port, mask, value) {
+        Ok(_) => 0,
+        Err(e) => {
+            log::debug!("gpio_port_write error: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+pub extern "C" fn gpio_port_read<T: GpioPort>(ctx: *const c_void, port: i32, value: *mut u32) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match GpioPort::read(ctx, port) {
+        Ok(v) => {
+            unsafe { *value = v };
+            0
+        }
+        Err(e) => {
+            log::debug!("gpio_port_read error: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+pub extern "C" fn gpio_waveform<T: GpioPort>(
+    ctx: *const c_void,
+    port: i32,
+    steps: *const wasme_gpio_step_t,
+    num_steps: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let steps = unsafe { core::slice::from_raw_parts(steps, num_steps as usize) };
+
+    match GpioPort::waveform(ctx, port, steps) {
+        Some(Ok(_)) => 0,
+        // Have the host play the waveform through port writes
+        None => WASI_ERRNO_NOTSUP,
+        Some(Err(e)) => {
+            log::debug!("gpio_waveform error: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
 #[cfg(test)]
 mod test {
     use wasm_embedded_spec::gpio::MockGpio;
@@ -4,9 +4,13 @@ use core::slice;
 
 use log::debug;
 
-use wasm_embedded_spec::{I2c, bindgen::i2c_drv_t};
+use wasm_embedded_spec::{I2c, Error, bindgen::i2c_drv_t};
 
-use crate::{Driver, Wasm3Runtime};
+use crate::{
+    Driver, Wasm3Runtime, WASI_ERRNO_IO, WASI_ERRNO_INVAL,
+    wasme_i2c_txn_drv_t, wasme_i2c_xfer_t, wasme_i2c_op_kind_t_WASME_I2C_OP_WRITE,
+    buf::bufs_alias,
+};
 
 /// Driver adaptor to C/wasm3 I2C API
 impl<T: I2c> Driver<i2c_drv_t> for T {
@@ -116,3 +120,81 @@ pub extern "C" fn i2c_write_read<T: I2c>(
         }
     }
 }
+
+
+/// I2C operation executed as part of an [`I2cTransaction`]
+#[derive(Debug)]
+pub enum I2cOp<'a> {
+    Write(&'a [u8]),
+    Read(&'a mut [u8]),
+}
+
+/// Iterator over operations resolved from guest memory
+pub struct I2cOps<'a> {
+    ops: &'a [wasme_i2c_xfer_t],
+}
+
+impl<'a> I2cOps<'a> {
+    /// Check whether any read buffer overlaps another buffer, adaptors reject such lists
+    fn aliased(&self) -> bool {
+        bufs_alias(self.ops.iter().map(|op| {
+            (op.data as usize, op.len as usize, op.kind != wasme_i2c_op_kind_t_WASME_I2C_OP_WRITE)
+        }))
+    }
+}
+
+impl<'a> Iterator for I2cOps<'a> {
+    type Item = I2cOp<'a>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let (op, rest) = self.ops.split_first()?;
+        self.ops = rest;
+
+        // Buffers are bounds checked against linear memory and checked not to alias before the transaction is called
+        let op = unsafe { match op.kind {
+            wasme_i2c_op_kind_t_WASME_I2C_OP_WRITE => I2cOp::Write(slice::from_raw_parts(op.data, op.len as usize)),
+            _ => I2cOp::Read(slice::from_raw_parts_mut(op.data, op.len as usize)),
+        } };
+
+        Some(op)
+    }
+}
+
+/// I2C extension executing operations on one address with repeated starts,
+/// matching embedded-hal `transaction` semantics
+pub trait I2cTransaction {
+    fn transaction(&mut self, handle: i32, address: u16, ops: I2cOps<'_>) -> Result<(), Error>;
+}
+
+/// Driver adaptor to C/wasm3 I2C transaction API
+impl<T: I2cTransaction> Driver<wasme_i2c_txn_drv_t> for T {
+    const DRIVER: wasme_i2c_txn_drv_t = wasme_i2c_txn_drv_t {
+        transaction: Some(i2c_transaction::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_i2c_txn(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn i2c_transaction<T: I2cTransaction>(
+    ctx: *const c_void,
+    handle: i32,
+    address: u16,
+    ops: *const wasme_i2c_xfer_t,
+    num_ops: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let ops = I2cOps{ ops: unsafe { slice::from_raw_parts(ops, num_ops as usize) } };
+    if ops.aliased() {
+        return WASI_ERRNO_INVAL;
+    }
+
+    match I2cTransaction::transaction(ctx, handle, address, ops) {
+        Ok(_) => 0,
+        Err(e) => {
+            debug!("I2cTransaction::transaction failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
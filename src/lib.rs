@@ -6,6 +6,8 @@
 #![allow(non_snake_case, non_camel_case_types, non_upper_case_globals, clippy::all)]
 
 use core::ptr;
+use core::marker::PhantomData;
+use core::sync::atomic::{AtomicUsize, Ordering};
 
 use log::{debug};
 pub use cty::{c_char};
@@ -20,9 +22,43 @@ pub use spec::{
 
 // Driver modules
 mod gpio;
+pub use gpio::{GpioIrq, GpioIrqSource, GpioPort};
 mod spi;
+pub use spi::{SpiExec, SpiOp, SpiOps, SpiVectored};
 mod i2c;
+pub use i2c::{I2cTransaction, I2cOp, I2cOps};
 mod uart;
+pub use uart::{UartVectored, UartStream, UartStreamWriter};
+
+// Host clock hook
+mod clock;
+pub use clock::{HostClock, CLOCK_REALTIME, CLOCK_MONOTONIC, CLOCK_PROCESS_CPUTIME, CLOCK_THREAD_CPUTIME};
+
+// Buffered console output
+mod console;
+pub use console::Console;
+
+// Virtual filesystem for WASI preopens
+mod vfs;
+pub use vfs::{RamFs, ImageFs};
+#[cfg(feature = "std")]
+pub use vfs::ImageBuilder;
+
+// Shared bus manager
+mod bus;
+pub use bus::Bus;
+
+// Scatter-gather and DMA buffers
+mod buf;
+pub use buf::{IoVecs, IoVecsMut, DmaPool, DmaBuf};
+
+// Typed function calls
+mod func;
+pub use func::{WasmType, WasmTuple, Wasm3Func};
+
+// Event dispatch to exported handlers
+mod reactor;
+pub use reactor::Reactor;
 
 
 // Rust bindings for wasm3 C library
@@ -31,6 +67,15 @@ include!(concat!(env!("OUT_DIR"), "/bindings.rs"));
 // Start symbol name in wasm binary
 const START_STR: &'static [u8] = b"_start\0";
 
+/// WASI `io` errno, returned to the guest by driver extensions when the driver fails
+pub(crate) const WASI_ERRNO_IO: i32 = 29;
+
+/// WASI `inval` errno, returned by driver extensions for guest buffers that alias
+pub(crate) const WASI_ERRNO_INVAL: i32 = 28;
+
+/// WASI `notsup` errno, returned by driver extensions to request the host fallback
+pub(crate) const WASI_ERRNO_NOTSUP: i32 = 58;
+
 /// WASM3 runtime errors
 #[derive(Debug, Clone, PartialEq)]
 #[cfg_attr(feature="thiserror", derive(thiserror::Error))]
@@ -48,14 +93,33 @@ pub enum Wasm3Err {
     Exec(i32),
     #[cfg_attr(feature="thiserror", error("Driver binding error: {0}"))]
     Bind(i32),
+    #[cfg_attr(feature="thiserror", error("Snapshot error: {0}"))]
+    Snapshot(i32),
+    #[cfg_attr(feature="thiserror", error("Filesystem mount error: {0}"))]
+    Mount(i32),
+    #[cfg_attr(feature="thiserror", error("Function lookup failed"))]
+    Lookup,
+    #[cfg_attr(feature="thiserror", error("Function signature mismatch"))]
+    Signature,
+    #[cfg_attr(feature="thiserror", error("Function resolved on a different runtime"))]
+    Runtime,
+    #[cfg_attr(feature="thiserror", error("Execution suspended, out of fuel"))]
+    Suspended,
+    #[cfg_attr(feature="thiserror", error("Execution parked awaiting a driver"))]
+    Pending,
 }
 
 /// WASM3 runtime instance
 pub struct Wasm3Runtime {
     _task: wasme_task_t,
     ctx: *mut wasme_ctx_t,
+    // Unique identity, function handles are only valid on the runtime they were resolved on
+    id: usize,
 }
 
+// Source of runtime identities, never reused so a handle cannot match a later runtime
+static RUNTIME_ID: AtomicUsize = AtomicUsize::new(1);
+
 impl Wasm3Runtime {
     /// Create new WASM3 runtime instance with the provided app
     pub fn new<E: Engine>(engine: &mut E, data: &[u8]) -> Result<Self, Wasm3Err> {
@@ -74,23 +138,55 @@ impl Wasm3Runtime {
         let mut rt = Self{
             _task: task,
             ctx,
+            id: RUNTIME_ID.fetch_add(1, Ordering::Relaxed),
+        };
+
+        rt.bind_engine(engine)?;
+
+        Ok(rt)
+    }
+
+    /// Create new WASM3 runtime instance with the app mapped from the provided file,
+    /// avoiding reading the whole binary into RAM
+    #[cfg(feature = "std")]
+    pub fn from_file<E: Engine>(engine: &mut E, path: &std::path::Path) -> Result<Self, Wasm3Err> {
+        let path = path.to_str()
+            .and_then(|p| std::ffi::CString::new(p).ok())
+            .ok_or(Wasm3Err::Ctx)?;
+
+        // Initialise WASME context from the mapped file
+        let ctx = unsafe { WASME_init_from_file(path.as_ptr(), 10 * 1024) };
+        if ctx.is_null() {
+            return Err(Wasm3Err::Ctx);
+        }
+
+        let mut rt = Self{
+            _task: wasme_task_t{ data: ptr::null(), data_len: 0 },
+            ctx,
+            id: RUNTIME_ID.fetch_add(1, Ordering::Relaxed),
         };
 
-        // Bind drivers
+        rt.bind_engine(engine)?;
+
+        Ok(rt)
+    }
+
+    /// Bind all drivers provided by the engine
+    fn bind_engine<E: Engine>(&mut self, engine: &mut E) -> Result<(), Wasm3Err> {
         if let Some(gpio) = engine.gpio() {
-            rt.bind::<gpio_drv_t, _>(gpio)?;
+            self.bind::<gpio_drv_t, _>(gpio)?;
         }
         if let Some(spi) = engine.spi() {
-            rt.bind::<spi_drv_t, _>(spi)?;
+            self.bind::<spi_drv_t, _>(spi)?;
         }
         if let Some(i2c) = engine.i2c() {
-            rt.bind::<i2c_drv_t, _>(i2c)?;
+            self.bind::<i2c_drv_t, _>(i2c)?;
         }
         if let Some(uart) = engine.uart() {
-            rt.bind::<uart_drv_t, _>(uart)?;
+            self.bind::<uart_drv_t, _>(uart)?;
         }
 
-        Ok(rt)
+        Ok(())
     }
 
     pub fn bind<I, D: Driver<I>>(&mut self, driver: &mut D) -> Result<(), Wasm3Err> {
@@ -112,6 +208,12 @@ impl Wasm3Runtime {
         let entry = START_STR.as_ptr() as *const c_char;
 
         let res = unsafe { WASME_run(self.ctx, entry, 0, ptr::null_mut()) };
+        if res == WASME_SUSPENDED as i32 {
+            return Err(Wasm3Err::Suspended);
+        }
+        if res == WASME_PENDING as i32 {
+            return Err(Wasm3Err::Pending);
+        }
         if res < 0 {
             return Err(Wasm3Err::Exec(res));
         }
@@ -120,6 +222,210 @@ impl Wasm3Runtime {
 
         Ok(())
     }
+
+    /// Resolve an exported function by name for repeated typed calls
+    pub fn lookup<A: WasmTuple, R: WasmTuple>(&mut self, name: &str) -> Result<Wasm3Func<A, R>, Wasm3Err> {
+        // Copy name to nul terminated buffer for C
+        let mut buff = [0u8; 128];
+        if name.len() >= buff.len() {
+            return Err(Wasm3Err::Lookup);
+        }
+        buff[..name.len()].copy_from_slice(name.as_bytes());
+
+        let func = unsafe { WASME_lookup(self.ctx, buff.as_ptr() as *const c_char) };
+        if func.is_null() {
+            return Err(Wasm3Err::Lookup);
+        }
+
+        Ok(Wasm3Func{ func, rt: self.id, _t: PhantomData })
+    }
+
+    /// Call a function previously resolved on this runtime with typed arguments, returning typed results
+    pub fn call<A: WasmTuple, R: WasmTuple>(&mut self, f: &Wasm3Func<A, R>, args: A) -> Result<R, Wasm3Err> {
+        if f.rt != self.id {
+            return Err(Wasm3Err::Runtime);
+        }
+
+        let mut arg_vals: [wasme_val_t; func::MAX_VALS] = unsafe { core::mem::zeroed() };
+        let mut ret_vals: [wasme_val_t; func::MAX_VALS] = unsafe { core::mem::zeroed() };
+
+        if A::COUNT > func::MAX_VALS || R::COUNT > func::MAX_VALS {
+            return Err(Wasm3Err::Signature);
+        }
+
+        args.into_vals(&mut arg_vals[..A::COUNT]);
+
+        let res = unsafe { WASME_call(self.ctx, f.func,
+            arg_vals.as_ptr(), A::COUNT as u32,
+            ret_vals.as_mut_ptr(), R::COUNT as u32,
+        ) };
+        match res {
+            0 => (),
+            -1 => return Err(Wasm3Err::Signature),
+            r if r == WASME_SUSPENDED as i32 => return Err(Wasm3Err::Suspended),
+            r if r == WASME_PENDING as i32 => return Err(Wasm3Err::Pending),
+            _ => return Err(Wasm3Err::Exec(res)),
+        }
+
+        R::from_vals(&ret_vals[..R::COUNT]).ok_or(Wasm3Err::Signature)
+    }
+
+    /// Enable fuel metering with the provided budget, one unit is consumed per wasm
+    /// function call and runs or calls return [`Wasm3Err::Suspended`] once exhausted.
+    /// Loops that make no calls are not charged so are not bounded by fuel.
+    pub fn set_fuel(&mut self, fuel: u64) {
+        unsafe { WASME_set_fuel(self.ctx, fuel) }
+    }
+
+    /// Fetch the remaining fuel budget
+    pub fn fuel(&self) -> u64 {
+        unsafe { WASME_get_fuel(self.ctx) }
+    }
+
+    /// Disable fuel metering
+    pub fn disable_fuel(&mut self) {
+        unsafe { WASME_disable_fuel(self.ctx) }
+    }
+
+    /// Allow drivers to complete asynchronously, runs and calls then return
+    /// [`Wasm3Err::Pending`] while parked and are continued with [`Wasm3Runtime::resume`]
+    pub fn enable_async(&mut self) {
+        unsafe { WASME_async_enable(self.ctx, None, ptr::null_mut()) }
+    }
+
+    /// Resume a suspended run after adding fuel, or a parked run once its driver completes
+    pub fn resume(&mut self) -> Result<(), Wasm3Err> {
+        let res = unsafe { WASME_resume(self.ctx, ptr::null_mut(), 0) };
+        match res {
+            0 => Ok(()),
+            r if r == WASME_SUSPENDED as i32 => Err(Wasm3Err::Suspended),
+            r if r == WASME_PENDING as i32 => Err(Wasm3Err::Pending),
+            _ => Err(Wasm3Err::Exec(res)),
+        }
+    }
+
+    /// Resume a suspended call of `f` after adding fuel, returning its typed results
+    pub fn resume_call<A: WasmTuple, R: WasmTuple>(&mut self, f: &Wasm3Func<A, R>) -> Result<R, Wasm3Err> {
+        if f.rt != self.id {
+            return Err(Wasm3Err::Runtime);
+        }
+
+        let mut ret_vals: [wasme_val_t; func::MAX_VALS] = unsafe { core::mem::zeroed() };
+
+        if R::COUNT > func::MAX_VALS {
+            return Err(Wasm3Err::Signature);
+        }
+
+        let res = unsafe { WASME_resume(self.ctx, ret_vals.as_mut_ptr(), R::COUNT as u32) };
+        match res {
+            0 => (),
+            r if r == WASME_SUSPENDED as i32 => return Err(Wasm3Err::Suspended),
+            r if r == WASME_PENDING as i32 => return Err(Wasm3Err::Pending),
+            _ => return Err(Wasm3Err::Exec(res)),
+        }
+
+        R::from_vals(&ret_vals[..R::COUNT]).ok_or(Wasm3Err::Signature)
+    }
+
+    /// Use the provided pool to coalesce scatter-gather transfers for drivers
+    /// without vectored operations, the pool must outlive the runtime
+    pub fn bind_dma_pool(&mut self, pool: &DmaPool) {
+        unsafe { WASME_bind_dma_pool(self.ctx, pool.pool) };
+    }
+
+    /// Link the sampler functions, executing periodic transactions through the
+    /// bound I2C and SPI drivers from the sampler thread
+    ///
+    /// # Safety
+    ///
+    /// Driver adaptors borrow the driver as `&mut T` for each call, so samples
+    /// taken on the sampler thread alias guest calls on the executing thread.
+    /// Callers must ensure the two never overlap, for example by binding the
+    /// drivers through a [`Bus`] whose lock serialises every operation. Hosts
+    /// without a sampler thread sample in [`Wasm3Runtime::sampler_tick`], which
+    /// cannot overlap execution.
+    pub unsafe fn bind_sampler(&mut self) -> Result<(), Wasm3Err> {
+        let res = WASME_bind_sampler(self.ctx);
+        if res < 0 {
+            return Err(Wasm3Err::Bind(res));
+        }
+
+        Ok(())
+    }
+
+    /// Run samplers due at `now_ns` for hosts without a sampler thread,
+    /// returning the next due time
+    pub fn sampler_tick(&mut self, now_ns: i64) -> i64 {
+        unsafe { WASME_sampler_tick(self.ctx, now_ns) }
+    }
+
+    /// Write all buffered console output to the bound [`Console`] or host stdout/stderr
+    pub fn console_flush(&mut self) {
+        unsafe { WASME_console_flush(self.ctx) }
+    }
+
+    /// Flush console output buffered for longer than the policy allows at `now_ns`,
+    /// for hosts without a flush thread
+    pub fn console_tick(&mut self, now_ns: i64) {
+        unsafe { WASME_console_tick(self.ctx, now_ns) }
+    }
+
+    /// Mount a RAM filesystem as a WASI preopen at `path` (for example "/data"),
+    /// the filesystem must outlive the runtime
+    pub fn mount_ramfs(&mut self, path: &str, fs: &RamFs) -> Result<(), Wasm3Err> {
+        let path = mount_path(path)?;
+
+        let res = unsafe { WASME_vfs_mount_ramfs(self.ctx, path.as_ptr() as *const c_char, fs.fs) };
+        if res < 0 {
+            return Err(Wasm3Err::Mount(res));
+        }
+
+        Ok(())
+    }
+
+    /// Mount a read-only image filesystem as a WASI preopen at `path`,
+    /// the filesystem must outlive the runtime
+    pub fn mount_imgfs(&mut self, path: &str, fs: &mut ImageFs) -> Result<(), Wasm3Err> {
+        let path = mount_path(path)?;
+
+        let res = unsafe { WASME_vfs_mount_imgfs(self.ctx, path.as_ptr() as *const c_char, &mut fs.fs) };
+        if res < 0 {
+            return Err(Wasm3Err::Mount(res));
+        }
+
+        Ok(())
+    }
+
+    /// Capture linear memory and globals as the point to restore on [`Wasm3Runtime::reset`]
+    pub fn snapshot(&mut self) -> Result<(), Wasm3Err> {
+        let res = unsafe { WASME_snapshot(self.ctx) };
+        if res < 0 {
+            return Err(Wasm3Err::Snapshot(res));
+        }
+
+        Ok(())
+    }
+
+    /// Restore the last snapshot, for example to recover after a trap
+    pub fn reset(&mut self) -> Result<(), Wasm3Err> {
+        let res = unsafe { WASME_reset(self.ctx) };
+        if res < 0 {
+            return Err(Wasm3Err::Snapshot(res));
+        }
+
+        Ok(())
+    }
+}
+
+/// Nul-terminate a mount path for the C API
+fn mount_path(path: &str) -> Result<[u8; WASME_VFS_PATH_MAX as usize + 1], Wasm3Err> {
+    let mut p = [0u8; WASME_VFS_PATH_MAX as usize + 1];
+    if path.len() >= p.len() || path.as_bytes().contains(&0) {
+        return Err(Wasm3Err::Mount(-1));
+    }
+    p[..path.len()].copy_from_slice(path.as_bytes());
+
+    Ok(p)
 }
 
 impl Drop for Wasm3Runtime {
@@ -145,3 +451,126 @@ pub trait Driver<Inner>: Sized {
     /// Bind to runtime using generated WASME_bind_x call
     fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32;
 }
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    // Handle table internals, exported by the C library
+    extern "C" {
+        fn wasme_handle_alloc(ctx: *mut wasme_ctx_t, kind: u32, drv_handle: i32) -> i32;
+        fn wasme_handle_get(ctx: *mut wasme_ctx_t, kind: u32, handle: i32, drv_handle: *mut i32) -> i32;
+        fn wasme_handle_close(ctx: *mut wasme_ctx_t, kind: u32, handle: i32) -> i32;
+    }
+
+    const HANDLE_GPIO: u32 = 1;
+    const HANDLE_SPI: u32 = 2;
+    const WASI_ERRNO_BADF: i32 = 8;
+
+    // Smallest valid module, with no imports or exports
+    const EMPTY_MODULE: &[u8] = b"\0asm\x01\0\0\0";
+
+    // Module with one page of memory, a mutable i32 global initialised to 5 and exports:
+    //   spin(n: i32) -> i32   calls an empty function n times, returning n
+    //   set(v: i32)           stores v at memory offset 16 and in the global
+    //   mem() -> i32          loads memory offset 16
+    //   glob() -> i32         reads the global
+    const STATE_MODULE: &[u8] = b"\x00asm\x01\x00\x00\x00\x01\x11\x04`\x00\x00`\x01\x7f\x01\x7f`\x01\x7f\x00`\x00\x01\x7f\x03\x06\x05\x00\x01\x02\x03\x03\x05\x03\x01\x00\x01\x06\x06\x01\x7f\x01A\x05\x0b\x07\x1b\x04\x04spin\x00\x01\x03set\x00\x02\x03mem\x00\x03\x04glob\x00\x04\x0a>\x05\x02\x00\x0b\x1e\x01\x01\x7f\x02@\x03@ \x01 \x00O\x0d\x01\x10\x00 \x01A\x01j!\x01\x0c\x00\x0b\x0b \x01\x0b\x0d\x00A\x10 \x006\x02\x00 \x00$\x00\x0b\x07\x00A\x10(\x02\x00\x0b\x04\x00#\x00\x0b";
+
+    // Runtime without drivers for exercising execution
+    fn runtime(data: &'static [u8]) -> Wasm3Runtime {
+        let task = wasme_task_t{ data: data.as_ptr(), data_len: data.len() as u32 };
+        let ctx = unsafe { WASME_init(&task, 10 * 1024) };
+        assert!(!ctx.is_null());
+
+        Wasm3Runtime{ _task: task, ctx, id: RUNTIME_ID.fetch_add(1, Ordering::Relaxed) }
+    }
+
+    #[test]
+    fn test_handle_generations() {
+        let task = wasme_task_t{ data: EMPTY_MODULE.as_ptr(), data_len: EMPTY_MODULE.len() as u32 };
+        let mut ctx = unsafe { WASME_init(&task, 10 * 1024) };
+        assert!(!ctx.is_null());
+
+        let mut drv = 0;
+        let h = unsafe { wasme_handle_alloc(ctx, HANDLE_GPIO, 7) };
+        assert!(h >= 0);
+        assert_eq!(unsafe { wasme_handle_get(ctx, HANDLE_GPIO, h, &mut drv) }, 0);
+        assert_eq!(drv, 7);
+
+        // Handles only resolve as the kind they were opened as
+        assert_eq!(unsafe { wasme_handle_get(ctx, HANDLE_SPI, h, &mut drv) }, WASI_ERRNO_BADF);
+
+        // Closing advances the generation so the stale handle is rejected once the slot is reused
+        assert_eq!(unsafe { wasme_handle_close(ctx, HANDLE_GPIO, h) }, 0);
+        let h2 = unsafe { wasme_handle_alloc(ctx, HANDLE_GPIO, 9) };
+        assert_eq!(h2 & 0xFF, h & 0xFF);
+        assert_ne!(h2, h);
+
+        assert_eq!(unsafe { wasme_handle_get(ctx, HANDLE_GPIO, h, &mut drv) }, WASI_ERRNO_BADF);
+        assert_eq!(unsafe { wasme_handle_close(ctx, HANDLE_GPIO, h) }, WASI_ERRNO_BADF);
+        assert_eq!(unsafe { wasme_handle_get(ctx, HANDLE_GPIO, h2, &mut drv) }, 0);
+        assert_eq!(drv, 9);
+
+        unsafe { WASME_deinit(&mut ctx) };
+    }
+
+    // Suspending on fuel exhaustion needs fibers, available with glibc
+    #[cfg(all(target_os = "linux", target_env = "gnu"))]
+    #[test]
+    fn test_fuel_suspend_resume() {
+        let mut rt = runtime(STATE_MODULE);
+        let spin = rt.lookup::<i32, i32>("spin").unwrap();
+
+        // Each call consumes one unit so the loop runs out part way through
+        rt.set_fuel(10);
+        assert_eq!(rt.call(&spin, 100), Err(Wasm3Err::Suspended));
+        assert_eq!(rt.fuel(), 0);
+
+        // Topping up continues the suspended call to completion
+        rt.set_fuel(1000);
+        assert_eq!(rt.resume_call(&spin), Ok(100));
+        assert!(rt.fuel() < 1000);
+
+        // The context is usable for new calls afterwards
+        rt.disable_fuel();
+        assert_eq!(rt.call(&spin, 3), Ok(3));
+    }
+
+    #[test]
+    fn test_snapshot_reset() {
+        let mut rt = runtime(STATE_MODULE);
+        let set = rt.lookup::<i32, ()>("set").unwrap();
+        let mem = rt.lookup::<(), i32>("mem").unwrap();
+        let glob = rt.lookup::<(), i32>("glob").unwrap();
+
+        rt.call(&set, 7).unwrap();
+        let before = unsafe { wasme_handle_alloc(rt.ctx, HANDLE_GPIO, 1) };
+        assert!(before >= 0);
+        rt.snapshot().unwrap();
+
+        // Mutate memory and globals and open a handle after the snapshot
+        rt.call(&set, 42).unwrap();
+        assert_eq!(rt.call(&mem, ()), Ok(42));
+        assert_eq!(rt.call(&glob, ()), Ok(42));
+        let after = unsafe { wasme_handle_alloc(rt.ctx, HANDLE_GPIO, 2) };
+        assert!(after >= 0);
+
+        rt.reset().unwrap();
+
+        // State is restored to the snapshot
+        assert_eq!(rt.call(&mem, ()), Ok(7));
+        assert_eq!(rt.call(&glob, ()), Ok(7));
+
+        // Handles opened since the snapshot are closed, earlier ones stay open
+        let mut drv = 0;
+        assert_eq!(unsafe { wasme_handle_get(rt.ctx, HANDLE_GPIO, after, &mut drv) }, WASI_ERRNO_BADF);
+        assert_eq!(unsafe { wasme_handle_get(rt.ctx, HANDLE_GPIO, before, &mut drv) }, 0);
+        assert_eq!(drv, 1);
+
+        // Resetting again restores the same point
+        rt.call(&set, 9).unwrap();
+        rt.reset().unwrap();
+        assert_eq!(rt.call(&mem, ()), Ok(7));
+    }
+}
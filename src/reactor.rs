@@ -0,0 +1,100 @@
+
+use crate::{
+    c_char, Wasm3Runtime, Wasm3Err, wasme_reactor_t, wasme_event_t, wasme_val_t,
+    WASME_reactor_init, WASME_reactor_handler, WASME_reactor_post, WASME_reactor_dispatch,
+    WASME_reactor_call, WASME_reactor_deinit, WASME_resume, WASME_SUSPENDED, WASME_PENDING,
+};
+
+/// Reactor dispatching events to exported `i32 (i32 source, i32 value, i64 timestamp)`
+/// handlers. Handlers execute as typed calls, so are metered by the runtime's fuel
+/// and may park on async drivers.
+pub struct Reactor<'a> {
+    reactor: *mut wasme_reactor_t,
+    rt: &'a mut Wasm3Runtime,
+}
+
+impl<'a> Reactor<'a> {
+    /// Create a reactor on a runtime, running `_initialize` if exported.
+    /// `queue_len` must be a power of two.
+    pub fn new(rt: &'a mut Wasm3Runtime, queue_len: u32) -> Result<Self, Wasm3Err> {
+        let reactor = unsafe { WASME_reactor_init(rt.ctx, queue_len) };
+        if reactor.is_null() {
+            return Err(Wasm3Err::Ctx);
+        }
+
+        Ok(Self{ reactor, rt })
+    }
+
+    /// Resolve an exported handler, returning its id for events
+    pub fn handler(&mut self, name: &str) -> Result<u32, Wasm3Err> {
+        // Copy name to nul terminated buffer for C
+        let mut buff = [0u8; 128];
+        if name.len() >= buff.len() {
+            return Err(Wasm3Err::Lookup);
+        }
+        buff[..name.len()].copy_from_slice(name.as_bytes());
+
+        match unsafe { WASME_reactor_handler(self.reactor, buff.as_ptr() as *const c_char) } {
+            -2 => Err(Wasm3Err::Lookup),
+            -3 => Err(Wasm3Err::Signature),
+            res if res < 0 => Err(Wasm3Err::Exec(res)),
+            id => Ok(id as u32),
+        }
+    }
+
+    /// Queue an event for the next dispatch, returning false if the queue is full
+    pub fn post(&mut self, handler: u32, source: i32, value: i32, timestamp: i64) -> bool {
+        let event = wasme_event_t{ handler, source, value, timestamp };
+
+        unsafe { WASME_reactor_post(self.reactor, &event) == 0 }
+    }
+
+    /// Dispatch up to `max` queued events, returning the number dispatched.
+    /// Dispatch stops after a handler that suspends or parks until it is resumed.
+    pub fn dispatch(&mut self, max: u32) -> Result<u32, Wasm3Err> {
+        let res = unsafe { WASME_reactor_dispatch(self.reactor, max) };
+        if res < 0 {
+            return Err(Wasm3Err::Exec(res));
+        }
+
+        Ok(res as u32)
+    }
+
+    /// Invoke a handler immediately, returning its result
+    pub fn call(&mut self, handler: u32, source: i32, value: i32, timestamp: i64) -> Result<i32, Wasm3Err> {
+        let event = wasme_event_t{ handler, source, value, timestamp };
+        let mut result = 0;
+
+        let res = unsafe { WASME_reactor_call(self.reactor, &event, &mut result) };
+        match res {
+            0 => Ok(result),
+            r if r == WASME_SUSPENDED as i32 => Err(Wasm3Err::Suspended),
+            r if r == WASME_PENDING as i32 => Err(Wasm3Err::Pending),
+            _ => Err(Wasm3Err::Exec(res)),
+        }
+    }
+
+    /// Resume a suspended or parked handler, returning its result
+    pub fn resume(&mut self) -> Result<i32, Wasm3Err> {
+        let mut ret: wasme_val_t = unsafe { core::mem::zeroed() };
+
+        let res = unsafe { WASME_resume(self.rt.ctx, &mut ret, 1) };
+        match res {
+            0 => Ok(unsafe { ret.of.i32 }),
+            r if r == WASME_SUSPENDED as i32 => Err(Wasm3Err::Suspended),
+            r if r == WASME_PENDING as i32 => Err(Wasm3Err::Pending),
+            _ => Err(Wasm3Err::Exec(res)),
+        }
+    }
+
+    /// Access the runtime, for example to add fuel before resuming
+    pub fn runtime(&mut self) -> &mut Wasm3Runtime {
+        self.rt
+    }
+}
+
+impl<'a> Drop for Reactor<'a> {
+    fn drop(&mut self) {
+        unsafe { WASME_reactor_deinit(&mut self.reactor) }
+    }
+}
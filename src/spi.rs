@@ -5,9 +5,18 @@ use core::slice;
 
 use log::{warn};
 
-use wasm_embedded_spec::{Spi, bindgen::spi_drv_t};
+use wasm_embedded_spec::{Spi, Error, bindgen::spi_drv_t};
 
-use crate::{Driver, Wasm3Runtime};
+use crate::{
+    Driver, Wasm3Runtime, WASI_ERRNO_IO, WASI_ERRNO_INVAL,
+    wasme_spi_exec_drv_t, wasme_spi_xfer_t,
+    wasme_spi_op_kind_t_WASME_SPI_OP_WRITE, wasme_spi_op_kind_t_WASME_SPI_OP_READ,
+    wasme_spi_op_kind_t_WASME_SPI_OP_TRANSFER, wasme_spi_op_kind_t_WASME_SPI_OP_TRANSFER_INPLACE,
+    wasme_spi_op_kind_t_WASME_SPI_OP_DELAY_US,
+    wasme_spi_vec_drv_t, wasme_iovec_t,
+    IoVecs, IoVecsMut,
+    buf::{BufRange, bufs_alias},
+};
 
 /// Driver adaptor to C/wasm3 SPI API
 impl<T: Spi> Driver<spi_drv_t> for T {
@@ -139,3 +148,165 @@ pub extern "C" fn spi_transfer_inplace<T: Spi>(
         }
     }
 }
+
+
+/// SPI operation executed as part of an [`SpiExec`] sequence
+#[derive(Debug)]
+pub enum SpiOp<'a> {
+    Write(&'a [u8]),
+    Read(&'a mut [u8]),
+    Transfer{ read: &'a mut [u8], write: &'a [u8] },
+    TransferInplace(&'a mut [u8]),
+    DelayUs(u32),
+    /// Assert (true) or release (false) chip select
+    Cs(bool),
+}
+
+/// Iterator over operations resolved from guest memory
+pub struct SpiOps<'a> {
+    ops: &'a [wasme_spi_xfer_t],
+}
+
+impl<'a> SpiOps<'a> {
+    /// Check whether any buffer written by an operation overlaps another buffer,
+    /// adaptors reject such lists
+    fn aliased(&self) -> bool {
+        bufs_alias(self.ops.iter().flat_map(spi_op_bufs).flatten())
+    }
+}
+
+// Buffers accessed by an operation, in place transfers count once as mutable
+fn spi_op_bufs(op: &wasme_spi_xfer_t) -> [Option<BufRange>; 2] {
+    let len = op.len as usize;
+
+    match op.kind {
+        wasme_spi_op_kind_t_WASME_SPI_OP_WRITE => [Some((op.write as usize, len, false)), None],
+        wasme_spi_op_kind_t_WASME_SPI_OP_READ
+        | wasme_spi_op_kind_t_WASME_SPI_OP_TRANSFER_INPLACE => [Some((op.read as usize, len, true)), None],
+        wasme_spi_op_kind_t_WASME_SPI_OP_TRANSFER => [
+            Some((op.read as usize, len, true)),
+            Some((op.write as usize, len, false)),
+        ],
+        _ => [None, None],
+    }
+}
+
+impl<'a> Iterator for SpiOps<'a> {
+    type Item = SpiOp<'a>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let (op, rest) = self.ops.split_first()?;
+        self.ops = rest;
+
+        // Buffers are bounds checked against linear memory and checked not to alias before exec is called
+        let len = op.len as usize;
+        let op = unsafe { match op.kind {
+            wasme_spi_op_kind_t_WASME_SPI_OP_WRITE => SpiOp::Write(slice::from_raw_parts(op.write, len)),
+            wasme_spi_op_kind_t_WASME_SPI_OP_READ => SpiOp::Read(slice::from_raw_parts_mut(op.read, len)),
+            wasme_spi_op_kind_t_WASME_SPI_OP_TRANSFER => SpiOp::Transfer{
+                read: slice::from_raw_parts_mut(op.read, len),
+                write: slice::from_raw_parts(op.write, len),
+            },
+            wasme_spi_op_kind_t_WASME_SPI_OP_TRANSFER_INPLACE => SpiOp::TransferInplace(slice::from_raw_parts_mut(op.read, len)),
+            wasme_spi_op_kind_t_WASME_SPI_OP_DELAY_US => SpiOp::DelayUs(op.len),
+            _ => SpiOp::Cs(op.len != 0),
+        } };
+
+        Some(op)
+    }
+}
+
+/// SPI extension executing a sequence of operations with chip select held
+pub trait SpiExec {
+    fn exec(&mut self, handle: i32, ops: SpiOps<'_>) -> Result<(), Error>;
+}
+
+/// Driver adaptor to C/wasm3 SPI exec API
+impl<T: SpiExec> Driver<wasme_spi_exec_drv_t> for T {
+    const DRIVER: wasme_spi_exec_drv_t = wasme_spi_exec_drv_t {
+        exec: Some(spi_exec::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_spi_exec(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn spi_exec<T: SpiExec>(
+    ctx: *const c_void,
+    handle: i32,
+    ops: *const wasme_spi_xfer_t,
+    num_ops: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let ops = SpiOps{ ops: unsafe { slice::from_raw_parts(ops, num_ops as usize) } };
+    if ops.aliased() {
+        return WASI_ERRNO_INVAL;
+    }
+
+    match SpiExec::exec(ctx, handle, ops) {
+        Ok(_) => 0,
+        Err(e) => {
+            warn!("spi_exec failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+
+/// SPI extension for scatter-gather transfers with chip select held across segments
+pub trait SpiVectored {
+    fn writev(&mut self, handle: i32, bufs: IoVecs<'_>) -> Result<(), Error>;
+    fn readv(&mut self, handle: i32, bufs: IoVecsMut<'_>) -> Result<(), Error>;
+}
+
+/// Driver adaptor to C/wasm3 SPI scatter-gather API
+impl<T: SpiVectored> Driver<wasme_spi_vec_drv_t> for T {
+    const DRIVER: wasme_spi_vec_drv_t = wasme_spi_vec_drv_t {
+        writev: Some(spi_writev::<T>),
+        readv: Some(spi_readv::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_spi_vec(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn spi_writev<T: SpiVectored>(
+    ctx: *const c_void,
+    handle: i32,
+    iov: *const wasme_iovec_t,
+    iov_len: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let bufs = IoVecs{ iov: unsafe { slice::from_raw_parts(iov, iov_len as usize) } };
+
+    match SpiVectored::writev(ctx, handle, bufs) {
+        Ok(_) => 0,
+        Err(e) => {
+            warn!("spi_writev failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+pub extern "C" fn spi_readv<T: SpiVectored>(
+    ctx: *const c_void,
+    handle: i32,
+    iov: *const wasme_iovec_t,
+    iov_len: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let bufs = IoVecsMut{ iov: unsafe { slice::from_raw_parts(iov, iov_len as usize) } };
+    if bufs.aliased() {
+        return WASI_ERRNO_INVAL;
+    }
+
+    match SpiVectored::readv(ctx, handle, bufs) {
+        Ok(_) => 0,
+        Err(e) => {
+            warn!("spi_readv failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
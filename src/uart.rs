@@ -4,9 +4,12 @@ use core::slice;
 
 use log::debug;
 
-use wasm_embedded_spec::{Uart, bindgen::uart_drv_t};
+use wasm_embedded_spec::{Uart, Error, bindgen::uart_drv_t};
 
-use crate::{Driver, Wasm3Runtime};
+use crate::{
+    Driver, Wasm3Runtime, WASI_ERRNO_IO, WASI_ERRNO_INVAL, wasme_uart_vec_drv_t, wasme_iovec_t, IoVecs, IoVecsMut,
+    wasme_uart_stream_drv_t, wasme_uart_stream_t, WASME_uart_stream_push,
+};
 
 /// Driver adaptor to C/wasm3 I2C API
 impl<T: Uart> Driver<uart_drv_t> for T {
@@ -92,3 +95,266 @@ pub extern "C" fn uart_write<T: Uart>(
         }
     }
 }
+
+
+/// UART extension for scatter-gather reads and writes
+pub trait UartVectored {
+    fn writev(&mut self, handle: i32, flags: u32, bufs: IoVecs<'_>) -> Result<(), Error>;
+    fn readv(&mut self, handle: i32, flags: u32, bufs: IoVecsMut<'_>) -> Result<(), Error>;
+}
+
+/// Driver adaptor to C/wasm3 UART scatter-gather API
+impl<T: UartVectored> Driver<wasme_uart_vec_drv_t> for T {
+    const DRIVER: wasme_uart_vec_drv_t = wasme_uart_vec_drv_t {
+        writev: Some(uart_writev::<T>),
+        readv: Some(uart_readv::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_uart_vec(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn uart_writev<T: UartVectored>(
+    ctx: *const c_void,
+    handle: i32,
+    flags: u32,
+    iov: *const wasme_iovec_t,
+    iov_len: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let bufs = IoVecs{ iov: unsafe { slice::from_raw_parts(iov, iov_len as usize) } };
+
+    match UartVectored::writev(ctx, handle, flags, bufs) {
+        Ok(_) => 0,
+        Err(e) => {
+            debug!("UartVectored::writev failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+pub extern "C" fn uart_readv<T: UartVectored>(
+    ctx: *const c_void,
+    handle: i32,
+    flags: u32,
+    iov: *const wasme_iovec_t,
+    iov_len: u32,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+    let bufs = IoVecsMut{ iov: unsafe { slice::from_raw_parts(iov, iov_len as usize) } };
+    if bufs.aliased() {
+        return WASI_ERRNO_INVAL;
+    }
+
+    match UartVectored::readv(ctx, handle, flags, bufs) {
+        Ok(_) => 0,
+        Err(e) => {
+            debug!("UartVectored::readv failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+
+/// Handle for pushing received bytes into a guest stream ring
+pub struct UartStreamWriter {
+    stream: *mut wasme_uart_stream_t,
+}
+
+// Pushing is safe from one producer thread concurrently with execution
+unsafe impl Send for UartStreamWriter {}
+
+impl UartStreamWriter {
+    /// Push received bytes, returning the number stored with the remainder dropped
+    pub fn push(&mut self, data: &[u8]) -> usize {
+        unsafe { WASME_uart_stream_push(self.stream, data.as_ptr(), data.len() as u32) as usize }
+    }
+}
+
+/// UART extension for streaming receive into guest ring buffers, the writer
+/// must not be used after `stop` returns
+pub trait UartStream {
+    fn start(&mut self, handle: i32, writer: UartStreamWriter) -> Result<(), Error>;
+    fn stop(&mut self, handle: i32) -> Result<(), Error>;
+}
+
+/// Driver adaptor to C/wasm3 UART streaming API
+impl<T: UartStream> Driver<wasme_uart_stream_drv_t> for T {
+    const DRIVER: wasme_uart_stream_drv_t = wasme_uart_stream_drv_t {
+        start: Some(uart_stream_start::<T>),
+        stop: Some(uart_stream_stop::<T>),
+    };
+
+    fn bind(&mut self, rt: &mut Wasm3Runtime) -> i32 {
+        unsafe { crate::WASME_bind_uart_stream(rt.ctx, &Self::DRIVER, self.context()) }
+    }
+}
+
+pub extern "C" fn uart_stream_start<T: UartStream>(
+    ctx: *const c_void,
+    handle: i32,
+    stream: *mut wasme_uart_stream_t,
+) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match UartStream::start(ctx, handle, UartStreamWriter{ stream }) {
+        Ok(_) => 0,
+        Err(e) => {
+            debug!("UartStream::start failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+pub extern "C" fn uart_stream_stop<T: UartStream>(ctx: *const c_void, handle: i32) -> i32 {
+    let ctx: &mut T = unsafe { &mut *(ctx as *mut T) };
+
+    match UartStream::stop(ctx, handle) {
+        Ok(_) => 0,
+        Err(e) => {
+            debug!("UartStream::stop failed: {:?}", e);
+            WASI_ERRNO_IO
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        wasme_frame_t, wasme_frame_cfg_t, wasme_frame_mode_t, wasme_frame_crc_t,
+        WASME_frame_init, WASME_frame_feed, WASME_frame_want,
+        wasme_frame_mode_t_WASME_FRAME_DELIM, wasme_frame_mode_t_WASME_FRAME_SLIP,
+        wasme_frame_mode_t_WASME_FRAME_COBS, wasme_frame_mode_t_WASME_FRAME_LEN,
+        wasme_frame_crc_t_WASME_FRAME_CRC_NONE, wasme_frame_crc_t_WASME_FRAME_CRC16,
+        WASME_FRAME_MORE, WASME_FRAME_READY, WASME_FRAME_ERR_CRC, WASME_FRAME_ERR_OVERFLOW,
+    };
+
+    extern "C" {
+        fn wasme_ring_push(hdr: *mut u32, ring: *mut u8, size: u32, data: *const u8, len: u32, whole: bool) -> u32;
+    }
+
+    /// Push into a ring, returning the bytes copied
+    fn push(hdr: &mut [u32; 2], ring: &mut [u8], data: &[u8], whole: bool) -> u32 {
+        unsafe { wasme_ring_push(hdr.as_mut_ptr(), ring.as_mut_ptr(), ring.len() as u32, data.as_ptr(), data.len() as u32, whole) }
+    }
+
+    const MORE: i32 = WASME_FRAME_MORE as i32;
+    const READY: i32 = WASME_FRAME_READY as i32;
+    const ERR_CRC: i32 = WASME_FRAME_ERR_CRC as i32;
+    const ERR_OVERFLOW: i32 = WASME_FRAME_ERR_OVERFLOW as i32;
+
+    fn decoder(mode: wasme_frame_mode_t, param: u8, crc: wasme_frame_crc_t, buf: &mut [u8]) -> wasme_frame_t {
+        let cfg = wasme_frame_cfg_t{ mode, param, crc };
+        let mut f: wasme_frame_t = unsafe { core::mem::zeroed() };
+
+        unsafe { WASME_frame_init(&mut f, &cfg, buf.as_mut_ptr(), buf.len() as u32) };
+
+        f
+    }
+
+    /// Feed input, returning the result and number of bytes consumed
+    fn feed(f: &mut wasme_frame_t, data: &[u8]) -> (i32, usize) {
+        let mut consumed = 0;
+        let res = unsafe { WASME_frame_feed(f, data.as_ptr(), data.len() as u32, &mut consumed) };
+
+        (res, consumed as usize)
+    }
+
+    /// Last complete frame
+    fn frame(f: &wasme_frame_t) -> &[u8] {
+        unsafe { core::slice::from_raw_parts(f.buf, f.frame_len as usize) }
+    }
+
+    #[test]
+    fn test_frame_slip_escapes() {
+        let mut buf = [0u8; 64];
+        let mut f = decoder(wasme_frame_mode_t_WASME_FRAME_SLIP, 0, wasme_frame_crc_t_WASME_FRAME_CRC_NONE, &mut buf);
+
+        let res = feed(&mut f, &[0xC0, 0x01, 0xDB, 0xDC, 0x02, 0xDB, 0xDD, 0xC0]);
+        assert_eq!(res, (READY, 8));
+        assert_eq!(frame(&f), &[0x01, 0xC0, 0x02, 0xDB]);
+    }
+
+    #[test]
+    fn test_frame_cobs_restores_zeros() {
+        let mut buf = [0u8; 64];
+        let mut f = decoder(wasme_frame_mode_t_WASME_FRAME_COBS, 0, wasme_frame_crc_t_WASME_FRAME_CRC_NONE, &mut buf);
+
+        let res = feed(&mut f, &[0x03, 0x11, 0x22, 0x02, 0x33, 0x00]);
+        assert_eq!(res, (READY, 6));
+        assert_eq!(frame(&f), &[0x11, 0x22, 0x00, 0x33]);
+    }
+
+    #[test]
+    fn test_frame_len_across_reads() {
+        let mut buf = [0u8; 64];
+        let mut f = decoder(wasme_frame_mode_t_WASME_FRAME_LEN, 2, wasme_frame_crc_t_WASME_FRAME_CRC_NONE, &mut buf);
+
+        // Header and first payload byte, the decoder then asks for exactly the remainder
+        assert_eq!(feed(&mut f, &[0x03, 0x00, 0xAA]), (MORE, 3));
+        assert_eq!(unsafe { WASME_frame_want(&f) }, 2);
+
+        assert_eq!(feed(&mut f, &[0xBB, 0xCC]), (READY, 2));
+        assert_eq!(frame(&f), &[0xAA, 0xBB, 0xCC]);
+    }
+
+    #[test]
+    fn test_frame_crc16() {
+        let mut buf = [0u8; 64];
+        let mut f = decoder(wasme_frame_mode_t_WASME_FRAME_DELIM, b'\n', wasme_frame_crc_t_WASME_FRAME_CRC16, &mut buf);
+
+        // CRC-16/CCITT-FALSE check value, stripped from the frame
+        assert_eq!(feed(&mut f, b"123456789\x29\xB1\n"), (READY, 12));
+        assert_eq!(frame(&f), b"123456789");
+
+        assert_eq!(feed(&mut f, b"023456789\x29\xB1\n"), (ERR_CRC, 12));
+    }
+
+    #[test]
+    fn test_frame_overflow_resyncs() {
+        let mut buf = [0u8; 4];
+        let mut f = decoder(wasme_frame_mode_t_WASME_FRAME_DELIM, b'\n', wasme_frame_crc_t_WASME_FRAME_CRC_NONE, &mut buf);
+
+        // Oversized frame is dropped at its delimiter and the next decodes
+        assert_eq!(feed(&mut f, b"abcdef\nab\n"), (ERR_OVERFLOW, 7));
+        assert_eq!(feed(&mut f, b"ab\n"), (READY, 3));
+        assert_eq!(frame(&f), b"ab");
+    }
+
+    #[test]
+    fn test_ring_wraps() {
+        // Head and tail near the end of the ring and the counters about to wrap
+        let mut hdr = [u32::MAX - 1; 2];
+        let mut ring = [0u8; 8];
+
+        assert_eq!(push(&mut hdr, &mut ring, b"abcde", false), 5);
+        assert_eq!(&ring, b"cde\0\0\0ab");
+        assert_eq!(hdr, [3, u32::MAX - 1]);
+
+        // Partial push fills the ring, a whole push then copies nothing
+        assert_eq!(push(&mut hdr, &mut ring, b"vwxyz", false), 3);
+        assert_eq!(&ring, b"cdevwxab");
+        assert_eq!(push(&mut hdr, &mut ring, b"z", true), 0);
+
+        // Consuming makes room again
+        hdr[1] = hdr[1].wrapping_add(4);
+        assert_eq!(push(&mut hdr, &mut ring, b"1234", true), 4);
+        assert_eq!(&ring, b"34evwx12");
+        assert_eq!(hdr[0], 10);
+    }
+
+    #[test]
+    fn test_ring_corrupt_tail() {
+        let mut ring = [0u8; 8];
+
+        // Tail ahead of the head claims more than the ring holds
+        let mut hdr = [4, 5];
+        assert_eq!(push(&mut hdr, &mut ring, b"a", false), 0);
+        assert_eq!(hdr[0], 4);
+
+        let mut hdr = [20, 4];
+        assert_eq!(push(&mut hdr, &mut ring, b"a", false), 0);
+        assert_eq!(ring, [0u8; 8]);
+    }
+}
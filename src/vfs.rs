@@ -0,0 +1,224 @@
+
+use core::ptr;
+
+use crate::{
+    c_char, wasme_ramfs_t, wasme_imgfs_t,
+    WASME_ramfs_init, WASME_ramfs_add, WASME_ramfs_deinit, WASME_imgfs_init,
+};
+
+/// Filesystem held in RAM, files may be loaded by the host and are created by the guest
+pub struct RamFs {
+    pub(crate) fs: *mut wasme_ramfs_t,
+}
+
+unsafe impl Send for RamFs {}
+
+impl RamFs {
+    /// Create an empty filesystem holding at most `capacity` bytes of file data
+    pub fn new(capacity: u32) -> Option<Self> {
+        let fs = unsafe { WASME_ramfs_init(capacity) };
+        if fs.is_null() {
+            return None;
+        }
+
+        Some(Self{ fs })
+    }
+
+    /// Create or replace the file at `path` (for example "cfg/app.toml"),
+    /// creating parent directories as required
+    pub fn add(&mut self, path: &str, data: &[u8]) -> Result<(), i32> {
+        let mut p = [0u8; crate::WASME_VFS_PATH_MAX as usize + 1];
+        if path.len() >= p.len() {
+            return Err(-1);
+        }
+        p[..path.len()].copy_from_slice(path.as_bytes());
+
+        let res = unsafe { WASME_ramfs_add(self.fs, p.as_ptr() as *const c_char, data.as_ptr(), data.len() as u32) };
+        if res < 0 {
+            return Err(res);
+        }
+
+        Ok(())
+    }
+}
+
+impl Drop for RamFs {
+    fn drop(&mut self) {
+        unsafe { WASME_ramfs_deinit(&mut self.fs) }
+    }
+}
+
+/// Read-only filesystem served in place from an image built with [`ImageBuilder`],
+/// for example included with `include_bytes!` so file data stays in flash
+pub struct ImageFs<'a> {
+    pub(crate) fs: wasme_imgfs_t,
+    _image: &'a [u8],
+}
+
+impl<'a> ImageFs<'a> {
+    /// Validate an image and create a filesystem over it
+    pub fn new(image: &'a [u8]) -> Option<Self> {
+        let mut fs = wasme_imgfs_t{ image: ptr::null(), len: 0, num_entries: 0 };
+
+        let res = unsafe { WASME_imgfs_init(&mut fs, image.as_ptr(), image.len() as u32) };
+        if res < 0 {
+            return None;
+        }
+
+        Some(Self{ fs, _image: image })
+    }
+}
+
+/// Build-time packer for [`ImageFs`] images, for use in build scripts
+#[cfg(feature = "std")]
+pub struct ImageBuilder {
+    // (parent, type, name, data)
+    entries: Vec<(u32, u32, String, Vec<u8>)>,
+}
+
+#[cfg(feature = "std")]
+impl ImageBuilder {
+    /// Create an image containing only the root directory
+    pub fn new() -> Self {
+        Self{ entries: vec![(0, crate::WASME_VFS_DIR, String::new(), Vec::new())] }
+    }
+
+    /// Add a file at `path`, creating parent directories as required
+    pub fn add(&mut self, path: &str, data: &[u8]) -> &mut Self {
+        let mut parts: Vec<&str> = path.split('/').filter(|p| !p.is_empty() && *p != ".").collect();
+        let name = match parts.pop() {
+            Some(n) => n,
+            None => return self,
+        };
+
+        let mut dir = 0;
+        for p in parts {
+            dir = match self.find(dir, p) {
+                Some(i) => i,
+                None => self.push(dir, crate::WASME_VFS_DIR, p, &[]),
+            };
+        }
+
+        match self.find(dir, name) {
+            Some(i) => self.entries[i as usize].3 = data.to_vec(),
+            None => { self.push(dir, crate::WASME_VFS_FILE, name, data); },
+        }
+
+        self
+    }
+
+    /// Add the contents of a host directory under `prefix`
+    pub fn add_dir(&mut self, prefix: &str, dir: &std::path::Path) -> std::io::Result<&mut Self> {
+        for e in std::fs::read_dir(dir)? {
+            let e = e?;
+            let path = format!("{}/{}", prefix, e.file_name().to_string_lossy());
+
+            if e.file_type()?.is_dir() {
+                self.add_dir(&path, &e.path())?;
+            } else {
+                self.add(&path, &std::fs::read(e.path())?);
+            }
+        }
+
+        Ok(self)
+    }
+
+    /// Pack the image, file data is 4-byte aligned
+    pub fn build(&self) -> Vec<u8> {
+        let hdr_len = 16 + self.entries.len() * 24;
+        let mut table = Vec::with_capacity(hdr_len);
+        let mut blob = Vec::new();
+
+        for v in [crate::WASME_IMGFS_MAGIC, crate::WASME_IMGFS_VERSION, self.entries.len() as u32, 0] {
+            table.extend_from_slice(&v.to_le_bytes());
+        }
+
+        for (parent, kind, name, data) in &self.entries {
+            while blob.len() % 4 != 0 {
+                blob.push(0);
+            }
+            let data_off = hdr_len + blob.len();
+            blob.extend_from_slice(data);
+
+            let name_off = hdr_len + blob.len();
+            blob.extend_from_slice(name.as_bytes());
+
+            for v in [*parent, *kind, name_off as u32, name.len() as u32, data_off as u32, data.len() as u32] {
+                table.extend_from_slice(&v.to_le_bytes());
+            }
+        }
+
+        table.extend_from_slice(&blob);
+        table
+    }
+
+    fn find(&self, dir: u32, name: &str) -> Option<u32> {
+        self.entries.iter().enumerate().skip(1)
+            .find(|(_, e)| e.0 == dir && e.2 == name)
+            .map(|(i, _)| i as u32)
+    }
+
+    fn push(&mut self, dir: u32, kind: u32, name: &str, data: &[u8]) -> u32 {
+        self.entries.push((dir, kind, name.to_string(), data.to_vec()));
+        (self.entries.len() - 1) as u32
+    }
+}
+
+#[cfg(all(test, feature = "std"))]
+mod test {
+    use super::*;
+
+    fn image() -> Vec<u8> {
+        ImageBuilder::new().add("cfg/app.toml", b"x=1").build()
+    }
+
+    fn put(image: &mut [u8], offset: usize, value: u32) {
+        image[offset..offset + 4].copy_from_slice(&value.to_le_bytes());
+    }
+
+    #[test]
+    fn test_imgfs_accepts_built_image() {
+        let image = image();
+        assert!(ImageFs::new(&image).is_some());
+    }
+
+    #[test]
+    fn test_imgfs_rejects_truncated() {
+        // The last file name ends the image
+        let image = image();
+        assert!(ImageFs::new(&image[..image.len() - 1]).is_none());
+        assert!(ImageFs::new(&image[..8]).is_none());
+    }
+
+    #[test]
+    fn test_imgfs_rejects_bad_header() {
+        let mut image = image();
+        image[0] ^= 1;
+        assert!(ImageFs::new(&image).is_none());
+
+        // Entry table past the end of the image
+        let mut image = self::image();
+        put(&mut image, 8, 1000);
+        assert!(ImageFs::new(&image).is_none());
+    }
+
+    #[test]
+    fn test_imgfs_rejects_bad_entries() {
+        // Entries follow the 16 byte header, 24 bytes each: parent, type, ...
+
+        // Root must be a directory
+        let mut image = image();
+        put(&mut image, 16 + 4, crate::WASME_VFS_FILE);
+        assert!(ImageFs::new(&image).is_none());
+
+        // Parent out of range
+        let mut image = self::image();
+        put(&mut image, 16 + 24, 0xFF);
+        assert!(ImageFs::new(&image).is_none());
+
+        // Parent must be a directory, entry 2 is the file itself
+        let mut image = self::image();
+        put(&mut image, 16 + 48, 2);
+        assert!(ImageFs::new(&image).is_none());
+    }
+}